@@ -75,7 +75,13 @@ HEADERS += \
     src/storagebutton.h\
     src/midievent.h \
     src/nsm.h \
-    src/driverbase.h
+    src/driverbase.h \
+    src/swapbuffer.h \
+    src/noteset.h \
+    src/rtcheck.h \
+    src/rtpolicy.h \
+    src/timebase.h \
+    src/wavestore.h
 
 TRANSLATIONS += \
         src/translations/qmidiarp_cs.ts \
@@ -47,12 +47,33 @@ ArpWidget::ArpWidget(MidiArp *p_midiArp, GlobStore *p_globStore,
     ModuleWidget(p_midiArp, p_globStore, p_prefs, inOutVisible, p_name),
     midiArp(p_midiArp)
 {
-    bool compactStyle = p_prefs->compactStyle;
+    // the presets are needed by preset switches before the controls exist
+    screen = NULL;
+    loadPatternPresets();
+    patternPresetBoxIndex = 0;
+    applyData();
+    modified = false;
+}
 #else
 ArpWidget::ArpWidget():
     ModuleWidget("Arp:"),
     midiArp(NULL)
 {
+    loadPatternPresets();
+    patternPresetBoxIndex = 0;
+    buildUi();
+}
+#endif
+
+void ArpWidget::buildUi()
+{
+#ifdef APPBUILD
+    bool compactStyle = prefs->compactStyle;
+    MidiArp *worker = midiArp;
+
+    // see ModuleWidget::ensureUi()
+    midiArp = NULL;
+#else
     bool compactStyle = true;
 #endif
 
@@ -87,10 +108,8 @@ ArpWidget::ArpWidget():
 #endif
 
     patternPresetBox = new QComboBox;
-    loadPatternPresets();
     patternPresetBox->insertItems(0, patternNames);
     patternPresetBox->setCurrentIndex(0);
-    patternPresetBoxIndex = 0;
     patternPresetBox->setToolTip(tr("Pattern preset"));
     patternPresetBox->setMinimumContentsLength(20);
     connect(patternPresetBox, SIGNAL(activated(int)), this,
@@ -279,6 +298,25 @@ ArpWidget::ArpWidget():
     repeatPatternThroughChord->setCurrentIndex(3);
     octaveModeBox->setCurrentIndex(3);
 
+#ifdef APPBUILD
+    patternText->setText(moduleData.pattern);
+    repeatPatternThroughChord->setCurrentIndex(moduleData.repeatMode);
+    octaveModeBox->setCurrentIndex(moduleData.octaveMode);
+    octaveLowBox->setCurrentIndex(moduleData.octaveLow);
+    octaveHighBox->setCurrentIndex(moduleData.octaveHigh);
+    latchModeAction->setChecked(moduleData.latchMode);
+    randomTick->setValue(moduleData.rndTick);
+    randomVelocity->setValue(moduleData.rndVel);
+    randomLength->setValue(moduleData.rndLen);
+    attackTime->setValue(moduleData.attack);
+    releaseTime->setValue(moduleData.release);
+
+    midiArp = worker;
+    textStoreAction->setEnabled(true);
+    screen->updateData(patternText->text(), midiArp->minOctave,
+                    midiArp->maxOctave, midiArp->minStepWidth,
+                    midiArp->nSteps, midiArp->patternMaxIndex);
+#endif
     modified = false;
 }
 
@@ -291,6 +329,7 @@ MidiArp *ArpWidget::getMidiWorker()
 
 void ArpWidget::writeData(QXmlStreamWriter& xml)
 {
+        if (uiBuilt) controlsToData();
         writeCommonData(xml);
 
         xml.writeStartElement("pattern");
@@ -304,7 +343,7 @@ void ArpWidget::writeData(QXmlStreamWriter& xml)
             xml.writeTextElement("octaveHigh", QString::number(
                 midiArp->octHigh));
             xml.writeTextElement("latchMode", QString::number(
-                latchModeAction->isChecked()));
+                moduleData.latchMode));
         xml.writeEndElement();
 
         xml.writeStartElement("random");
@@ -318,9 +357,9 @@ void ArpWidget::writeData(QXmlStreamWriter& xml)
 
         xml.writeStartElement("envelope");
             xml.writeTextElement("attack", QString::number(
-                attackTime->value()));
+                moduleData.attack));
             xml.writeTextElement("release", QString::number(
-                releaseTime->value()));
+                moduleData.release));
         xml.writeEndElement();
 
 
@@ -344,17 +383,17 @@ void ArpWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 if (xml.isEndElement())
                     break;
                 if (xml.name() == "pattern")
-                    patternText->setText(xml.readElementText());
+                    moduleData.pattern = xml.readElementText();
                 else if (xml.name() == "repeatMode")
-                    repeatPatternThroughChord->setCurrentIndex(xml.readElementText().toInt());
+                    moduleData.repeatMode = xml.readElementText().toInt();
                 else if (xml.name() == "octaveMode")
-                    octaveModeBox->setCurrentIndex(xml.readElementText().toInt());
+                    moduleData.octaveMode = xml.readElementText().toInt();
                 else if (xml.name() == "octaveLow")
-                    octaveLowBox->setCurrentIndex(-xml.readElementText().toInt());
+                    moduleData.octaveLow = -xml.readElementText().toInt();
                 else if (xml.name() == "octaveHigh")
-                    octaveHighBox->setCurrentIndex(xml.readElementText().toInt());
+                    moduleData.octaveHigh = xml.readElementText().toInt();
                 else if (xml.name() == "latchMode")
-                    latchModeAction->setChecked(xml.readElementText().toInt());
+                    moduleData.latchMode = xml.readElementText().toInt();
                 else skipXmlElement(xml);
             }
         }
@@ -365,11 +404,11 @@ void ArpWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 if (xml.isEndElement())
                     break;
                 if (xml.name() == "tick")
-                    randomTick->setValue(xml.readElementText().toInt());
+                    moduleData.rndTick = xml.readElementText().toInt();
                 else if (xml.name() == "velocity")
-                    randomVelocity->setValue(xml.readElementText().toInt());
+                    moduleData.rndVel = xml.readElementText().toInt();
                 else if (xml.name() == "length")
-                    randomLength->setValue(xml.readElementText().toInt());
+                    moduleData.rndLen = xml.readElementText().toInt();
                 else skipXmlElement(xml);
             }
         }
@@ -379,21 +418,51 @@ void ArpWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 if (xml.isEndElement())
                     break;
                 if (xml.name() == "attack")
-                    attackTime->setValue(xml.readElementText().toInt());
+                    moduleData.attack = xml.readElementText().toInt();
                 else if (xml.name() == "release")
-                    releaseTime->setValue(xml.readElementText().toInt());
+                    moduleData.release = xml.readElementText().toInt();
                 else skipXmlElement(xml);
              }
         }
         else skipXmlElement(xml);
     }
 
-    updateChIn(chIn->currentIndex());
-    updateChannelOut(channelOut->currentIndex());
-    updatePortOut(portOut->currentIndex());
+    applyData();
     midiArp->needsGUIUpdate = false;
     modified = false;
 }
+
+void ArpWidget::applyData()
+{
+    ModuleWidget::applyData();
+    midiArp->updatePattern(moduleData.pattern.toStdString());
+    midiArp->repeatPatternThroughChord = moduleData.repeatMode;
+    midiArp->updateOctaveMode(moduleData.octaveMode);
+    midiArp->octLow = -moduleData.octaveLow;
+    midiArp->octHigh = moduleData.octaveHigh;
+    if (moduleData.latchMode) midiArp->setLatchMode(true);
+    midiArp->updateRandomTickAmp(moduleData.rndTick);
+    midiArp->updateRandomVelocityAmp(moduleData.rndVel);
+    midiArp->updateRandomLengthAmp(moduleData.rndLen);
+    midiArp->updateAttackTime(moduleData.attack);
+    midiArp->updateReleaseTime(moduleData.release);
+}
+
+void ArpWidget::controlsToData()
+{
+    ModuleWidget::controlsToData();
+    moduleData.pattern = patternText->text();
+    moduleData.repeatMode = repeatPatternThroughChord->currentIndex();
+    moduleData.octaveMode = octaveModeBox->currentIndex();
+    moduleData.octaveLow = octaveLowBox->currentIndex();
+    moduleData.octaveHigh = octaveHighBox->currentIndex();
+    moduleData.latchMode = latchModeAction->isChecked();
+    moduleData.rndTick = randomTick->value();
+    moduleData.rndVel = randomVelocity->value();
+    moduleData.rndLen = randomLength->value();
+    moduleData.attack = attackTime->value();
+    moduleData.release = releaseTime->value();
+}
 #endif
 
 
@@ -570,6 +639,16 @@ void ArpWidget::storeCurrentPattern()
 
 void ArpWidget::updatePatternPresets(const QString& n, const QString& p, int index)
 {
+    if (!uiBuilt) {
+        if (index) {
+            patternNames.removeAt(index);
+            patternPresets.removeAt(index);
+        } else {
+            patternNames.append(n);
+            patternPresets.append(p);
+        }
+        return;
+    }
     if (index) {
        if (index == patternPresetBox->currentIndex()) {
             patternPresetBox->setCurrentIndex(0);
@@ -629,13 +708,13 @@ void ArpWidget::setLatchMode(bool on)
 
 void ArpWidget::doStoreParams(int ix)
 {
-    parStore->temp.attack = attackTime->value();
-    parStore->temp.release = releaseTime->value();
-    parStore->temp.rndTick = randomTick->value();
-    parStore->temp.rndLen = randomLength->value();
-    parStore->temp.rndVel = randomVelocity->value();
-    parStore->temp.pattern = patternText->text();
-    parStore->temp.repeatMode = repeatPatternThroughChord->currentIndex();
+    parStore->temp.attack = moduleData.attack;
+    parStore->temp.release = moduleData.release;
+    parStore->temp.rndTick = moduleData.rndTick;
+    parStore->temp.rndLen = moduleData.rndLen;
+    parStore->temp.rndVel = moduleData.rndVel;
+    parStore->temp.pattern = moduleData.pattern;
+    parStore->temp.repeatMode = moduleData.repeatMode;
     parStore->tempToList(ix);
 }
 
@@ -643,6 +722,28 @@ void ArpWidget::doRestoreParams(int ix)
 {
     midiArp->applyPendingParChanges();
     if (parStore->list.at(ix).empty) return;
+    if (!uiBuilt) {
+        if (moduleData.pattern != parStore->list.at(ix).pattern) {
+            moduleData.pattern = parStore->list.at(ix).pattern;
+            midiArp->updatePattern(moduleData.pattern.toStdString());
+        }
+        moduleData.repeatMode = parStore->list.at(ix).repeatMode;
+        updateRepeatPattern(moduleData.repeatMode);
+        if (!parStore->onlyPatternList.at(ix)) {
+            moduleData.attack = parStore->list.at(ix).attack;
+            moduleData.release = parStore->list.at(ix).release;
+            moduleData.rndTick = parStore->list.at(ix).rndTick;
+            moduleData.rndLen = parStore->list.at(ix).rndLen;
+            moduleData.rndVel = parStore->list.at(ix).rndVel;
+            midiArp->updateAttackTime(moduleData.attack);
+            midiArp->updateReleaseTime(moduleData.release);
+            midiArp->updateRandomTickAmp(moduleData.rndTick);
+            midiArp->updateRandomLengthAmp(moduleData.rndLen);
+            midiArp->updateRandomVelocityAmp(moduleData.rndVel);
+        }
+        midiArp->advancePatternIndex(true);
+        return;
+    }
     patternText->setText(parStore->list.at(ix).pattern);
     repeatPatternThroughChord->setCurrentIndex(parStore->list.at(ix).repeatMode);
     updateRepeatPattern(parStore->list.at(ix).repeatMode);
@@ -717,6 +818,10 @@ void ArpWidget::updateDisplay()
             updateNRep(parStore->nRepList.at(parStore->activeStore));
         }
     }
+    if (!uiBuilt) {
+        updateUnbuiltDisplay();
+        return;
+    }
     screen->updateDraw();
     midiControl->update();
 
@@ -126,9 +126,12 @@ class ArpWidget :  public ModuleWidget
     void doRestoreParams(int ix);
     void updateDisplay();
     void handleController(int ccnumber, int channel, int value);
+    void applyData() override;
+    void controlsToData() override;
 #endif
 
-    void updateCursorPos() { screen->updateCursor(midiArp->getFramePtr()); }
+    void buildUi() override;
+    void updateCursorPos() { if (uiBuilt) screen->updateCursor(midiArp->getFramePtr()); }
     
 /* SIGNALS */
   signals:
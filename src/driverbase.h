@@ -27,11 +27,28 @@
 #define DRIVERBASE_H__9383DA6E_DCDB_4840_86DA_6A36E87653D2__INCLUDED
 
 #include <QThread>
+
+#include "rtpolicy.h"
+
+/*! @brief Bandwidth governor state of one output port
+ */
+struct PortBudget {
+    int64_t slice;          /*!< Index of the time slice bytes are counted for */
+    int bytes;              /*!< Bytes scheduled within that slice */
+    uint32_t overloads;     /*!< Events dropped or coalesced because of overload */
+};
+
 /*! @brief Base class for the JackDriver and SeqDriver backends
  *
  * Defines some useful functions and member variables common to both
  * backends. DriverBase derives from QThread, only because it is a base
  * class for SeqDriver, which implements a thread.
+ *
+ * With a port bandwidth set, the backends pass their output events
+ * through admitEvent(), which counts the bytes scheduled per port in
+ * time slices of GOV_SLICE_MS. Note events always pass. Other events
+ * are refused once their slice is full, the backend then drops them or
+ * merges them into a pending event for the same controller.
  */
 
 class DriverBase : public QThread
@@ -43,21 +60,23 @@ public:
     bool outputMidiClock;
     int portUnmatched;
     int portMidiClock;
+    int portBandwidth;      // bytes per second and port, 0 for no limit
+    RtPolicy rtPolicy;      // scheduling of the realtime thread, see rtpolicy.h
     QString jsFilename;
     uint64_t trStartingTick;
     uint64_t trLoopingTick;
 
-    virtual void resetTick(unsigned int tick = 0)
+    virtual void resetTick(uint64_t tick = 0)
     {
         m_current_tick = tick;
     }
 
-    virtual unsigned int getCurrentTick() const
+    virtual uint64_t getCurrentTick() const
     {
         return m_current_tick;
     }
 
-    virtual void setNextTick(unsigned int next_tick)
+    virtual void setNextTick(uint64_t next_tick)
     {
         if (next_tick > m_current_tick)
         {
@@ -121,11 +140,53 @@ public:
     virtual void setTransportStatus(bool run) = 0;
     virtual int getClientId() = 0;
 
+    // sets a manual latency offset in ms by which events to port are sent early
+    virtual void setPortOffset(int port, int ms)
+    {
+        (void)port;
+        (void)ms;
+    }
+
+    // changes the number of output ports and returns the new number,
+    // backends that cannot do this at runtime keep their ports
+    virtual int setPortCount(int count)
+    {
+        (void)count;
+        return portCount;
+    }
+
+    // limits the bytes per second scheduled to each output port, 0 for no limit
+    virtual void setPortBandwidth(int bytes_per_sec)
+    {
+        portBandwidth = bytes_per_sec;
+    }
+
+    // returns the number of events dropped or coalesced on port
+    // because of the bandwidth limit
+    virtual uint32_t getPortOverloads(int port)
+    {
+        (void)port;
+        return 0;
+    }
+
+    // sets the scheduling class, priority and CPU of the realtime thread,
+    // backends apply them to their running thread
+    virtual void setRtPolicy(const RtPolicy &policy)
+    {
+        rtPolicy = policy;
+    }
+
+    // resizes the backend's pool of scheduled output events, not realtime safe
+    virtual void setOutputPool(int nevents)
+    {
+        (void)nevents;
+    }
+
 protected:
     DriverBase(
         int p_portCount,
         void * callback_context,
-        bool (* midi_event_received_callback)(void * context, MidiEvent ev),
+        bool (* midi_event_received_callback)(void * context, MidiEvent ev, uint64_t tick),
         void (* tick_callback)(void * context, bool echo_from_trig),
         uint64_t backend_rate)
         : m_midi_event_received_callback(midi_event_received_callback)
@@ -147,16 +208,22 @@ protected:
     useMidiClock = false;
     outputMidiClock = false;
     portMidiClock = 0;
+    portBandwidth = 0;
+    rtPolicy = global_rt_policy;
     }
 
-    uint64_t tickToBackendOffset(unsigned int tick)
+    // split into whole minutes and remainder so that the products
+    // cannot overflow in long sessions
+    uint64_t tickToBackendOffset(uint64_t tick)
     {
-        return (uint64_t)tick * m_backend_rate / m_tpm;
+        return tick / m_tpm * m_backend_rate
+            + tick % m_tpm * m_backend_rate / m_tpm;
     }
 
-    unsigned int backendOffsetToTick(uint64_t backend_offset)
+    uint64_t backendOffsetToTick(uint64_t backend_offset)
     {
-        return backend_offset * m_tpm / m_backend_rate;
+        return backend_offset / m_backend_rate * m_tpm
+            + backend_offset % m_backend_rate * m_tpm / m_backend_rate;
     }
 
     uint64_t getCurrentTickBackendOffset()
@@ -169,9 +236,10 @@ protected:
         return tickToBackendOffset(m_next_tick);
     }
 
-    bool midi_event_received(MidiEvent ev)
+    // tick is the time the event was received at
+    bool midi_event_received(MidiEvent ev, uint64_t tick)
     {
-        return m_midi_event_received_callback(m_callback_context, ev);
+        return m_midi_event_received_callback(m_callback_context, ev, tick);
     }
 
     void tick_callback(bool echo_from_trig)
@@ -179,6 +247,60 @@ protected:
         m_tick_callback(m_callback_context, echo_from_trig);
     }
 
+    /*! @brief Decides whether an output event fits into the bandwidth of
+     * its port and counts its bytes.
+     *
+     * Note on and off events are always admitted, so that they are never
+     * delayed behind controller streams, and so are realtime events. The bytes of a note on include
+     * those of its note off. Events scheduled for an earlier slice than
+     * the current one are counted into the current one, the count starts
+     * over when the ticks jump back by more than a second.
+     * @param budget Governor state of the port
+     * @param ev Event to be scheduled
+     * @param tick Tick the event is scheduled at
+     * @return True if the event is to be scheduled */
+    bool admitEvent(PortBudget &budget, const MidiEvent &ev, uint64_t tick)
+    {
+        int size;
+        int64_t slice_ticks;
+        int64_t slice;
+
+        if (!portBandwidth) return true;
+
+        slice_ticks = tempo * TPQN * GOV_SLICE_MS / 60000;
+        if (slice_ticks < 1) slice_ticks = 1;
+        slice = tick / slice_ticks;
+        if ((slice > budget.slice) || (slice + 1000 / GOV_SLICE_MS < budget.slice)) {
+            budget.slice = slice;
+            budget.bytes = 0;
+        }
+
+        switch (ev.type) {
+            case EV_NOTEON:
+                budget.bytes += 6;
+                return true;
+            case EV_PGMCHANGE:
+            case EV_CHANPRESS:
+                size = 2;
+            break;
+            case EV_CLOCK:
+            case EV_START:
+            case EV_CONTINUE:
+            case EV_STOP:
+                budget.bytes += 1;
+                return true;
+            default:
+                size = 3;
+        }
+
+        if (budget.bytes + size > portBandwidth * GOV_SLICE_MS / 1000) {
+            budget.overloads++;
+            return false;
+        }
+        budget.bytes += size;
+        return true;
+    }
+
     /*! @brief Convenience function for creating a new MidiEvent struct */
     MidiEvent mkMidiEvent(int type, int channel=0, int data=0, int value=0)
     {
@@ -190,7 +312,7 @@ protected:
         return ev;
     }
 
-    bool (* m_midi_event_received_callback)(void * context, MidiEvent ev);
+    bool (* m_midi_event_received_callback)(void * context, MidiEvent ev, uint64_t tick);
     void (* m_tick_callback)(void * context, bool echo_from_trig);
     void * m_callback_context;
     uint64_t m_backend_rate;    // samples(?) per minute (granularity)
@@ -23,6 +23,7 @@
  */
 
 #include <iostream>
+#include <unistd.h>
 #include "engine.h"
 
 
@@ -31,6 +32,7 @@ Engine::Engine(GlobStore *p_globStore, GrooveWidget *p_grooveWidget,
             : QObject(parent), modified(false)
 {
     ready = false;
+    rtBusy = false;
 
     logEventBuffer.resize(128);
     logTickBuffer.resize(128);
@@ -184,6 +186,7 @@ void Engine::addModuleWidget(ModuleWidget *moduleWidget)
 {
     addMidiWorker(moduleWidget->midiWorker);
     moduleWidgetList.append(moduleWidget);
+    updateBatches();
     sendGroove(moduleWidgetCount() - 1);
     updateGlobRestoreTimeModule(restoreModIx);
 
@@ -193,12 +196,47 @@ void Engine::addModuleWidget(ModuleWidget *moduleWidget)
 void Engine::removeModuleWidget(ModuleWidget *moduleWidget)
 {
     moduleWidgetList.removeOne(moduleWidget);
+    updateBatches();
     removeMidiWorker(moduleWidget->midiWorker);
 
     delete moduleWidget->parent();
     modified = true;
 }
 
+void Engine::updateBatches()
+{
+    // the write instance is never the one the driver thread reads
+    ModuleBatches &next = batches.writeBuffer();
+
+    next.arps.clear();
+    next.lfos.clear();
+    next.seqs.clear();
+
+    for (int l1 = 0; l1 < moduleWidgetCount(); l1++) {
+        ModuleWidget *widget = moduleWidget(l1);
+        if (widget->name.startsWith("Arp:"))
+            next.arps.append(((ArpWidget *)widget)->midiArp, widget, l1);
+        else if (widget->name.startsWith("LFO:"))
+            next.lfos.append(((LfoWidget *)widget)->midiLfo, widget, l1);
+        else if (widget->name.startsWith("Seq:"))
+            next.seqs.append(((SeqWidget *)widget)->midiSeq, widget, l1);
+    }
+    batches.publish();
+
+    // A callback entered after the publish takes over the new batches.
+    // One running now may still walk the previous ones, wait until it
+    // has finished or a later callback has taken them over.
+    while (rtBusy && batches.pending()) usleep(100);
+}
+
+const ModuleBatches &Engine::beginBatches()
+{
+    // set before looking for new batches, see updateBatches()
+    rtBusy = true;
+    batches.update();
+    return batches.readBuffer();
+}
+
 int Engine::moduleWidgetCount(const QString &mtype)
 {
     if (mtype == "") return moduleWidgetList.count();
@@ -285,6 +323,25 @@ int Engine::getPortCount()
     return(portCount);
 }
 
+int Engine::setPortCount(int count)
+{
+    portCount = driver->setPortCount(count);
+    for (int l1 = 0; l1 < moduleWidgetCount(); l1++) {
+        moduleWidget(l1)->setPortCount(portCount);
+    }
+    return(portCount);
+}
+
+void Engine::setRtPolicy(const RtPolicy &policy)
+{
+    driver->setRtPolicy(policy);
+    if (!rtSetAffinity(pthread_self(), policy.guiCpu))
+        qWarning("Could not move GUI thread to CPU %d", policy.guiCpu);
+    dispTimer->cpuRequest = policy.guiCpu;
+    if (!rtLockMemory(policy.lockMemory))
+        qWarning("Could not %s memory", policy.lockMemory ? "lock" : "unlock");
+}
+
 int Engine::getClientId()
 {
     return driver->getClientId();
@@ -314,12 +371,109 @@ void Engine::tick_callback(void * context, bool echo_from_trig)
   ((Engine *)context)->echoCallback(echo_from_trig);
 }
 
+template <class W>
+void Engine::sendFrame(W *worker)
+{
+    const Sample *frame = worker->outFrame.data();
+    const int count = worker->outFrameCount;
+
+    if (worker->isMuted) return;
+
+    for (int l1 = 0; l1 < count; l1++) {
+        if (frame[l1].muted) continue;
+        MidiEvent outEv = mkMidiEvent(
+                            worker->eventType,
+                            worker->frameChannel(l1),
+                            frame[l1].data,
+                            frame[l1].value);
+        driver->sendMidiEvent(outEv,
+                            frame[l1].tick,
+                            worker->portOut,
+                            worker->returnLength);
+    }
+}
+
+template <class W>
+void Engine::renderFrame(W *worker, ModuleWidget *widget, int64_t tick,
+                bool *restoreFlag)
+{
+    widget->updateCursorPos();
+    widget->updateIndicators();
+    worker->getNextFrame(tick);
+    widget->checkIfRestore(&restoreTick, restoreFlag);
+    sendFrame(worker);
+}
+
+template <class W>
+void Engine::renderBatch(const ModuleBatch<W> &batch, bool echo_from_trig,
+                int64_t tick, bool *restoreFlag)
+{
+    W *const *workers = batch.workers.constData();
+    ModuleWidget *const *widgets = batch.widgets.constData();
+    const int count = batch.workers.count();
+    const int64_t dueTick = tick + alsaSyncTol;
+
+    for (int l1 = 0; l1 < count; l1++) {
+        if (workers[l1]->frameDue(echo_from_trig, dueTick)) {
+            renderFrame(workers[l1], widgets[l1], tick, restoreFlag);
+        }
+    }
+}
+
+template <class W>
+void Engine::updateMinTick(const ModuleBatch<W> &batch, bool *first)
+{
+    W *const *workers = batch.workers.constData();
+    const int count = batch.workers.count();
+
+    for (int l1 = 0; l1 < count; l1++) {
+        int64_t nt = workers[l1]->nextTick - schedDelayTicks;
+        if (nt < nextMinTick + schedDelayTicks || *first) nextMinTick = nt;
+        *first = false;
+    }
+}
+
+template <class W>
+void Engine::dispatchBatch(const ModuleBatch<W> &batch, MidiEvent inEv,
+                int64_t tick, int keep_rel, int lastId, bool *unmatched,
+                bool *restoreFlag)
+{
+    W *const *workers = batch.workers.constData();
+    ModuleWidget *const *widgets = batch.widgets.constData();
+    const int *ids = batch.ids.constData();
+    const int count = batch.workers.count();
+    bool no_collision = false;
+    int64_t trigTick;
+
+    for (int l1 = 0; l1 < count; l1++) {
+        W *worker = workers[l1];
+        bool result = worker->handleEvent(inEv, tick, keep_rel);
+        if (ids[l1] == lastId) *unmatched = result;
+
+        if (!worker->gotKbdTrig) continue;
+
+        trigTick = worker->nextTick;
+        // render the triggered frame right here instead of waiting
+        // for an echo, its events are stamped with the trigger tick
+        if (status && worker->frameDue(true, trigTick + alsaSyncTol)) {
+            renderFrame(worker, widgets[l1], trigTick, restoreFlag);
+            driver->requestEchoAt(worker->nextTick - schedDelayTicks, 0);
+        }
+        else {
+            nextMinTick = trigTick;
+            no_collision = driver->requestEchoAt(nextMinTick, true);
+            if (!no_collision) worker->gotKbdTrig = false;
+        }
+    }
+}
+
 void Engine::echoCallback(bool echo_from_trig)
 {
-    int l1, l2;
-    int tol = alsaSyncTol;
-    int tick = driver->getCurrentTick();
+    int64_t tick = driver->getCurrentTick();
     bool restoreFlag = (restoreRequest >= 0);
+    bool first = true;
+    const ModuleBatches &b = beginBatches();
+    const int nmodules = b.count();
     
     currentTick = tick;
 
@@ -327,35 +481,18 @@ void Engine::echoCallback(bool echo_from_trig)
         //~ printf("nextMinTick %d  ",nextMinTick);
     
     //Module data request and queueing
-    for (l1 = 0; l1 < moduleWidgetCount(); l1++) {
-        if (moduleWidget(l1)->prepareNextFrame(echo_from_trig, tol, tick, 
-                                       &restoreTick, &restoreFlag)) {
-            
-            l2 = 0;
-            while (midiWorker(l1)->outFrame[l2].data > -1) {
-                if (!midiWorker(l1)->outFrame[l2].muted && !midiWorker(l1)->isMuted) {
-                    MidiEvent outEv = mkMidiEvent(
-                                        midiWorker(l1)->eventType, 
-                                        midiWorker(l1)->channelOut, 
-                                        midiWorker(l1)->outFrame[l2].data, 
-                                        midiWorker(l1)->outFrame[l2].value);
-                    driver->sendMidiEvent(outEv, 
-                                        midiWorker(l1)->outFrame[l2].tick,
-                                        midiWorker(l1)->portOut, 
-                                        midiWorker(l1)->returnLength);
-                }
-                l2++;
-            }
-        }
-    }
+    renderBatch(b.arps, echo_from_trig, tick, &restoreFlag);
+    renderBatch(b.lfos, echo_from_trig, tick, &restoreFlag);
+    renderBatch(b.seqs, echo_from_trig, tick, &restoreFlag);
     
     //Calculate timing of next echo to be requested (minimum of all modules)
-    for (l1 = 0; l1 < midiWorkerCount(); l1++) {
-        int64_t nt = midiWorker(l1)->nextTick - schedDelayTicks;
-        if (nt < nextMinTick + schedDelayTicks || !l1) nextMinTick = nt;            
-    }
+    updateMinTick(b.arps, &first);
+    updateMinTick(b.lfos, &first);
+    updateMinTick(b.seqs, &first);
+    rtBusy = false;
+
     if (nextMinTick < 0) nextMinTick = 0;
-    if (moduleWidgetCount()) driver->requestEchoAt(nextMinTick, 0);
+    if (nmodules) driver->requestEchoAt(nextMinTick, 0);
 
     //Update GlobStore master indicator pacman
     if (restoreFlag && (globStoreWidget->timeModeBox->currentIndex())) {
@@ -365,24 +502,21 @@ void Engine::echoCallback(bool echo_from_trig)
 
     //Check for parameter restore requests
     if ((restoreTick > -1)
-        && (!moduleWidgetCount() || (nextMinTick + schedDelayTicks >= restoreTick))) {
+        && (!nmodules || (nextMinTick + schedDelayTicks >= restoreTick))) {
         restoreTick = -1;
         schedRestore(restoreRequest);
     }
 }
 
-bool Engine::midi_event_received_callback(void * context, MidiEvent ev)
+bool Engine::midi_event_received_callback(void * context, MidiEvent ev, uint64_t tick)
 {
-  return ((Engine *)context)->eventCallback(ev);
+  return ((Engine *)context)->eventCallback(ev, tick);
 }
 
-bool Engine::eventCallback(MidiEvent inEv)
+bool Engine::eventCallback(MidiEvent inEv, int64_t tick)
 {
     bool unmatched = true;
-    bool no_collision = false;
-    int l1;
-
-    int tick = driver->getCurrentTick();
+    bool restoreFlag = (restoreRequest >= 0);
 
     if (sendLogEvents) {
         logEventBuffer.replace(logEventCount, inEv);
@@ -417,19 +551,12 @@ bool Engine::eventCallback(MidiEvent inEv)
             midiLearnFlag = false;
         }
     }
-    for (l1 = 0; l1 < midiWorkerCount(); l1++) {
-        if (status && moduleWidget(l1)->name.startsWith("Arp:")) {
-            unmatched = midiWorker(l1)->handleEvent(inEv, tick, 1);
-        }
-        else {
-            unmatched = midiWorker(l1)->handleEvent(inEv, tick);
-        }
-        if (midiWorker(l1)->gotKbdTrig) {
-            nextMinTick = midiWorker(l1)->nextTick;
-            no_collision = driver->requestEchoAt(nextMinTick, true);
-            if (!no_collision) midiWorker(l1)->gotKbdTrig = false;
-        }
-    }
+    const ModuleBatches &b = beginBatches();
+    const int lastId = b.count() - 1;
+    dispatchBatch(b.arps, inEv, tick, status, lastId, &unmatched, &restoreFlag);
+    dispatchBatch(b.lfos, inEv, tick, 0, lastId, &unmatched, &restoreFlag);
+    dispatchBatch(b.seqs, inEv, tick, 0, lastId, &unmatched, &restoreFlag);
+    rtBusy = false;
 
     if (inEv.type == EV_CONTROLLER) {
         if (midiControllable) {
@@ -508,12 +635,13 @@ void Engine::handleController(int ccnumber, int channel, int value)
     requestedTempo = sval;
 }
 
-void Engine::resetTicks(int curtick)
+void Engine::resetTicks(int64_t curtick)
 {
     for (int l1 = 0; l1 < moduleWidgetCount(); l1++) {
         if (status && moduleWidget(l1)->name.startsWith("Arp:")) {
             midiWorker(l1)->foldReleaseTicks(driver->trStartingTick - curtick);
         }
+        midiWorker(l1)->resetRandom();
         midiWorker(l1)->setNextTick(curtick);
         if (!l1) nextMinTick = midiWorker(l1)->nextTick;
         if (midiWorker(l1)->nextTick < nextMinTick)
@@ -529,11 +657,6 @@ void Engine::setMidiControllable(bool on)
 
 void Engine::setUseMidiClock(bool on)
 {
-    if (alsaMidi and on)
-        alsaSyncTol = 3000;
-    else
-        alsaSyncTol = 2;
-    
     setStatus(false);
     driver->setUseMidiClock(on);
     useMidiClock = on;
@@ -566,6 +689,11 @@ void Engine::setMidiLearn(int moduleWidgetID, int controlID)
     }
 }
 
+void Engine::sizeOutputPool()
+{
+    driver->setOutputPool(SEQPOOL + moduleWidgetCount() * MODPOOL);
+}
+
 void Engine::setTempo(double bpm)
 {
     driver->requestTempo(bpm);
@@ -687,14 +815,19 @@ void Engine::updateDisplay()
 
 MTimer::MTimer()
 {
+    cpuRequest = -2;
     start();
 }
 
 void MTimer::run() {
 
+    int cpu;
+
     while(true) {
         // set fixed to 5000us
         usleep(5000);
+        cpu = cpuRequest.exchange(-2);
+        if (cpu > -2) rtSetAffinity(pthread_self(), cpu);
         emit timeout();
     }
 }
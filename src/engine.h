@@ -24,6 +24,7 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <atomic>
 #include <QDockWidget>
 #include <QThread>
 
@@ -33,6 +34,7 @@
 #include "lfowidget.h"
 #include "seqwidget.h"
 #include "groovewidget.h"
+#include "swapbuffer.h"
 #include "config.h"
 
 /*!
@@ -55,6 +57,7 @@ class MTimer : public QThread
 
 public:
     MTimer();
+    std::atomic<int> cpuRequest;    /**< CPU to move to at the next timeout, -2 to stay */
 
 signals:
     void timeout();
@@ -63,12 +66,62 @@ protected:
     void run();
 };
 
+/*!
+ * @brief Modules of one type kept in contiguous arrays for the realtime
+ * core of Engine
+ *
+ * Engine::echoCallback() and Engine::eventCallback() walk the workers
+ * of a batch through their concrete type, so that the calls to
+ * getNextFrame() and handleEvent() are direct. The arrays are rebuilt
+ * by Engine::updateBatches() when modules are added or removed, see
+ * ModuleBatches.
+ */
+template <class W> struct ModuleBatch {
+    QVector<W *> workers;
+    QVector<ModuleWidget *> widgets;
+    QVector<int> ids;   /*!< Index of each module in Engine::moduleWidgetList */
+
+    void clear()
+    {
+        workers.clear();
+        widgets.clear();
+        ids.clear();
+    }
+    void append(W *worker, ModuleWidget *widget, int id)
+    {
+        workers.append(worker);
+        widgets.append(widget);
+        ids.append(id);
+    }
+};
+
+/*!
+ * @brief The ModuleBatch of each module type, handed from the GUI
+ * thread to the driver thread through a SwapBuffer
+ *
+ * Engine::updateBatches() fills the write instance and publishes it.
+ * The driver thread takes it over at the start of its callbacks, so
+ * that it never walks arrays the GUI thread is changing.
+ */
+struct ModuleBatches {
+    ModuleBatch<MidiArp> arps;
+    ModuleBatch<MidiLfo> lfos;
+    ModuleBatch<MidiSeq> seqs;
+
+    int count() const
+    {
+        return arps.workers.count() + lfos.workers.count()
+                + seqs.workers.count();
+    }
+};
+
 /*!
  * @brief Core Engine Class. Instantiates SeqDriver and JackDriver.
  *
  * For each module type there is a QList for each of
  * its components (for example MidiArp and ArpWidget). In parallel there is
- * a common list for all modules containing their DockWidgets.
+ * a common list for all modules containing their DockWidgets. The
+ * realtime callbacks use a ModuleBatch per module type instead.
  * Engine also instantiates the MIDI Driver backend and processes MIDI
  * events coming in and going out. It dispatches incoming events to the
  * worker modules and schedules resulting events back to the driver.
@@ -83,6 +136,8 @@ class Engine : public QObject  {
   private:
     QList<MidiWorker *> midiWorkerList;
     QList<ModuleWidget *> moduleWidgetList;
+    SwapBuffer<ModuleBatches> batches;
+    std::atomic<bool> rtBusy;   /**< The driver thread is within a callback using batches */
 
     int portCount;
     bool modified;
@@ -100,20 +155,73 @@ class Engine : public QObject  {
 
     //From SeqDriver
     int schedDelayTicks;
-    int nextMinTick;
-    int currentTick;
-    int requestTick;
+    int64_t nextMinTick;
+    int64_t currentTick;
+    int64_t requestTick;
     bool sendLogEvents;
     int logEventCount;
     QVector<MidiEvent> logEventBuffer;
-    QVector<int> logTickBuffer;
+    QVector<int64_t> logTickBuffer;
 
     MTimer *dispTimer;
 
-    static bool midi_event_received_callback(void * context, MidiEvent ev);
+    static bool midi_event_received_callback(void * context, MidiEvent ev, uint64_t tick);
     static void tick_callback(void * context, bool echo_from_trig);
     static void tr_state_cb(bool tr_state, void * context);
     static void tempo_callback(double bpm, void *context);
+
+/**
+ * @brief Rebuilds the ModuleBatches from moduleWidgetList and
+ * publishes them to the driver thread
+ *
+ * It returns once the driver thread no longer uses the previous
+ * batches, so that a worker removed from them can be deleted.
+ */
+    void updateBatches();
+/**
+ * @brief Takes over the latest published batches, called by the
+ * driver thread at the start of its callbacks, which then end with
+ * rtBusy = false
+ */
+    const ModuleBatches &beginBatches();
+/**
+ * @brief Gets the earliest nextTick minus schedDelayTicks of a batch
+ * into nextMinTick
+ *
+ * @param first True if no module was checked before in this echo
+ */
+    template <class W> void updateMinTick(const ModuleBatch<W> &batch,
+                bool *first);
+/**
+ * @brief Renders and sends the frames of all modules of a batch that
+ * are due at tick, called by echoCallback()
+ */
+    template <class W> void renderBatch(const ModuleBatch<W> &batch,
+                bool echo_from_trig, int64_t tick, bool *restoreFlag);
+/**
+ * @brief Passes an incoming event to all modules of a batch, called
+ * by eventCallback()
+ *
+ * The first frame of a module triggered by the keyboard is rendered
+ * right away.
+ * @param lastId Index of the last module in moduleWidgetList
+ * @param unmatched Set to the result of the module at lastId, if it
+ * is part of the batch
+ */
+    template <class W> void dispatchBatch(const ModuleBatch<W> &batch,
+                MidiEvent inEv, int64_t tick, int keep_rel, int lastId,
+                bool *unmatched, bool *restoreFlag);
+/**
+ * @brief Updates the module display state, gets the next frame of
+ * worker and sends it to the driver
+ */
+    template <class W> void renderFrame(W *worker, ModuleWidget *widget,
+                int64_t tick, bool *restoreFlag);
+/**
+ * @brief Sends the MidiWorker::outFrameCount events of the frame last
+ * prepared by worker to the driver
+ */
+    template <class W> void sendFrame(W *worker);
   public:
     int grooveTick, grooveVelocity, grooveLength;
     int restoreModIx;
@@ -130,6 +238,23 @@ class Engine : public QObject  {
     Engine(GlobStore *p_globStore, GrooveWidget *p_grooveWidget, int p_portCount, bool p_alsamidi, QWidget* parent=0);
     ~Engine();
     int getPortCount();
+/*!
+* @brief changes the number of output ports of the driver and of the
+* module port selectors.
+*
+* Only the JACK driver supports this at runtime, the ALSA driver keeps
+* its ports.
+* @param count Number of output ports requested
+* @return Number of output ports available afterwards
+*/
+    int setPortCount(int count);
+/**
+* @brief applies realtime thread settings to the driver and pins
+* the GUI and display timer threads
+*
+* @param policy Settings to apply, see RtPolicy
+*/
+    void setRtPolicy(const RtPolicy &policy);
     bool isModified();
     bool alsaMidi; /**< True when using alsa MIDI driver */
 
@@ -152,6 +277,14 @@ class Engine : public QObject  {
     MidiWorker *midiWorker(int index);
 
     int getClientId();
+/**
+ * @brief Resizes the driver's output event pool for the loaded modules
+ *
+ * Reserves MODPOOL scheduled events per module on top of SEQPOOL, so
+ * that large sessions do not run out of ALSA output pool. Not realtime
+ * safe, called after a session has been loaded.
+ */
+    void sizeOutputPool();
     void setTempo(double bpm);
     void sendGroove(int ix = -1);
     void showAllIOPanels(bool on);
@@ -163,7 +296,7 @@ class Engine : public QObject  {
  * @param ev MidiEvent received by Engine
  * @param tick Set to the tick value at which the event was received
  */
-    void midiEventReceived(MidiEvent ev, int tick);
+    void midiEventReceived(MidiEvent ev, int64_t tick);
 /**
  * @brief This signal is connected to the MainWindow::updateTempo() slot
  *
@@ -320,8 +453,9 @@ class Engine : public QObject  {
  * is regularly transferred to the LogWidget by updateDisplay().
  *
  * @param inEv MidiEvent structure that should be handled
+ * @param tick Tick at which the driver received the event
  */
-    bool eventCallback(MidiEvent inEv);
+    bool eventCallback(MidiEvent inEv, int64_t tick);
 /**
  * @brief core function called by the driver every time an echo is pending
  *
@@ -338,7 +472,7 @@ class Engine : public QObject  {
 * and incoming MIDI event
  */
     void echoCallback(bool echo_from_trig);
-    void resetTicks(int curtick);
+    void resetTicks(int64_t curtick);
 /*!
 * @brief Called by the display MTimer event loop
 
@@ -23,14 +23,19 @@
  */
 
 #include "jackdriver.h"
+#include "rtcheck.h"
+#include <errno.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 
 JackDriver::JackDriver(
     int p_portCount,
     void * callback_context,
     void (* p_tr_state_cb)(bool j_tr_state, void * context),
-    bool (* midi_event_received_callback)(void * context, MidiEvent ev),
+    bool (* midi_event_received_callback)(void * context, MidiEvent ev, uint64_t tick),
     void (* tick_callback)(void * context, bool echo_from_trig),
     void (* p_tempo_callback)(double bpm, void * context))
     : DriverBase(p_portCount, callback_context, midi_event_received_callback, tick_callback, 60e9)
@@ -46,9 +51,25 @@ JackDriver::JackDriver(
     evPortQueue.resize(JQ_BUFSZ);
     bufPtr = 0;
     echoPtr = 0;
-    tempoChangeTick = 0;
-    tempoChangeJPosFrame = 0;
+    transportFrame = 0;
+    midiTick = 0;
     jackNFrames = 256;
+    lastFrameTime = 0;
+    frameTimeValid = false;
+    stackPrefaulted = false;
+    newSampleRate = 0;
+    maxCompFrames = 0;
+    portCapacity = (portCount > MAX_PORTS) ? portCount : MAX_PORTS;
+    JackOutPort **table = new JackOutPort *[portCapacity];
+    memset(table, 0, portCapacity * sizeof(JackOutPort *));
+    outPorts = table;
+    retiredCycle = 0;
+    activePorts = 0;
+    cycleCount = 0;
+    cycleWanted = false;
+    sem_init(&cycleDone, 0, 0);
+    cyclePorts = table;
+    cyclePortCount = 0;
     trStartingTick = 0;
     trLoopingTick = 0;
 
@@ -94,11 +115,15 @@ JackDriver::~JackDriver()
         jack_client_close(jack_handle);
         jack_handle = 0;
     }
+    JackOutPort **ports = outPorts;
+    for (int l1 = 0; l1 < portCapacity; l1++) delete ports[l1];
+    delete[] ports;
+    freeRetiredTables();
+    sem_destroy(&cycleDone);
 }
 
 int JackDriver::initJack(int out_port_count, const QString & clientname)
 {
-    char buf[16];
 
 #ifdef JACK_SESSION
        if (global_jack_session_uuid.isEmpty() || !out_port_count) {
@@ -121,6 +146,10 @@ int JackDriver::initJack(int out_port_count, const QString & clientname)
     jack_on_shutdown(jack_handle, jack_shutdown, (void *)this);
 
     jack_set_process_callback(jack_handle, process_callback, (void *)this);
+    jack_set_buffer_size_callback(jack_handle, buffer_size_callback, (void *)this);
+    jack_set_sample_rate_callback(jack_handle, sample_rate_callback, (void *)this);
+    jack_set_latency_callback(jack_handle, latency_callback, (void *)this);
+    jack_set_port_connect_callback(jack_handle, port_connect_callback, (void *)this);
 
     qWarning("jack process callback registered");
 
@@ -135,13 +164,9 @@ int JackDriver::initJack(int out_port_count, const QString & clientname)
     // register JACK MIDI output ports
     for (int l1 = 0; l1 < out_port_count; l1++)
     {
-      snprintf(buf, sizeof(buf), "out %d", l1 + 1);
-      if ((out_ports[l1] = jack_port_register(jack_handle, buf, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0)) == 0)
-      {
-        qCritical("Failed to register JACK MIDI output port.");
-        return 1;
-      }
+      if (!registerPort(l1)) return 1;
     }
+    activePorts = out_port_count;
 
 #ifdef JACK_SESSION
     jack_set_session_callback(jack_handle, session_callback, (void *)this);
@@ -153,6 +178,8 @@ int JackDriver::initJack(int out_port_count, const QString & clientname)
 
 int JackDriver::activateJack()
 {
+    frameTimeValid = false;
+    stackPrefaulted = false;
     if (jack_activate(jack_handle)) {
         qWarning("cannot activate client");
         jackRunning = false;
@@ -160,6 +187,13 @@ int JackDriver::activateJack()
     }
 
     jackRunning = true;
+    // the JACK server sets the priority, the CPU is ours to choose. The
+    // process thread inherits the CPU of the GUI thread if that one was
+    // pinned. Other client threads keep their CPUs.
+    if ((rtPolicy.cpu >= 0) || (rtPolicy.guiCpu >= 0)) {
+        if (!rtSetAffinity(jack_client_thread_id(jack_handle), rtPolicy.cpu))
+            qWarning("Could not move JACK process thread to CPU %d", rtPolicy.cpu);
+    }
     return(0);
 }
 
@@ -185,29 +219,171 @@ void JackDriver::jack_shutdown(void *arg)
     emit rd->j_shutdown();
 }
 
+int JackDriver::buffer_size_callback(jack_nframes_t nframes, void *arg)
+{
+    JackDriver *rd = (JackDriver *) arg;
+    rd->jackNFrames = nframes;
+    return(0);
+}
+
+int JackDriver::sample_rate_callback(jack_nframes_t nframes, void *arg)
+{
+    // not called by the process thread, the tempo map is rescaled there
+    JackDriver *rd = (JackDriver *) arg;
+    rd->newSampleRate = nframes;
+    return(0);
+}
+
+void JackDriver::latency_callback(jack_latency_callback_mode_t mode, void *arg)
+{
+    JackDriver *rd = (JackDriver *) arg;
+    jack_latency_range_t range;
+
+    // input and output ports are not related, only the downstream
+    // latency of our outputs matters to us
+    if (mode != JackPlaybackLatency) return;
+
+    JackOutPort **ports = rd->outPorts;
+    for (int l1 = 0; l1 < rd->activePorts; l1++) {
+        jack_port_get_latency_range(ports[l1]->port, JackPlaybackLatency, &range);
+        ports[l1]->latency = range.max;
+    }
+}
+
+void JackDriver::port_connect_callback(jack_port_id_t a, jack_port_id_t b,
+                                        int connect, void *arg)
+{
+    (void)a;
+    (void)b;
+    (void)connect;
+    ((JackDriver *) arg)->updateConnections();
+}
+
+void JackDriver::updateConnections()
+{
+    JackOutPort **ports = outPorts;
+    for (int l1 = 0; l1 < activePorts; l1++) {
+        ports[l1]->connected = (jack_port_connected(ports[l1]->port) > 0);
+    }
+}
+
+bool JackDriver::registerPort(int ix)
+{
+    char buf[16];
+    JackOutPort **ports = outPorts;
+
+    // entries of removed ports are kept and reused, they are beyond
+    // activePorts and no longer seen by the process callback
+    snprintf(buf, sizeof(buf), "out %d", ix + 1);
+    if (!ports[ix]) ports[ix] = new JackOutPort;
+    memset(ports[ix], 0, sizeof(JackOutPort));
+    ports[ix]->port = jack_port_register(jack_handle, buf,
+                            JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    if (!ports[ix]->port) {
+        qCritical("Failed to register JACK MIDI output port.");
+        return false;
+    }
+    return true;
+}
+
+void JackDriver::waitCycle()
+{
+    // a cycle running during the change may still use the old state.
+    // The cycle taking the request started after the change, when it
+    // has completed no cycle uses the old state any more
+    struct timespec timeout;
+
+    if (!jackRunning) return;
+    while (!sem_trywait(&cycleDone));
+    cycleWanted = true;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec++;
+    while (sem_timedwait(&cycleDone, &timeout) && (errno == EINTR));
+}
+
+void JackDriver::freeRetiredTables()
+{
+    // tables retired before the last completed cycle are unused
+    if (jackRunning && (cycleCount == retiredCycle)) return;
+    for (int l1 = 0; l1 < retiredTables.count(); l1++) {
+        delete[] retiredTables.at(l1);
+    }
+    retiredTables.clear();
+}
+
+int JackDriver::setPortCount(int count)
+{
+    // the transport client for ALSA has no ports
+    if (!portCount || !jackRunning) return portCount;
+    if (count < 1) count = 1;
+
+    freeRetiredTables();
+    while (portCount < count) {
+        if (portCount == portCapacity) {
+            // the new table only takes the entry addresses, the process
+            // callback keeps updating the entries through either table.
+            // The old one is freed once a later cycle has completed
+            JackOutPort **old = outPorts;
+            JackOutPort **table = new JackOutPort *[2 * portCapacity];
+            memset(table, 0, 2 * portCapacity * sizeof(JackOutPort *));
+            memcpy(table, old, portCapacity * sizeof(JackOutPort *));
+            outPorts = table;
+            retiredTables.append(old);
+            retiredCycle = cycleCount;
+            portCapacity *= 2;
+        }
+        if (!registerPort(portCount)) break;
+        portCount++;
+        activePorts = portCount;
+    }
+    while (portCount > count) {
+        portCount--;
+        activePorts = portCount;
+        waitCycle();
+        jack_port_unregister(jack_handle, outPorts.load()[portCount]->port);
+    }
+    return portCount;
+}
+
 int JackDriver::process_callback(jack_nframes_t nframes, void *arg)
 {
+    RT_SCOPE("JackDriver::process_callback");
     uint32_t i;
-    uint32_t l1, l2;
+    uint32_t l1;
 
     JackDriver *rd = (JackDriver *) arg;
-    uint32_t out_port_count = rd->portCount;
+    // only the process thread prefaults its stack, not the other
+    // client threads that a thread init callback would also run in
+    if (!rd->stackPrefaulted) {
+        rtPrefaultStack();
+        rd->stackPrefaulted = true;
+    }
+    // a waitCycle() request is taken before anything else is loaded,
+    // the count is published after the table, so it is loaded first
+    bool cycle_wanted = rd->cycleWanted.exchange(false);
+    uint32_t out_port_count = rd->activePorts;
+    JackOutPort **ports = rd->outPorts;
+    rd->cyclePorts = ports;
+    rd->cyclePortCount = out_port_count;
     rd->jackTrCheckState();
 
-    if (!out_port_count) return (0);
+    if (!out_port_count) {
+        rd->cycleCount++;
+        if (cycle_wanted) sem_post(&rd->cycleDone);
+        return (0);
+    }
 
     rd->handleEchoes(nframes);
 
-    int cur_tempo = rd->tempo;
-    uint64_t cur_j_frame = rd->curJFrame;
+    uint64_t cycle_frame = rd->transportFrame;
     bool forward_unmatched = rd->forwardUnmatched;
     int port_unmatched = rd->portUnmatched;
-    uint64_t tempochangetick = rd->tempoChangeTick;
     uint64_t nexttick = 0;
-    uint64_t tmptick = 0;
+    int64_t key = 0;
+    int64_t tmpkey = 0;
     uint32_t idx = 0;
     int evport;
-    uint64_t ev_jframe, ev_sample;
+    int64_t ev_frame;
     uint32_t ev_inframe;
     MidiEvent inEv;
     inEv.type = 0;
@@ -219,15 +395,30 @@ int JackDriver::process_callback(jack_nframes_t nframes, void *arg)
 
     unsigned char* buffer;
     jack_midi_event_t in_event;
+    size_t in_pos;
+    uint32_t in_len;
+    const uint8_t *msg;
+    uint32_t msg_len;
     jack_nframes_t event_index = 0;
-    jack_nframes_t j_sample_rate = rd->jSampleRate;
     void *in_buf = jack_port_get_buffer(rd->in_port, nframes);
-    void *out_buf[out_port_count];
-    for (l1 = 0; l1 < out_port_count; l1++) {
-        out_buf[l1] = jack_port_get_buffer(rd->out_ports[l1], nframes);
-    }
+    /* Only ports connected in this cycle get a buffer and events. A
+     * port written since its last clear is cleared once more, so that
+     * it does not repeat its last events after being disconnected.
+     * Other ports are not touched. */
     for (l1 = 0; l1 < out_port_count; l1++) {
-        jack_midi_clear_buffer(out_buf[l1]);
+        JackOutPort *port = ports[l1];
+        if (port->connected) {
+            port->buffer = jack_port_get_buffer(port->port, nframes);
+            jack_midi_clear_buffer(port->buffer);
+            port->dirty = false;
+        }
+        else {
+            if (port->dirty) {
+                jack_midi_clear_buffer(jack_port_get_buffer(port->port, nframes));
+                port->dirty = false;
+            }
+            port->buffer = NULL;
+        }
     }
 
     jack_nframes_t event_count = jack_midi_get_event_count(in_buf);
@@ -236,97 +427,83 @@ int JackDriver::process_callback(jack_nframes_t nframes, void *arg)
     for(i = 0; i < nframes; i++) {
 
         /* MIDI Output queue first **/
-        if (rd->bufPtr) { /* If we have events, find earliest event tick **/
+        if (rd->bufPtr) { /* If we have events, find the earliest one to send,
+                            taking the latency compensation of its port into account **/
             idx = 0;
-            nexttick = rd->evTickQueue.first();
+            key = INT64_MAX;
             for (l1 = 0; l1 < rd->bufPtr; l1++) {
-                tmptick = rd->evTickQueue.at(l1);
-                if (nexttick > tmptick) {
+                evport = rd->evPortQueue.at(l1);
+                tmpkey = rd->evTickQueue.at(l1);
+                if (evport < (int)out_port_count) tmpkey -= ports[evport]->compTicks;
+                /* notes go first among events due at the same time */
+                if ((key > tmpkey) || ((key == tmpkey)
+                        && (rd->evQueue.at(l1).type == EV_NOTEON)
+                        && (rd->evQueue.at(idx).type != EV_NOTEON))) {
                     idx = l1;
-                    nexttick = tmptick;
+                    key = tmpkey;
                 }
             }
-            ev_sample = (uint64_t)j_sample_rate * 60 * (nexttick - tempochangetick) / TPQN / cur_tempo;
-            ev_jframe = ev_sample / nframes;
-            ev_inframe = ev_sample % nframes;
-            if ((ev_jframe <= cur_j_frame) && (ev_inframe <= i)) {
-                //qWarning("nexttick %d, ev_frame %d, ev_inframe %d, cur_jframe %d, buf_idx %d", nexttick, ev_jframe, ev_inframe, cur_j_frame, idx);
+            nexttick = rd->evTickQueue.at(idx);
+            evport = rd->evPortQueue.at(idx);
+            ev_frame = rd->tempoMap.tickToFrame(nexttick);
+            if (evport < (int)out_port_count) ev_frame -= ports[evport]->compFrames;
+            if (ev_frame <= (int64_t)(cycle_frame + i)) {
+                /* Events due in earlier cycles go out at the cycle start */
+                ev_inframe = (ev_frame > (int64_t)cycle_frame) ? ev_frame - cycle_frame : 0;
+                //qWarning("nexttick %d, ev_frame %d, ev_inframe %d, cycle_frame %d, buf_idx %d", nexttick, ev_frame, ev_inframe, cycle_frame, idx);
                 outEv = rd->evQueue.at(idx);
-                evport = rd->evPortQueue.at(idx);
                 for (uint32_t l4 = idx ; l4 < (rd->bufPtr - 1);l4++) {
                     rd->evQueue.replace(l4, rd->evQueue.at(l4 + 1));
                     rd->evPortQueue.replace(l4, rd->evPortQueue.at(l4 + 1));
                     rd->evTickQueue.replace(l4, rd->evTickQueue.at(l4 + 1));
                 }
                 rd->bufPtr--;
-                int k = 0;
-                do {
-                    if ((ev_jframe) < cur_j_frame) ev_inframe = 0;
-                    buffer = jack_midi_event_reserve(out_buf[evport], ev_inframe + k, 3);
-                    k++;
-                } while (buffer == NULL);
-
-                buffer[2] = outEv.value;        /* velocity / value **/
-                buffer[1] = outEv.data;         /* note / controller **/
-                if (outEv.type == EV_NOTEON) {
-                    if (outEv.value) {
-                        buffer[0] = 0x90;
-                        buffer[2] = outEv.value;
-                    }
-                    else {
-                        buffer[0] = 0x80;
-                        buffer[2] = 127;
+                /* Events to removed or unconnected ports are dropped */
+                if ((evport < (int)out_port_count) && ports[evport]->buffer) {
+                    ports[evport]->dirty = true;
+                    int k = 0;
+                    do {
+                        buffer = jack_midi_event_reserve(ports[evport]->buffer, ev_inframe + k, 3);
+                        k++;
+                    } while (buffer == NULL);
+
+                    buffer[2] = outEv.value;        /* velocity / value **/
+                    buffer[1] = outEv.data;         /* note / controller **/
+                    if (outEv.type == EV_NOTEON) {
+                        if (outEv.value) {
+                            buffer[0] = 0x90;
+                            buffer[2] = outEv.value;
+                        }
+                        else {
+                            buffer[0] = 0x80;
+                            buffer[2] = 127;
+                        }
                     }
+                    else if (outEv.type == EV_CONTROLLER) buffer[0] = 0xb0;
+                    buffer[0] += outEv.channel;
                 }
-                else if (outEv.type == EV_CONTROLLER) buffer[0] = 0xb0;
-                buffer[0] += outEv.channel;
             }
         }
         /* MIDI Input handling **/
         while ((in_event.time == i) && (event_index < event_count)) {
 
-            if( ((*(in_event.buffer) & 0xf0)) == 0x90 ) {
-                inEv.type = EV_NOTEON;
-                inEv.value = *(in_event.buffer + 2);
-            }
-            else if( ((*(in_event.buffer)) & 0xf0) == 0x80 ) {
-                inEv.type = EV_NOTEOFF;
-                inEv.value = *(in_event.buffer + 2);
-            }
-            else if( ((*(in_event.buffer)) & 0xf0) == 0xa0 ) {
-                inEv.type = EV_KEYPRESS;
-                inEv.value = *(in_event.buffer + 2);
-            }
-            else if( ((*(in_event.buffer)) & 0xf0) == 0xb0 ) {
-                inEv.type = EV_CONTROLLER;
-                inEv.value = *(in_event.buffer + 2);
-            }
-            else if( ((*(in_event.buffer)) & 0xf0) == 0xc0 ) {
-                inEv.type = EV_PGMCHANGE;
-                inEv.value = *(in_event.buffer + 1);
-            }
-            else if( ((*(in_event.buffer)) & 0xf0) == 0xd0 ) {
-                inEv.type = EV_CHANPRESS;
-                inEv.value = *(in_event.buffer + 1);
-            }
-            else if( ((*(in_event.buffer)) & 0xf0) == 0xe0 ) {
-                inEv.type = EV_PITCHBEND;
-                inEv.value = *(in_event.buffer + 2) * 128;
-                inEv.value += *(in_event.buffer + 1);
-                inEv.value -= 8192;
-            }
-            else inEv.type = EV_NONE;
+            in_pos = 0;
+            while ((in_len = rd->midiDecoder.decode(in_event.buffer + in_pos,
+                        in_event.size - in_pos, &inEv, &msg, &msg_len))) {
+                in_pos += in_len;
+                if (!msg_len) continue;
 
-            inEv.data = *(in_event.buffer + 1);
-            inEv.channel = (*(in_event.buffer)) & 0x0f;
-            bool unmatched = rd->midi_event_received(inEv);
+                if ((inEv.type == EV_CLOCK) && rd->useMidiClock)
+                    rd->handleMidiClock(rd->transportFrame + i);
 
-            if (unmatched && forward_unmatched) {
-                buffer = jack_midi_event_reserve(out_buf[port_unmatched], i, in_event.size);
-                if (buffer) {
-                    for (l2 = 0; l2 < in_event.size; l2++) {
-                        buffer[l2] = *(in_event.buffer + l2);
-                    }
+                bool unmatched = rd->midi_event_received(inEv,
+                            rd->tempoMap.frameToTick(rd->transportFrame + i));
+
+                if (unmatched && forward_unmatched
+                        && (port_unmatched < (int)out_port_count)
+                        && ports[port_unmatched]->buffer) {
+                    ports[port_unmatched]->dirty = true;
+                    jack_midi_event_write(ports[port_unmatched]->buffer, i, msg, msg_len);
                 }
             }
 
@@ -335,7 +512,8 @@ int JackDriver::process_callback(jack_nframes_t nframes, void *arg)
                 jack_midi_event_get(&in_event, in_buf, event_index);
         }
     }
-    rd->curJFrame++;
+    rd->cycleCount++;
+    if (cycle_wanted) sem_post(&rd->cycleDone);
     return(0);
 }
 
@@ -422,10 +600,33 @@ jack_position_t JackDriver::getCurrentPos()
     return currentPos;
 }
 
+jack_nframes_t JackDriver::getFramesSinceCycleStart()
+{
+    if (!jackRunning || (transportState != JackTransportRolling)) return 0;
+    return jack_frames_since_cycle_start(jack_handle);
+}
+
 void JackDriver::sendMidiEvent(MidiEvent ev, uint64_t n_tick, unsigned outport, unsigned duration)
 {
   //qWarning("sendMidiEvent([%d, %d, %d, %d], %u, %u) at tick %d", ev.type, ev.channel, ev.data, ev.value, outport, duration, n_tick);
 
+    JackOutPort **ports = outPorts;
+
+    if (((int)outport < activePorts) && !admitEvent(ports[outport]->budget, ev, n_tick)) {
+        /* coalesce with a queued event for the same controller */
+        if (ev.type != EV_CONTROLLER) return;
+        for (uint32_t l1 = 0; l1 < bufPtr; l1++) {
+            MidiEvent qev = evQueue.at(l1);
+            if ((evPortQueue.at(l1) == outport) && (qev.type == EV_CONTROLLER)
+                    && (qev.channel == ev.channel) && (qev.data == ev.data)) {
+                qev.value = ev.value;
+                evQueue.replace(l1, qev);
+                return;
+            }
+        }
+        return;
+    }
+
     if (bufPtr > JQ_BUFSZ - 2) {
         printf("WARNING: Event buffer overflow. Buffer cleared.\n");
         bufPtr = 0;
@@ -444,6 +645,20 @@ void JackDriver::sendMidiEvent(MidiEvent ev, uint64_t n_tick, unsigned outport,
     }
 }
 
+uint32_t JackDriver::getPortOverloads(int port)
+{
+    if ((port < 0) || (port >= activePorts)) return 0;
+    return outPorts.load()[port]->budget.overloads;
+}
+
+void JackDriver::setRtPolicy(const RtPolicy &policy)
+{
+    rtPolicy = policy;
+    if (!jackRunning) return;
+    if (!rtSetAffinity(jack_client_thread_id(jack_handle), rtPolicy.cpu))
+        qWarning("Could not move JACK process thread to CPU %d", rtPolicy.cpu);
+}
+
 bool JackDriver::requestEchoAt(uint64_t echo_tick, bool echo_from_trig)
 {
     if (echoPtr > JQ_BUFSZ - 1) {
@@ -460,16 +675,54 @@ bool JackDriver::requestEchoAt(uint64_t echo_tick, bool echo_from_trig)
 
 }
 
+void JackDriver::updateCompensation()
+{
+    JackOutPort **ports = cyclePorts;
+
+    maxCompFrames = 0;
+    for (int l1 = 0; l1 < cyclePortCount; l1++) {
+        JackOutPort *port = ports[l1];
+        port->compFrames = port->latency
+                + (int64_t)port->offset * jSampleRate / 1000;
+        port->compTicks = port->compFrames * tempo * TPQN / 60. / jSampleRate;
+        if (port->compFrames > (int64_t)maxCompFrames) maxCompFrames = port->compFrames;
+    }
+}
+
+void JackDriver::setPortOffset(int port, int ms)
+{
+    if ((port < 0) || (port >= activePorts)) return;
+    outPorts.load()[port]->offset = ms;
+}
+
 void JackDriver::handleEchoes(int nframes)
 {
     jackNFrames = nframes;
 
+    /* JACK frame time counts every frame including those lost in xruns
+     * and wraps around after 2^32 frames, the difference to the previous
+     * cycle does neither */
+    jack_nframes_t frame_time = jack_last_frame_time(jack_handle);
+    jack_nframes_t elapsed = frameTimeValid ? frame_time - lastFrameTime : 0;
+    lastFrameTime = frame_time;
+    frameTimeValid = true;
+    if (!useJackSync) transportFrame += elapsed;
+
+    if (newSampleRate && (newSampleRate != jSampleRate)) {
+        jSampleRate = newSampleRate;
+        if (!useJackSync) {
+            // keep the current tick and continue at the new rate
+            uint64_t tick = tempoMap.frameToTick(transportFrame);
+            tempoMap.setRate(jSampleRate);
+            tempoMap.reset(transportFrame, tick, tempo);
+        }
+    }
+
     if (useJackSync) {
-        m_current_tick = ((uint64_t)currentPos.frame - tempoChangeJPosFrame)
-            * TPQN * tempo / (currentPos.frame_rate * 60) + tempoChangeTick;
+        transportFrame = currentPos.frame;
+        m_current_tick = tempoMap.frameToTick(transportFrame);
             if ((currentPos.beats_per_minute != tempo)
                     && (currentPos.beats_per_minute > 0.01))  {
-                tempoChangeJPosFrame = currentPos.frame;
                 setTempo(currentPos.beats_per_minute);
                 // inform engine via callback about the tempo change
                 tempoCb(tempo, cbContext);
@@ -477,28 +730,28 @@ void JackDriver::handleEchoes(int nframes)
             }
     }
     else {
-        m_current_tick =  (uint64_t)curJFrame * TPQN * tempo * nframes
-            / (jSampleRate * 60) + tempoChangeTick;
+        m_current_tick = tempoMap.frameToTick(transportFrame);
         if (requestedTempo != tempo) setTempo(requestedTempo);
     }
+    updateCompensation();
 
-    if (!queueStatus) {
-        curJFrame++;
-        return;
-    }
+    if (!queueStatus) return;
     if (!echoPtr) return;
 
     int idx = 0;
-    int nexttick = echoTickQueue.first();
+    uint64_t nexttick = echoTickQueue.first();
 
     for (uint32_t l1 = 0; l1 < echoPtr; l1++) {
-        int tmptick = echoTickQueue.at(l1);
+        uint64_t tmptick = echoTickQueue.at(l1);
         if (nexttick > tmptick) {
             idx = l1;
             nexttick = tmptick;
         }
     }
-    if (m_current_tick >= echoTickQueue.at(idx)) {
+    // echoes fire early by the largest latency compensation, the
+    // modules render their frames for the echo tick
+    if (tempoMap.frameToTick(transportFrame + maxCompFrames) >= nexttick) {
+        if (m_current_tick < nexttick) m_current_tick = nexttick;
         tick_callback(echoTrigFlagQueue.at(idx));
         for (uint32_t l4 = idx ; l4 < (echoPtr - 1); l4++) {
             echoTickQueue.replace(l4, echoTickQueue.at(l4 + 1));
@@ -508,10 +761,26 @@ void JackDriver::handleEchoes(int nframes)
     }
 }
 
+void JackDriver::handleMidiClock(uint64_t frame)
+{
+    if (!midiTick) clockDll.reset();
+    clockDll.update(frame);
+
+    // continue the map from the filtered clock time each clock
+    if (clockDll.locked()) {
+        tempo = clockDll.tempo(jSampleRate);
+        internalTempo = tempo;
+        requestedTempo = tempo;
+        tempoMap.reset((uint64_t)clockDll.time(),
+                midiTick * TPQN / MIDICLK_TPQN, tempo);
+    }
+    if ((midiTick % 48) == 4) tempoCb(tempo, cbContext);
+    midiTick++;
+}
+
 void JackDriver::setTempo(double bpm)
 {
-    tempoChangeTick = m_current_tick;
-    curJFrame = 0;
+    tempoMap.setTempo(transportFrame, bpm);
     tempo = bpm;
     internalTempo = bpm;
 }
@@ -524,9 +793,6 @@ void JackDriver::setTransportStatus(bool on)
             tempo = jpos.beats_per_minute;
         else
             tempo = internalTempo;
-
-        tempoChangeJPosFrame = 0;
-        tempoChangeTick = 0;
     }
     else {
         tempo = internalTempo;
@@ -534,14 +800,15 @@ void JackDriver::setTransportStatus(bool on)
 
     if (on) {
         if (useJackSync) {
-            m_current_tick = ((uint64_t)currentPos.frame - tempoChangeJPosFrame)
-                * TPQN * tempo / (currentPos.frame_rate * 60) + tempoChangeTick;
-            curJFrame = ((uint64_t)currentPos.frame - tempoChangeJPosFrame) * (jSampleRate * 60) / jackNFrames / (currentPos.frame_rate * 60);
+            tempoMap.setRate(currentPos.frame_rate ? currentPos.frame_rate : jSampleRate);
+            transportFrame = currentPos.frame;
         } else {
-            m_current_tick = 0;
-            curJFrame = 0;
+            tempoMap.setRate(jSampleRate);
+            transportFrame = 0;
         }
-        tempoChangeTick = 0;
+        tempoMap.reset(0, 0, tempo);
+        m_current_tick = tempoMap.frameToTick(transportFrame);
+        midiTick = 0;
         lastSchedTick = 0;
         echoPtr = 0;
         bufPtr = 0;
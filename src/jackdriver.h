@@ -24,6 +24,8 @@
 #ifndef JACKSYNC_H
 #define JACKSYNC_H
 
+#include <atomic>
+#include <semaphore.h>
 #include <QVector>
 #include "config.h"
 #include <jack/jack.h>
@@ -36,9 +38,25 @@
 
 #include "main.h"
 #include "driverbase.h"
+#include "timebase.h"
 
 extern QString global_jack_session_uuid;
 
+/*! @brief State of one JACK MIDI output port of JackDriver */
+struct JackOutPort {
+    jack_port_t *port;
+    void *buffer;       /*!< Port buffer in the current cycle, NULL if the
+                            port was not connected at the cycle start */
+    bool connected;     /*!< The port has connections, no events are written if not */
+    bool dirty;         /*!< Events were written since the last clear,
+                            owned by the process callback */
+    int latency;        /*!< Playback latency downstream in frames */
+    int offset;         /*!< Manual latency offset in ms */
+    int64_t compFrames; /*!< Frames events to this port are sent early by */
+    int64_t compTicks;  /*!< compFrames at the current tempo in ticks */
+    PortBudget budget;  /*!< Bandwidth governor state */
+};
+
 /*!
  * The JackDriver class provides access from Engine to the MIDI interface
  * of the Jack Audio Connection Kit (JACK) system. It provides
@@ -57,6 +75,19 @@ extern QString global_jack_session_uuid;
  * the JackDriver::evQueue. After the
  * event output, a new echo event is scheduled for the next MIDI event
  * to be output, which will again call the Engine, and so on.
+ * When following an external MIDI clock, the incoming clocks are
+ * filtered by a ClockDll, and the tempo map continues from the
+ * filtered time of each clock.
+ * Events are sent early by the playback latency downstream of their
+ * output port plus a manual offset per port. Echoes fire early by the
+ * largest of these, so that the modules render their frames in time.
+ * Output ports without connections are skipped by the process callback.
+ * Ports can be added and removed at runtime with setPortCount(), the
+ * port table grows as needed, MAX_PORTS only sets its initial size.
+ * With a port bandwidth set, controller events refused by the governor
+ * are merged into a queued event for the same controller if there is
+ * one, and dropped otherwise. Of events due at the same time, notes are
+ * sent first.
  * JackDriver derives from DriverBase, which is a QThread
  * class, but it does not implement other threads than the JACK process.
  *
@@ -69,21 +100,44 @@ class JackDriver : public DriverBase
   private:
     static int process_callback(jack_nframes_t nframes, void *arg);
     static void jack_shutdown(void *arg);
+    static int buffer_size_callback(jack_nframes_t nframes, void *arg);
+    static int sample_rate_callback(jack_nframes_t nframes, void *arg);
+    static void latency_callback(jack_latency_callback_mode_t mode, void *arg);
+    static void port_connect_callback(jack_port_id_t a, jack_port_id_t b,
+                                        int connect, void *arg);
 #ifdef JACK_SESSION
     static void session_callback(jack_session_event_t *ev, void *arg);
 #endif
     void update_ports();
 
     jack_port_t * in_port;
-    jack_port_t * out_ports[MAX_PORTS];
+    std::atomic<JackOutPort **> outPorts;   /**< Output port table, replaced when it grows.
+                                                The entries keep their address */
+    int portCapacity;                       /**< Number of entries in the port table */
+    QVector<JackOutPort **> retiredTables;  /**< Replaced tables not yet freed */
+    uint32_t retiredCycle;                  /**< cycleCount when the last table was retired */
+    std::atomic<int> activePorts;           /**< Output ports served by the process callback */
+    std::atomic<uint32_t> cycleCount;       /**< Number of completed process cycles */
+    std::atomic<bool> cycleWanted;          /**< waitCycle() waits for the next cycle */
+    sem_t cycleDone;                        /**< Posted at the end of the cycle waited for */
+    JackOutPort **cyclePorts;               /**< Port table used by the current cycle */
+    int cyclePortCount;                     /**< Port count used by the current cycle */
 
     bool jackRunning;
     uint32_t transportState;
     uint32_t jackNFrames;
+    jack_nframes_t lastFrameTime;   /**< JACK frame time of the last cycle start */
+    bool frameTimeValid;            /**< lastFrameTime was taken in a previous cycle */
+    bool stackPrefaulted;           /**< The process thread has touched its stack */
+    jack_nframes_t newSampleRate;   /**< Sample rate to be applied at the next cycle start */
+    uint64_t maxCompFrames;         /**< Largest positive compFrames, the echo lookahead */
     uint64_t lastSchedTick;
-    uint64_t tempoChangeTick;
-    uint64_t curJFrame;
-    uint64_t tempoChangeJPosFrame;
+    MidiDecoder midiDecoder;    /**< Decodes the raw bytes of the JACK MIDI input */
+    uint64_t midiTick;          /**< MIDI clocks received since the transport start */
+    ClockDll clockDll;          /**< Follows the incoming MIDI clock in frames */
+    uint64_t transportFrame;    /**< Frame of the current cycle start on the tempo map */
+    TempoMap tempoMap;          /**< Maps JACK transport frames or, if not synced, frames
+                                    since the internal transport start to ticks */
     QVector<uint64_t> echoTickQueue;
     QVector<bool> echoTrigFlagQueue;
     QVector<MidiEvent> evQueue;
@@ -94,6 +148,12 @@ class JackDriver : public DriverBase
     jack_client_t *jack_handle;
     jack_position_t currentPos;
     void handleEchoes(int nframes);
+    void updateCompensation();
+    bool registerPort(int ix);
+    void updateConnections();
+    void waitCycle();
+    void freeRetiredTables();
+    void handleMidiClock(uint64_t frame);
 
 #ifdef JACK_SESSION
   public:
@@ -106,7 +166,7 @@ class JackDriver : public DriverBase
     JackDriver(int p_portCount,
             void * callback_context,
             void (* p_tr_state_cb)(bool j_tr_state, void * context),
-            bool (* midi_event_received_callback)(void * context, MidiEvent ev),
+            bool (* midi_event_received_callback)(void * context, MidiEvent ev, uint64_t tick),
             void (* tick_callback)(void * context, bool echo_from_trig),
             void (* p_tempo_callback)(double bpm, void * context));
     ~JackDriver();
@@ -132,7 +192,12 @@ class JackDriver : public DriverBase
     jack_transport_state_t getState();
     void jackTrCheckState();
     jack_position_t getCurrentPos();
+    jack_nframes_t getFramesSinceCycleStart();
     bool requestEchoAt(uint64_t echoTick, bool echo_from_trig = 0);
+    void setPortOffset(int port, int ms);
+    int setPortCount(int count);
+    uint32_t getPortOverloads(int port);
+    void setRtPolicy(const RtPolicy &policy);
     void setTransportStatus(bool run);
     void setTempo(double bpm);
     int getClientId() {return 0; }
@@ -42,12 +42,33 @@ LfoWidget::LfoWidget(MidiLfo *p_midiLfo, GlobStore *p_globStore,
     ModuleWidget(p_midiLfo, p_globStore, p_prefs, inOutVisible, p_name),
     midiLfo(p_midiLfo)
 {
-    bool compactStyle = p_prefs->compactStyle;
+    screen = NULL;
+    cursor = NULL;
+    freqBoxIndex = 3;
+    resBoxIndex = 3;
+    sizeBoxIndex = 3;
+    waveFormBoxIndex = 0;
+    applyData();
+    modified = false;
+}
 #else
 LfoWidget::LfoWidget():
     ModuleWidget("LFO:"),
     midiLfo(NULL)
 {
+    buildUi();
+}
+#endif
+
+void LfoWidget::buildUi()
+{
+#ifdef APPBUILD
+    bool compactStyle = prefs->compactStyle;
+    MidiLfo *worker = midiLfo;
+
+    // see ModuleWidget::ensureUi()
+    midiLfo = NULL;
+#else
     bool compactStyle = true;
 #endif
 
@@ -171,6 +192,30 @@ LfoWidget::LfoWidget():
 #ifdef APPBUILD
     midiControl->addMidiLearnMenu("RecordToggle", recordButton, LFO_RECORD);
 #endif
+#ifdef APPBUILD
+    QLabel *thinBoxLabel = new QLabel(tr("&Thin"));
+    thinBox = new QComboBox;
+    thinBoxLabel->setBuddy(thinBox);
+    names.clear();
+    names << tr("off") << "=";
+    for (int l1 = 2; l1 < 5; l1++) names << QString::number(lfoThinValues[l1]);
+    thinBox->insertItems(0, names);
+    thinBox->setToolTip(tr("Output thinning: Points repeating the last sent "
+            "value or changing it by less than this are not sent"));
+    thinBox->setMinimumContentsLength(3);
+    connect(thinBox, SIGNAL(activated(int)), this,
+            SLOT(updateThinning(int)));
+
+    thinIntervalBox = new QComboBox;
+    names.clear();
+    names << "0" << "1/128" << "1/64" << "1/32" << "1/16";
+    thinIntervalBox->insertItems(0, names);
+    thinIntervalBox->setToolTip(tr("Minimum time between sent points (notes)"));
+    thinIntervalBox->setMinimumContentsLength(3);
+    connect(thinIntervalBox, SIGNAL(activated(int)), this,
+            SLOT(updateThinning(int)));
+#endif
+
     amplitude = new Slider(0, 127, 1, 8, 64, Qt::Horizontal,
             tr("&Amplitude"), this);
     connect(amplitude, SIGNAL(valueChanged(int)), this,
@@ -221,6 +266,11 @@ LfoWidget::LfoWidget():
     paramBoxLayout->addWidget(sizeBoxLabel, 1, 4);
     paramBoxLayout->addWidget(sizeBox, 1, 5);
     paramBoxLayout->addWidget(flipWaveVerticalButton, 0, 6);
+#ifdef APPBUILD
+    paramBoxLayout->addWidget(thinBoxLabel, 2, 2);
+    paramBoxLayout->addWidget(thinBox, 2, 3);
+    paramBoxLayout->addWidget(thinIntervalBox, 2, 4, 1, 2);
+#endif
     paramBoxLayout->setColumnStretch(7, 7);
 
     if (compactStyle) {
@@ -247,6 +297,31 @@ LfoWidget::LfoWidget():
 
     setLayout(widgetLayout);
     updateAmp(64);
+
+#ifdef APPBUILD
+    loopBox->setCurrentIndex(moduleData.loopMode);
+    waveFormBox->setCurrentIndex(moduleData.waveForm);
+    freqBox->setCurrentIndex(moduleData.freq);
+    resBox->setCurrentIndex(moduleData.res);
+    sizeBox->setCurrentIndex(moduleData.size);
+    amplitude->setValue(moduleData.ampl);
+    offset->setValue(moduleData.offs);
+    phase->setValue(moduleData.phase);
+    thinBox->setCurrentIndex(moduleData.thinning);
+    thinIntervalBox->setCurrentIndex(moduleData.thinInterval);
+    updateWaveForm(moduleData.waveForm);
+    freqBoxIndex = moduleData.freq;
+    resBoxIndex = moduleData.res;
+    sizeBoxIndex = moduleData.size;
+
+    midiLfo = worker;
+    std::vector<Sample> sdata;
+    midiLfo->getData(&sdata);
+    data = QVector<Sample>::fromStdVector(sdata);
+    screen->updateData(data);
+    cursor->updateNumbers(midiLfo->res, midiLfo->size);
+    midiLfo->dataChanged = false;
+#endif
 }
 
 #ifdef APPBUILD
@@ -260,31 +335,36 @@ void LfoWidget::writeData(QXmlStreamWriter& xml)
     QByteArray tempArray;
     int l1;
 
+        if (uiBuilt) controlsToData();
         writeCommonData(xml);
     
         xml.writeStartElement("waveParams");
             xml.writeTextElement("loopmode", QString::number(
-                loopBox->currentIndex()));
+                moduleData.loopMode));
             xml.writeTextElement("waveform", QString::number(
-                waveFormBox->currentIndex()));
+                moduleData.waveForm));
             xml.writeTextElement("frequency", QString::number(
-                freqBox->currentIndex()));
+                moduleData.freq));
             xml.writeTextElement("resolution", QString::number(
-                resBox->currentIndex()));
+                moduleData.res));
             xml.writeTextElement("size", QString::number(
-                sizeBox->currentIndex()));
+                moduleData.size));
             xml.writeTextElement("amplitude", QString::number(
                 midiLfo->amp));
             xml.writeTextElement("offset", QString::number(
                 midiLfo->offs));
             xml.writeTextElement("phase", QString::number(
                 midiLfo->phase));
+            xml.writeTextElement("thinning", QString::number(
+                moduleData.thinning));
+            xml.writeTextElement("thinInterval", QString::number(
+                moduleData.thinInterval));
         xml.writeEndElement();
 
         tempArray.clear();
         l1 = 0;
         while (l1 < midiLfo->maxNPoints) {
-            tempArray.append(midiLfo->muteMask.at(l1));
+            tempArray.append(midiLfo->customWave.isMuted(l1));
             l1++;
         }
         xml.writeStartElement("muteMask");
@@ -294,7 +374,7 @@ void LfoWidget::writeData(QXmlStreamWriter& xml)
         tempArray.clear();
         l1 = 0;
         while (l1 < midiLfo->maxNPoints) {
-            tempArray.append(midiLfo->customWave.at(l1).value);
+            tempArray.append(midiLfo->customWave.value(l1));
             l1++;
         }
         xml.writeStartElement("customWave");
@@ -307,8 +387,6 @@ void LfoWidget::writeData(QXmlStreamWriter& xml)
 void LfoWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
 {
     int tmp;
-    int wvtmp = 0;
-    Sample sample = {0, 0, 0, false};
 
     while (!xml.atEnd()) {
         xml.readNext();
@@ -332,40 +410,36 @@ void LfoWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 xml.readNext();
                 if (xml.isEndElement())
                     break;
-                if (xml.name() == "loopmode") {
-                    tmp = xml.readElementText().toInt();
-                    loopBox->setCurrentIndex(tmp);
-                    updateLoop(tmp);
-                }
+                if (xml.name() == "loopmode")
+                    moduleData.loopMode = xml.readElementText().toInt();
                 else if (xml.name() == "waveform")
-                    wvtmp = xml.readElementText().toInt();
-                else if (xml.name() == "frequency") {
-                    tmp = xml.readElementText().toInt();
-                    freqBox->setCurrentIndex(tmp);
-                    updateFreq(tmp);
-                }
+                    moduleData.waveForm = xml.readElementText().toInt();
+                else if (xml.name() == "frequency")
+                    moduleData.freq = xml.readElementText().toInt();
                 else if (xml.name() == "resolution") {
                     tmp = xml.readElementText().toInt();
                     if (qmaxVersion == "" && tmp < 9) {
                         tmp = mapOldLfoRes[tmp];
                     }
-                    resBox->setCurrentIndex(tmp);
-                    updateRes(tmp);
+                    moduleData.res = tmp;
                 }
                 else if (xml.name() == "size") {
                     tmp = xml.readElementText().toInt();
                     if (qmaxVersion == "" && tmp < 12) {
                         tmp = mapOldLfoSize[tmp];
                     }
-                    sizeBox->setCurrentIndex(tmp);
-                    updateSize(tmp);
+                    moduleData.size = tmp;
                 }
                 else if (xml.name() == "amplitude")
-                    amplitude->setValue(xml.readElementText().toInt());
+                    moduleData.ampl = xml.readElementText().toInt();
                 else if (xml.name() == "offset")
-                    offset->setValue(xml.readElementText().toInt());
+                    moduleData.offs = xml.readElementText().toInt();
                 else if (xml.name() == "phase")
-                    phase->setValue(xml.readElementText().toInt());
+                    moduleData.phase = xml.readElementText().toInt();
+                else if (xml.name() == "thinning")
+                    moduleData.thinning = xml.readElementText().toInt();
+                else if (xml.name() == "thinInterval")
+                    moduleData.thinInterval = xml.readElementText().toInt();
                 else skipXmlElement(xml);
             }
         }
@@ -378,7 +452,7 @@ void LfoWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                     QByteArray tmpArray =
                             QByteArray::fromHex(xml.readElementText().toLatin1());
                     for (int l1 = 0; l1 < tmpArray.count(); l1++) {
-                        midiLfo->muteMask[l1] = tmpArray.at(l1);
+                        midiLfo->customWave.setMuted(l1, tmpArray.at(l1));
                     }
                     midiLfo->maxNPoints = tmpArray.count();
                 }
@@ -393,14 +467,8 @@ void LfoWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 if (xml.isStartElement() && (xml.name() == "data")) {
                     QByteArray tmpArray =
                             QByteArray::fromHex(xml.readElementText().toLatin1());
-                    int step = TPQN / midiLfo->res;
-                    int lt = 0;
                     for (int l1 = 0; l1 < tmpArray.count(); l1++) {
-                        sample.value = tmpArray.at(l1);
-                        sample.tick = lt;
-                        sample.muted = midiLfo->muteMask[l1];
-                        midiLfo->customWave[l1] = sample;
-                        lt+=step;
+                        midiLfo->customWave.setValue(l1, tmpArray.at(l1));
                     }
                 }
                 else skipXmlElement(xml);
@@ -409,14 +477,51 @@ void LfoWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
         else skipXmlElement(xml);
     }
     
-    updateChIn(chIn->currentIndex());
-    updateChannelOut(channelOut->currentIndex());
-    updatePortOut(portOut->currentIndex());
-    waveFormBox->setCurrentIndex(wvtmp);
-    updateWaveForm(wvtmp);
+    applyData();
     midiLfo->needsGUIUpdate = false;
     modified = false;
 }
+
+void LfoWidget::applyData()
+{
+    int delta = moduleData.thinning;
+    int interval = moduleData.thinInterval;
+
+    ModuleWidget::applyData();
+    midiLfo->updateLoop(moduleData.loopMode);
+    midiLfo->updateFrequency(lfoFreqValues[moduleData.freq]);
+    midiLfo->updateResolution(lfoResValues[moduleData.res]);
+    midiLfo->updateSize(lfoSizeValues[moduleData.size]);
+    midiLfo->updateAmplitude(moduleData.ampl);
+    midiLfo->updateOffset(moduleData.offs);
+    midiLfo->updatePhase(moduleData.phase);
+    if ((delta < 0) || (delta >= 5)) delta = 0;
+    if ((interval < 0) || (interval >= 5)) interval = 0;
+    midiLfo->updateThinning(lfoThinValues[delta], lfoThinIntervals[interval]);
+    midiLfo->updateWaveForm(moduleData.waveForm);
+    midiLfo->updateData();
+    if (moduleData.waveForm == 5) midiLfo->newCustomOffset();
+
+    freqBoxIndex = moduleData.freq;
+    resBoxIndex = moduleData.res;
+    sizeBoxIndex = moduleData.size;
+    waveFormBoxIndex = moduleData.waveForm;
+}
+
+void LfoWidget::controlsToData()
+{
+    ModuleWidget::controlsToData();
+    moduleData.loopMode = loopBox->currentIndex();
+    moduleData.waveForm = waveFormBox->currentIndex();
+    moduleData.freq = freqBox->currentIndex();
+    moduleData.res = resBox->currentIndex();
+    moduleData.size = sizeBox->currentIndex();
+    moduleData.ampl = amplitude->value();
+    moduleData.offs = offset->value();
+    moduleData.phase = phase->value();
+    moduleData.thinning = thinBox->currentIndex();
+    moduleData.thinInterval = thinIntervalBox->currentIndex();
+}
 #endif
 
 void LfoWidget::loadWaveForms()
@@ -513,6 +618,21 @@ void LfoWidget::updateOffs(int val)
     screen->updateData(data);
 }
 
+void LfoWidget::updateThinning(int val)
+{
+    (void)val;
+    int delta;
+    int interval;
+
+    modified = true;
+    if (!midiLfo) return;
+    delta = thinBox->currentIndex();
+    interval = thinIntervalBox->currentIndex();
+    if ((delta < 0) || (delta >= 5)) delta = 0;
+    if ((interval < 0) || (interval >= 5)) interval = 0;
+    midiLfo->updateThinning(lfoThinValues[delta], lfoThinIntervals[interval]);
+}
+
 void LfoWidget::updatePhase(int val)
 {
     modified = true;
@@ -570,33 +690,22 @@ void LfoWidget::setRecord(bool on)
     screen->setRecordMode(on);
 }
 
-QVector<Sample> LfoWidget::getCustomWave()
-{
-    return QVector<Sample>::fromStdVector(midiLfo->customWave);
-}
-
-QVector<bool> LfoWidget::getMuteMask()
-{
-    return QVector<bool>::fromStdVector(midiLfo->muteMask);
-}
-
 #ifdef APPBUILD
 
 void LfoWidget::doStoreParams(int ix)
 {
-    parStore->temp.ccnumberIn = ccnumberInBox->value();
-    parStore->temp.ccnumber = ccnumberBox->value();
-    parStore->temp.res = resBox->currentIndex();
-    parStore->temp.size = sizeBox->currentIndex();
-    parStore->temp.loopMode = loopBox->currentIndex();
-    parStore->temp.freq = freqBox->currentIndex();
-    parStore->temp.ampl = amplitude->value();
-    parStore->temp.offs = offset->value();
-    parStore->temp.phase = phase->value();
-    parStore->temp.waveForm = waveFormBox->currentIndex();
-
-    if (midiLfo) parStore->temp.wave = getCustomWave().mid(0, midiLfo->maxNPoints);
-    if (midiLfo) parStore->temp.muteMask = getMuteMask().mid(0, midiLfo->maxNPoints);
+    parStore->temp.ccnumberIn = moduleData.ccnumberIn;
+    parStore->temp.ccnumber = moduleData.ccnumber;
+    parStore->temp.res = moduleData.res;
+    parStore->temp.size = moduleData.size;
+    parStore->temp.loopMode = moduleData.loopMode;
+    parStore->temp.freq = moduleData.freq;
+    parStore->temp.ampl = moduleData.ampl;
+    parStore->temp.offs = moduleData.offs;
+    parStore->temp.phase = moduleData.phase;
+    parStore->temp.waveForm = moduleData.waveForm;
+
+    if (midiLfo) parStore->waveToTemp(midiLfo->customWave, midiLfo->maxNPoints);
 
     parStore->tempToList(ix);
 }
@@ -605,9 +714,38 @@ void LfoWidget::doRestoreParams(int ix)
 {
     midiLfo->applyPendingParChanges();
     if (parStore->list.at(ix).empty) return;
-    for (int l1 = 0; l1 < parStore->list.at(ix).wave.count(); l1++) {
-        midiLfo->customWave[l1] = parStore->list.at(ix).wave.at(l1);
-        midiLfo->muteMask[l1] = parStore->list.at(ix).muteMask.at(l1);
+    parStore->listToWave(ix, midiLfo->customWave);
+    if (!uiBuilt) {
+        moduleData.size = parStore->list.at(ix).size;
+        moduleData.res = parStore->list.at(ix).res;
+        moduleData.waveForm = parStore->list.at(ix).waveForm;
+        moduleData.freq = parStore->list.at(ix).freq;
+        moduleData.loopMode = parStore->list.at(ix).loopMode;
+        midiLfo->updateSize(lfoSizeValues[moduleData.size]);
+        midiLfo->updateResolution(lfoResValues[moduleData.res]);
+        midiLfo->updateWaveForm(moduleData.waveForm);
+        midiLfo->updateFrequency(lfoFreqValues[moduleData.freq]);
+        midiLfo->updateLoop(moduleData.loopMode);
+        if (!parStore->onlyPatternList.at(ix)) {
+            moduleData.ampl = parStore->list.at(ix).ampl;
+            moduleData.offs = parStore->list.at(ix).offs;
+            moduleData.phase = parStore->list.at(ix).phase;
+            moduleData.ccnumberIn = parStore->list.at(ix).ccnumberIn;
+            moduleData.ccnumber = parStore->list.at(ix).ccnumber;
+            midiLfo->updateAmplitude(moduleData.ampl);
+            midiLfo->updateOffset(moduleData.offs);
+            midiLfo->updatePhase(moduleData.phase);
+            midiLfo->ccnumberIn = moduleData.ccnumberIn;
+            midiLfo->ccnumber = moduleData.ccnumber;
+        }
+        midiLfo->updateData();
+        if (moduleData.waveForm == 5) midiLfo->newCustomOffset();
+        freqBoxIndex = moduleData.freq;
+        resBoxIndex = moduleData.res;
+        sizeBoxIndex = moduleData.size;
+        waveFormBoxIndex = moduleData.waveForm;
+        midiLfo->setFramePtr(midiLfo->reverse ? midiLfo->nPoints : 0);
+        return;
     }
     sizeBox->setCurrentIndex(parStore->list.at(ix).size);
     midiLfo->updateSize(sizeBox->currentText().toInt());
@@ -638,6 +776,9 @@ void LfoWidget::copyParamsFrom(ModuleWidget *p_fromWidget)
 
     int tmp;
 
+    ensureUi();
+    fromWidget->ensureUi();
+
     enableNoteOff->setChecked(fromWidget->enableNoteOff->isChecked());
     enableRestartByKbd->setChecked(fromWidget->enableRestartByKbd->isChecked());
     enableTrigByKbd->setChecked(fromWidget->enableTrigByKbd->isChecked());
@@ -683,11 +824,12 @@ void LfoWidget::copyParamsFrom(ModuleWidget *p_fromWidget)
     amplitude->setValue(fromWidget->amplitude->value());
     offset->setValue(fromWidget->offset->value());
     phase->setValue(fromWidget->phase->value());
+    thinBox->setCurrentIndex(fromWidget->thinBox->currentIndex());
+    thinIntervalBox->setCurrentIndex(fromWidget->thinIntervalBox->currentIndex());
+    updateThinning(0);
 
-    for (int l1 = 0; l1 < fromWidget->getMidiWorker()->maxNPoints; l1++) {
-        midiLfo->customWave[l1] = fromWidget->getCustomWave().at(l1);
-        midiLfo->muteMask[l1] = midiLfo->customWave.at(l1).muted;
-    }
+    midiLfo->customWave.copyFrom(fromWidget->getMidiWorker()->customWave,
+                fromWidget->getMidiWorker()->maxNPoints);
     midiControl->setCcList(fromWidget->midiControl->ccList);
     muteOutAction->setChecked(true);
 
@@ -809,6 +951,15 @@ void LfoWidget::updateDisplay()
             updateNRep(parStore->nRepList.at(parStore->activeStore));
         }
     }
+    if (!uiBuilt) {
+        if (midiLfo->dataChanged) {
+            moduleData.offs = midiLfo->offs;
+            moduleData.phase = midiLfo->phase;
+            midiLfo->dataChanged = false;
+        }
+        updateUnbuiltDisplay();
+        return;
+    }
     if (midiLfo->dataChanged) {
         midiLfo->getData(&sdata);
         data = QVector<Sample>::fromStdVector(sdata);
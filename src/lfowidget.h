@@ -94,9 +94,8 @@ class LfoWidget : public ModuleWidget
     QAction *recordAction;
     QAction *flipWaveVerticalAction;
     QComboBox *waveFormBox, *freqBox;
+    QComboBox *thinBox, *thinIntervalBox;
 
-    QVector<Sample> getCustomWave();
-    QVector<bool> getMuteMask();
     int resBoxIndex;
     int sizeBoxIndex;
     int freqBoxIndex;
@@ -153,9 +152,13 @@ class LfoWidget : public ModuleWidget
     void doRestoreParams(int ix);
     void updateDisplay();
     void handleController(int ccnumber, int channel, int value);
-    void updateCursorPos() { cursor->updatePosition(getFramePtr()); }
+    void updateCursorPos() { if (uiBuilt) cursor->updatePosition(getFramePtr()); }
+    void applyData() override;
+    void controlsToData() override;
 #endif
 
+    void buildUi() override;
+
 /* SIGNALS */
   signals:
 /*! @brief Currently not in use. */
@@ -239,6 +242,15 @@ class LfoWidget : public ModuleWidget
 *
 */
     void updatePhase(int val);
+/*!
+* @brief Slot for the LfoWidget::thinBox and LfoWidget::thinIntervalBox
+* combo boxes. Sets the output thinning of this LFO.
+*
+* @param val Index of the changed combo box, the setting is taken
+* from both boxes
+*
+*/
+    void updateThinning(int val);
 
 /*!
 * @brief Slot for the LfoScreen::mouseEvent signal.
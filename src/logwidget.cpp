@@ -67,7 +67,7 @@ LogWidget::~LogWidget()
 {
 }
 
-void LogWidget::appendEvent(MidiEvent ev, int tick) {
+void LogWidget::appendEvent(MidiEvent ev, int64_t tick) {
 
     QString qs, qs2;
 
@@ -76,28 +76,28 @@ void LogWidget::appendEvent(MidiEvent ev, int tick) {
     }
     switch (ev.type) {
         case EV_NOTEON:
-            qs.sprintf("Ch %2d, Note On %3d, Vel %3d, tick %d",
+            qs.sprintf("Ch %2d, Note On %3d, Vel %3d, tick %lld",
                     ev.channel + 1,
-                    ev.data, ev.value, tick);
+                    ev.data, ev.value, (long long)tick);
             break;
         case EV_NOTEOFF:
-            qs.sprintf("Ch %2d, Note Off %3d, tick %d", ev.channel+1,
-                    ev.data, tick);
+            qs.sprintf("Ch %2d, Note Off %3d, tick %lld", ev.channel+1,
+                    ev.data, (long long)tick);
             break;
         case EV_CONTROLLER:
             logText->setTextColor(QColor(100,160,0));
-            qs.sprintf("Ch %2d, Ctrl %3d, Val %3d, tick %d", ev.channel+1,
-                    ev.data, ev.value, tick);
+            qs.sprintf("Ch %2d, Ctrl %3d, Val %3d, tick %lld", ev.channel+1,
+                    ev.data, ev.value, (long long)tick);
             break;
         case EV_PITCHBEND:
             logText->setTextColor(QColor(100,0,255));
-            qs.sprintf("Ch %2d, Pitch %5d, tick %d", ev.channel+1,
-                    ev.value, tick);
+            qs.sprintf("Ch %2d, Pitch %5d, tick %lld", ev.channel+1,
+                    ev.value, (long long)tick);
             break;
         case EV_PGMCHANGE:
             logText->setTextColor(QColor(0,100,100));
-            qs.sprintf("Ch %2d, PrgChg %5d, tick %d", ev.channel+1,
-                    ev.value, tick);
+            qs.sprintf("Ch %2d, PrgChg %5d, tick %lld", ev.channel+1,
+                    ev.value, (long long)tick);
             break;
         case EV_CLOCK:
             if (logMidiActive) {
@@ -67,7 +67,7 @@ class LogWidget : public QWidget
   public slots:
     void logMidiToggle(bool on);
     void enableLogToggle(bool on);
-    void appendEvent(MidiEvent ev, int tick);
+    void appendEvent(MidiEvent ev, int64_t tick);
     void appendText(const QString&);
     void clear();
 };
@@ -35,9 +35,20 @@
 #include "lv2/lv2plug.in/ns/ext/state/state.h"
 #include "lv2/lv2plug.in/ns/lv2core/lv2.h"
 
+#include <vector>
+#include "wavestore.h"
+
 #define QMIDIARP_LV2_URI "https://git.code.sf.net/p/qmidiarp"
 #define QMIDIARP_LV2_PREFIX QMIDIARP_LV2_URI "#"
 
+/*! Version of the plugin state layout written by store_wave_state().
+ * States without version key hold the wave as hex strings.
+ */
+#define QMIDIARP_LV2_STATE_VERSION 1
+
+/*! Maximum rate in Hz at which wave changes are sent to the UI */
+#define QMIDIARP_LV2_WAVE_RATE 25
+
 typedef struct {
     LV2_URID atom_Object;
     LV2_URID atom_Blank;
@@ -48,6 +59,7 @@ typedef struct {
     LV2_URID atom_String;
     LV2_URID atom_eventTransfer;
     LV2_URID atom_Resource;
+    LV2_URID atom_Chunk;
     LV2_URID time_Position;
     LV2_URID time_frame;
     LV2_URID time_barBeat;
@@ -57,6 +69,12 @@ typedef struct {
     LV2_URID atom_Sequence;
     LV2_URID hex_customwave;
     LV2_URID hex_mutemask;
+    LV2_URID wave_delta;
+    LV2_URID wave_offset;
+    LV2_URID state_version;
+    LV2_URID wave_chunk;
+    LV2_URID mute_chunk;
+    LV2_URID random_seed;
     LV2_URID pattern_string;
     LV2_URID ui_up;
     LV2_URID ui_down;
@@ -73,6 +91,7 @@ static inline void map_uris(LV2_URID_Map* urid_map, QMidiArpURIs* uris) {
     uris->atom_String         = urid_map->map(urid_map->handle, LV2_ATOM__String);
     uris->atom_eventTransfer  = urid_map->map(urid_map->handle, LV2_ATOM__eventTransfer);
     uris->atom_Resource       = urid_map->map(urid_map->handle, LV2_ATOM__Resource);
+    uris->atom_Chunk          = urid_map->map(urid_map->handle, LV2_ATOM__Chunk);
     uris->time_Position       = urid_map->map(urid_map->handle, LV2_TIME__Position);
     uris->time_frame          = urid_map->map(urid_map->handle, LV2_TIME__frame);
     uris->time_barBeat        = urid_map->map(urid_map->handle, LV2_TIME__barBeat);
@@ -82,8 +101,215 @@ static inline void map_uris(LV2_URID_Map* urid_map, QMidiArpURIs* uris) {
     uris->atom_Sequence       = urid_map->map(urid_map->handle, LV2_ATOM__Sequence);
     uris->hex_customwave      = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "WAVEHEX");
     uris->hex_mutemask        = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "MUTEHEX");
+    uris->wave_delta          = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "WAVEDELTA");
+    uris->wave_offset         = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "WAVEOFFSET");
+    uris->state_version       = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "STATEVERSION");
+    uris->wave_chunk          = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "WAVE");
+    uris->mute_chunk          = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "MUTE");
+    uris->random_seed         = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "RANDOMSEED");
     uris->pattern_string      = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "ARPPATTERN");
     uris->ui_up               = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "UI_UP");
+    uris->ui_down             = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "UI_DOWN");
     uris->flip_wave           = urid_map->map(urid_map->handle, QMIDIARP_LV2_PREFIX "FLIP_WAVE");
 }
+
+/*!
+ * @brief Forges the changes of a module wave as message to the UI.
+ *
+ * uiWave holds the first uiNPoints of the wave as last sent to the UI.
+ * If the number of points differs from npoints, the full wave is sent as
+ * hex_customwave object with endTag appended, which is also forced by
+ * setting uiNPoints to 0. Otherwise only the index range between the first
+ * and the last changed point is sent as wave_delta object, with the
+ * start index in its wave_offset property. Points are encoded as in the
+ * full wave, negative values are muted.
+ *
+ * @return False if the forge buffer has no room for the message, it then
+ * has to be repeated in a later cycle.
+ */
+static inline bool forge_wave_update(LV2_Atom_Forge *forge,
+        const QMidiArpURIs* uris, const WaveStore &wave, int npoints,
+        int endTag, WaveStore &uiWave, int &uiNPoints)
+{
+    const bool full = (npoints != uiNPoints);
+    int first = 0;
+    int last = npoints - 1;
+
+    if (!full) {
+        while ((first < npoints) && (wave.value(first) == uiWave.value(first))
+                && (wave.isMuted(first) == uiWave.isMuted(first))) first++;
+        if (first == npoints) return true;
+        while ((wave.value(last) == uiWave.value(last))
+                && (wave.isMuted(last) == uiWave.isMuted(last))) last--;
+    }
+
+    const uint32_t ct = last - first + 1 + full;
+    /* event header, object with two property headers and vector header */
+    if (forge->size - forge->offset < 96 + ct * sizeof(int32_t)) return false;
+
+    LV2_Atom_Forge_Frame frame;
+    LV2_Atom_Forge_Frame vectorFrame;
+    lv2_atom_forge_frame_time(forge, 0);
+    lv2_atom_forge_object(forge, &frame, 1,
+                full ? uris->hex_customwave : uris->wave_delta);
+
+    if (!full) {
+        lv2_atom_forge_property_head(forge, uris->wave_offset, 0);
+        lv2_atom_forge_int(forge, first);
+    }
+
+    lv2_atom_forge_property_head(forge, uris->hex_customwave, 0);
+    lv2_atom_forge_vector_head(forge, &vectorFrame, sizeof(int32_t), uris->atom_Int);
+    for (int l1 = first; l1 <= last; l1++) {
+        int32_t value = wave.value(l1) * ((wave.isMuted(l1)) ? -1 : 1);
+        lv2_atom_forge_raw(forge, &value, sizeof(int32_t));
+        uiWave.setValue(l1, wave.value(l1));
+        uiWave.setMuted(l1, wave.isMuted(l1));
+    }
+    if (full) {
+        int32_t value = endTag;
+        lv2_atom_forge_raw(forge, &value, sizeof(int32_t));
+    }
+    lv2_atom_forge_pop(forge, &vectorFrame);
+    lv2_atom_forge_pad(forge, ct * sizeof(int32_t));
+
+    lv2_atom_forge_pop(forge, &frame);
+    uiNPoints = npoints;
+
+    return true;
+}
+
+/*!
+ * @brief Stores the first npoints of a module wave as plugin state.
+ *
+ * The values are stored as an atom:Chunk of one byte per point, the mute
+ * states as an atom:Chunk bitset with eight points per byte, together
+ * with the QMIDIARP_LV2_STATE_VERSION key.
+ */
+static inline LV2_State_Status store_wave_state(LV2_State_Store_Function store,
+        LV2_State_Handle handle, const QMidiArpURIs* uris,
+        const WaveStore &wave, int npoints)
+{
+    const uint32_t flags = LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE;
+    const int32_t version = QMIDIARP_LV2_STATE_VERSION;
+    std::vector<uint8_t> mutebits((npoints + 7) / 8, 0);
+
+    for (int l1 = 0; l1 < npoints; l1++) {
+        if (wave.isMuted(l1)) mutebits[l1 >> 3] |= (1 << (l1 & 7));
+    }
+
+    LV2_State_Status result = store(handle, uris->state_version, &version,
+                sizeof(int32_t), uris->atom_Int, flags);
+    if (result != LV2_STATE_SUCCESS) return result;
+
+    result = store(handle, uris->wave_chunk, wave.constData(),
+                npoints, uris->atom_Chunk, flags);
+    if (result != LV2_STATE_SUCCESS) return result;
+
+    return store(handle, uris->mute_chunk, mutebits.data(),
+                mutebits.size(), uris->atom_Chunk, flags);
+}
+
+/*!
+ * @brief Retrieves a module wave stored by store_wave_state().
+ *
+ * Falls back to the hex string keys written by earlier plugin versions
+ * if no state version key is found.
+ *
+ * @return Number of points retrieved, 0 if no valid wave was found
+ */
+static inline int retrieve_wave_state(LV2_State_Retrieve_Function retrieve,
+        LV2_State_Handle handle, const QMidiArpURIs* uris, WaveStore &wave)
+{
+    size_t size = 0;
+    uint32_t type = 0;
+    uint32_t flags = 0;
+    int npoints;
+
+    const void *version = retrieve(handle, uris->state_version, &size, &type, &flags);
+
+    if (version && (type == uris->atom_Int) && (size == sizeof(int32_t))
+            && (*(const int32_t *)version >= QMIDIARP_LV2_STATE_VERSION)) {
+
+        const uint8_t *values = (const uint8_t *)
+                retrieve(handle, uris->wave_chunk, &size, &type, &flags);
+        if (!values || (type != uris->atom_Chunk) || !size) return 0;
+
+        npoints = size;
+        if (npoints > wave.size()) npoints = wave.size();
+
+        const uint8_t *mutebits = (const uint8_t *)
+                retrieve(handle, uris->mute_chunk, &size, &type, &flags);
+        if (!mutebits || (type != uris->atom_Chunk)) size = 0;
+
+        for (int l1 = 0; l1 < npoints; l1++) {
+            wave.setValue(l1, values[l1]);
+            wave.setMuted(l1, ((size_t)(l1 >> 3) < size)
+                        && ((mutebits[l1 >> 3] >> (l1 & 7)) & 1));
+        }
+        return npoints;
+    }
+
+    /* States saved by earlier versions hold two hex characters per point */
+    const char *mutehex = (const char *)
+            retrieve(handle, uris->hex_mutemask, &size, &type, &flags);
+    if (!mutehex || (size < 2)) return 0;
+
+    npoints = (size - 1) / 2;
+    if (npoints > wave.size()) npoints = wave.size();
+
+    for (int l1 = 0; l1 < npoints; l1++) {
+        wave.setMuted(l1, (mutehex[2 * l1 + 1] == '1'));
+    }
+
+    const char *value = (const char *)
+            retrieve(handle, uris->hex_customwave, &size, &type, &flags);
+    if (!value || (size < 2)) return 0;
+    if ((size_t)npoints > (size - 1) / 2) npoints = (size - 1) / 2;
+
+    for (int l1 = 0; l1 < npoints; l1++) {
+        int hi = 0;
+        int lo = 0;
+        if (value[2*l1] <= '9' && value[2*l1] >= '0') hi = value[2*l1] - '0';
+        if (value[2*l1] <= 'f' && value[2*l1] >= 'a') hi = value[2*l1] - 'a' + 10;
+
+        if (value[2*l1 + 1] <= '9' && value[2*l1 + 1] >= '0') lo = value[2*l1 + 1] - '0';
+        if (value[2*l1 + 1] <= 'f' && value[2*l1 + 1] >= 'a') lo = value[2*l1 + 1] - 'a' + 10;
+
+        wave.setValue(l1, hi * 16 + lo);
+    }
+    return npoints;
+}
+
+/*!
+ * @brief Stores the seed of a module's random generator as plugin state.
+ */
+static inline LV2_State_Status store_random_seed(LV2_State_Store_Function store,
+        LV2_State_Handle handle, const QMidiArpURIs* uris, uint32_t seed)
+{
+    const int32_t value = seed;
+
+    return store(handle, uris->random_seed, &value, sizeof(int32_t),
+                uris->atom_Int, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+}
+
+/*!
+ * @brief Retrieves the seed of a module's random generator.
+ *
+ * @return False if the state holds no seed, which is the case for
+ * states saved by earlier versions
+ */
+static inline bool retrieve_random_seed(LV2_State_Retrieve_Function retrieve,
+        LV2_State_Handle handle, const QMidiArpURIs* uris, uint32_t &seed)
+{
+    size_t size = 0;
+    uint32_t type = 0;
+    uint32_t flags = 0;
+
+    const void *value = retrieve(handle, uris->random_seed, &size, &type, &flags);
+    if (!value || (type != uris->atom_Int) || (size != sizeof(int32_t))) return false;
+
+    seed = *(const int32_t *)value;
+    return true;
+}
 #endif
@@ -69,6 +69,7 @@
 
 #include "mainwindow.h"
 #include "main.h"
+#include "rtpolicy.h"
 
 
 static struct option options[] = {
@@ -77,13 +78,21 @@ static struct option options[] = {
 #ifdef HAVE_ALSA
     {"alsa", 0, 0, 'a'},
     {"jack", 0, 0, 'j'},
+    {"timer", 0, 0, 't'},
 #endif
     {"jack_session_uuid", required_argument, 0, 'U' },
     {"portCount", 1, 0, 'p'},
+    {"rtprio", 1, 0, 'r'},
+    {"rtcpu", 1, 0, 'c'},
+    {"guicpu", 1, 0, 'g'},
+    {"mlock", 0, 0, 'm'},
     {0, 0, 0, 0}
 };
 
 QString global_jack_session_uuid = "";
+bool global_alsa_timer = false;
+RtPolicy global_rt_policy = {0, -1, -1, false};
+bool global_rt_cmdline = false;
 
 int main(int argc, char *argv[])
 {
@@ -95,7 +104,7 @@ int main(int argc, char *argv[])
 
     QTextStream out(stdout);
     srand(getpid());
-    while ((getopt_return = getopt_long(argc, argv, "vhajUp:", options,
+    while ((getopt_return = getopt_long(argc, argv, "vhajtUp:r:c:g:m", options,
                     &option_index)) >= 0) {
         switch(getopt_return) {
             case 'v':
@@ -120,9 +129,19 @@ int main(int argc, char *argv[])
                     "Use ALSA MIDI interface" << endl;
                 out << "  -j, --jack               "
                     "Use JACK MIDI interface (default)" << endl;
+                out << "  -t, --timer              "
+                    "Schedule ALSA MIDI with an internal timer" << endl;
 #endif
                 out << QString("  -p, --portCount <num>    "
                         "Number of output ports [%1]").arg(portCount) << endl;
+                out << "  -r, --rtprio <num>       "
+                    "SCHED_FIFO priority of the realtime thread (ALSA)" << endl;
+                out << "  -c, --rtcpu <num>        "
+                    "CPU to run the realtime thread on" << endl;
+                out << "  -g, --guicpu <num>       "
+                    "CPU to run the other threads on" << endl;
+                out << "  -m, --mlock              "
+                    "Lock the process memory" << endl;
                 out.flush();
                 exit(EXIT_SUCCESS);
 #ifdef HAVE_ALSA
@@ -132,19 +151,46 @@ int main(int argc, char *argv[])
             case 'j':
                 alsamidi = false;
                 break;
+            case 't':
+                global_alsa_timer = true;
+                break;
 #endif
             case 'U':
                 global_jack_session_uuid = QString(optarg);
                 break;
             case 'p':
                 portCount = atoi(optarg);
-                if (portCount > MAX_PORTS)
-                    portCount = MAX_PORTS;
-                else if (portCount < 1)
+                if (portCount < 1)
                     portCount = 2;
                 break;
+            case 'r':
+                global_rt_policy.priority = atoi(optarg);
+                if (global_rt_policy.priority < 0)
+                    global_rt_policy.priority = 0;
+                global_rt_cmdline = true;
+                break;
+            case 'c':
+                global_rt_policy.cpu = atoi(optarg);
+                global_rt_cmdline = true;
+                break;
+            case 'g':
+                global_rt_policy.guiCpu = atoi(optarg);
+                global_rt_cmdline = true;
+                break;
+            case 'm':
+                global_rt_policy.lockMemory = true;
+                global_rt_cmdline = true;
+                break;
         }
     }
+    // threads started from here on inherit the CPU of the GUI thread
+    if ((global_rt_policy.guiCpu >= 0)
+            && !rtSetAffinity(pthread_self(), global_rt_policy.guiCpu))
+        qWarning("Could not move GUI thread to CPU %d", global_rt_policy.guiCpu);
+    if (global_rt_policy.lockMemory && !rtLockMemory(true))
+        qWarning("%s", "Could not lock memory");
+    // JACK ports are allocated as needed, the ALSA driver has a fixed table
+    if (alsamidi && (portCount > MAX_PORTS)) portCount = MAX_PORTS;
 
     QApplication app(argc, argv);
     QLocale loc = QLocale::system();
@@ -32,6 +32,7 @@
 
 #define MAX_PORTS         64
 #define SEQPOOL         2048
+#define MODPOOL          256
 #define JQ_BUFSZ        1024
 #define LFO_FRAMELIMIT    16
 #define MAXNOTES         128
@@ -39,6 +40,9 @@
 #define MIDICLK_TPQN      24
 #define MAXCHORD          33
 #define OMNI              16
+#define PERCHANNEL        17    /* chIn of the Arp: one note buffer per input channel */
+#define DIN_MIDI_RATE   3125    /* bytes per second, 31250 baud at 10 bits per byte */
+#define GOV_SLICE_MS      10    /* time slice of the port bandwidth governor */
 
 #define QMARCNAME ".qmidiarprc"
 #define JSFILENAME "js_saved.qmax"
@@ -67,6 +71,15 @@ const int lfoResValues[13] = {1, 2, 3, 4, 5, 6, 7, 8, 16, 32, 64, 96, 192};
 //const int old_lfoResValues[9] = {1, 2, 4, 8, 16, 32, 64, 96, 192};
 const int mapOldLfoRes[9] = {0, 1, 3, 7, 8, 9, 10, 11, 12};
 
+/*! @brief This array holds the available LFO output thinning tolerances.
+ */
+const int lfoThinValues[5] = {0, 1, 2, 4, 8};
+
+/*! @brief This array holds the available minimum intervals between LFO
+ * output points in ticks, from none to a 1/16 note.
+ */
+const int lfoThinIntervals[5] = {0, TPQN / 32, TPQN / 16, TPQN / 8, TPQN / 4};
+
 /*! @brief This array holds the currently available Seq resolution values.
  */
 const int seqResValues[13] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 16};
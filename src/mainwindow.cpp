@@ -80,6 +80,7 @@ MainWindow::MainWindow(int p_portCount, bool p_alsamidi, char *execName)
 (void)execName;
 #endif
     jackFailed = false;
+    loadingModules = false;
     filename = "";
     lastDir = QDir::homePath();
     alsaMidi = p_alsamidi;
@@ -161,8 +162,8 @@ MainWindow::MainWindow(int p_portCount, bool p_alsamidi, char *execName)
     logWindow->setWidget(logWidget);
     logWindow->setObjectName("logWidget");
     qRegisterMetaType<MidiEvent>("MidiEvent");
-    connect(engine, SIGNAL(midiEventReceived(MidiEvent, int)),
-            logWidget, SLOT(appendEvent(MidiEvent, int)));
+    connect(engine, SIGNAL(midiEventReceived(MidiEvent, int64_t)),
+            logWidget, SLOT(appendEvent(MidiEvent, int64_t)));
 
     connect(logWidget, SIGNAL(sendLogEvents(bool)),
             engine, SLOT(setSendLogEvents(bool)));
@@ -174,6 +175,8 @@ MainWindow::MainWindow(int p_portCount, bool p_alsamidi, char *execName)
     prefs = new Prefs;
     
     prefs->portCount = p_portCount;
+    prefs->portOffset.fill(0, p_portCount);
+    prefs->rtPolicy = global_rt_policy;
     
     prefsWidget = new PrefsWidget(engine, prefs, this);
 
@@ -543,8 +546,10 @@ void MainWindow::appendDock(ModuleWidget *moduleWidget, int count)
     moduleWindow->setFeatures(QDockWidget::DockWidgetMovable
             | QDockWidget::DockWidgetFloatable);
     moduleWindow->setWidget(moduleWidget);
+    connect(moduleWindow, SIGNAL(visibilityChanged(bool)),
+            moduleWidget, SLOT(dockVisibilityChanged(bool)));
     addDockWidget(Qt::TopDockWidgetArea, moduleWindow);
-    
+
     if (prefs->compactStyle) moduleWidget->setStyleSheet(COMPACT_STYLE);
     
     if (count) {
@@ -553,6 +558,8 @@ void MainWindow::appendDock(ModuleWidget *moduleWidget, int count)
     }
     
     moduleWindow->setObjectName(moduleWindow->windowTitle());
+    if (loadingModules) return;
+
     moduleWindow->show();
     moduleWindow->raise();
 }
@@ -696,6 +703,7 @@ void MainWindow::openFile(const QString& fn)
         else skipXmlElement(xml);
     }
 
+    engine->sizeOutputPool();
     addRecentlyOpenedFile(filename, recentFiles);
     engine->setModified(false);
 }
@@ -719,7 +727,7 @@ void MainWindow::readFilePartGlobal(QXmlStreamReader& xml)
                     prefsWidget->cbuttonCheck->setChecked(xml.readElementText().toInt());
                 else if (xml.name() == "midiClockEnabled") {
                         bool tmp = xml.readElementText().toInt();
-                        if (alsaMidi) midiClockAction->setChecked(tmp);
+                        midiClockAction->setChecked(tmp);
                     }
                 else if (xml.name() == "jackSyncEnabled") {
                         bool tmp = xml.readElementText().toInt();
@@ -731,12 +739,21 @@ void MainWindow::readFilePartGlobal(QXmlStreamReader& xml)
                         bool tmp = xml.readElementText().toInt();
                         prefsWidget->storeMuteStateCheck->setChecked(tmp);
                     }
+                else if ((xml.name() == "portCount") && !alsaMidi)
+                    prefsWidget->setPortCount(xml.readElementText().toInt());
                 else if (xml.name() == "forwardPort")
                     prefsWidget->setPortUnmatched(xml.readElementText().toInt());
                 else if (xml.name() == "outputMidiClock")
                     prefsWidget->setOutputMidiClock(xml.readElementText().toInt());
                 else if (xml.name() == "midiClockPort")
                     prefsWidget->setPortMidiClock(xml.readElementText().toInt());
+                else if (xml.name() == "limitBandwidth")
+                    prefsWidget->bandwidthCheck->setChecked(xml.readElementText().toInt());
+                else if (xml.name() == "portOffsets") {
+                        QStringList tmp = xml.readElementText().split(',');
+                        for (int l1 = 0; l1 < tmp.count(); l1++)
+                            prefsWidget->setPortOffset(l1, tmp.at(l1).toInt());
+                    }
                 else skipXmlElement(xml);
             }
         }
@@ -751,6 +768,11 @@ void MainWindow::readFilePartGlobal(QXmlStreamReader& xml)
 
 void MainWindow::readFilePartModules(QXmlStreamReader& xml, const QString& qmaxVersion)
 {
+    // Avoid relayouting and repainting the dock area for every module
+    // of the session, the docks are shown in one go at the end
+    loadingModules = true;
+    setUpdatesEnabled(false);
+
     while (!xml.atEnd()) {
         bool iovis = true;
         xml.readNext();
@@ -781,6 +803,14 @@ void MainWindow::readFilePartModules(QXmlStreamReader& xml, const QString& qmaxV
             }
         }
     }
+
+    loadingModules = false;
+    for (int l1 = 0; l1 < engine->moduleWidgetCount(); l1++) {
+        ((QDockWidget *)engine->moduleWidget(l1)->parent())->show();
+    }
+    if (engine->moduleWidgetCount())
+        ((QDockWidget *)engine->moduleWidget(-1)->parent())->raise();
+    setUpdatesEnabled(true);
 }
 
 void MainWindow::readFilePartGUI(QXmlStreamReader& xml)
@@ -853,6 +883,8 @@ bool MainWindow::saveFile()
                 QString::number((int)midiClockAction->isChecked()));
             xml.writeTextElement("jackSyncEnabled",
                 QString::number((int)jackSyncAction->isChecked()));
+            xml.writeTextElement("portCount",
+                QString::number(prefs->portCount));
             xml.writeTextElement("forwardUnmatched",
                 QString::number((int)prefsWidget->forwardCheck->isChecked()));
             xml.writeTextElement("forwardPort",
@@ -861,6 +893,12 @@ bool MainWindow::saveFile()
                 QString::number((int)prefsWidget->outputMidiClockCheck->isChecked()));
             xml.writeTextElement("midiClockPort",
                 QString::number(prefsWidget->portMidiClockSpin->currentIndex()));
+            QStringList offsets;
+            for (int l1 = 0; l1 < prefs->portCount; l1++)
+                offsets << QString::number(prefs->portOffset.at(l1));
+            xml.writeTextElement("portOffsets", offsets.join(","));
+            xml.writeTextElement("limitBandwidth",
+                QString::number((int)prefsWidget->bandwidthCheck->isChecked()));
             xml.writeTextElement("storeMuteState",
                 QString::number(prefsWidget->storeMuteStateCheck->isChecked()));
         xml.writeEndElement();
@@ -1122,6 +1160,14 @@ void MainWindow::readRcFile()
                 prefsWidget->mutedAddCheck->setChecked(value.at(1).toInt());
             else if ((value.at(0) == "#StoreMuteState"))
                 prefsWidget->storeMuteStateCheck->setChecked(value.at(1).toInt());
+            else if ((value.at(0) == "#RtPriority"))
+                prefs->rcRtPolicy.priority = value.at(1).toInt();
+            else if ((value.at(0) == "#RtCpu"))
+                prefs->rcRtPolicy.cpu = value.at(1).toInt();
+            else if ((value.at(0) == "#GuiCpu"))
+                prefs->rcRtPolicy.guiCpu = value.at(1).toInt();
+            else if ((value.at(0) == "#LockMemory"))
+                prefs->rcRtPolicy.lockMemory = value.at(1).toInt();
             else if ((value.at(0) == "#EnableLog"))
                 logWidget->enableLog->setChecked(value.at(1).toInt());
             else if ((value.at(0) == "#LogMidiClock"))
@@ -1134,6 +1180,15 @@ void MainWindow::readRcFile()
                 recentFiles << value.at(1);
         }
     }
+
+    // realtime settings given on the command line take precedence
+    RtPolicy &rc = prefs->rcRtPolicy;
+    RtPolicy &cur = prefs->rtPolicy;
+    if (!global_rt_cmdline && ((rc.priority != cur.priority)
+            || (rc.cpu != cur.cpu) || (rc.guiCpu != cur.guiCpu)
+            || (rc.lockMemory != cur.lockMemory))) {
+        prefsWidget->setRtPolicy(rc);
+    }
 }
 
 void MainWindow::writeRcFile()
@@ -1164,6 +1219,14 @@ void MainWindow::writeRcFile()
     writeText << prefs->mutedAdd << endl;
     writeText << "#StoreMuteState%";
     writeText << prefs->storeMuteState << endl;
+    writeText << "#RtPriority%";
+    writeText << prefs->rcRtPolicy.priority << endl;
+    writeText << "#RtCpu%";
+    writeText << prefs->rcRtPolicy.cpu << endl;
+    writeText << "#GuiCpu%";
+    writeText << prefs->rcRtPolicy.guiCpu << endl;
+    writeText << "#LockMemory%";
+    writeText << prefs->rcRtPolicy.lockMemory << endl;
     writeText << "#EnableLog%";
     writeText << logWidget->enableLog->isChecked() << endl;
     writeText << "#LogMidiClock%";
@@ -1257,7 +1320,7 @@ void MainWindow::checkIfLastModule()
 void MainWindow::checkIfFirstModule()
 {
     if (engine->moduleWidgetCount() == 1) {
-        if (alsaMidi) midiClockAction->setEnabled(true);
+        midiClockAction->setEnabled(true);
         jackSyncAction->setEnabled(true);
         fileSaveAction->setEnabled(true);
         fileSaveAsAction->setEnabled(true);
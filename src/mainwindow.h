@@ -77,6 +77,7 @@ class MainWindow : public QMainWindow
   private:
     static int sigpipe[2];
     bool alsaMidi;
+    bool loadingModules;    /*!< Set while readFilePartModules() populates the docks */
     QSpinBox *tempoSpin;
     PrefsWidget *prefsWidget;
     GrooveWidget *grooveWidget;
@@ -192,6 +193,10 @@ class MainWindow : public QMainWindow
 * @brief  wraps the given widget in a QDockWidget and adds
 * it to the list in Engine.
 *
+* While a session is being loaded (MainWindow::loadingModules) the
+* dock is not raised, this is done once for the last module when
+* loading has finished.
+*
 * @param *moduleWidget The QWidget to be embedded
 * @param count DockWidget list location at which the window is insertet
 */
@@ -87,9 +87,11 @@ MidiArp::MidiArp()
     eventType = EV_NOTEON;
 
     int latchDelayMsec = 50;
-    noteBufPtr = 0;
-    releaseNoteCount = 0;
     purgeReleaseFlag = false;
+    purgeLatchFlag = false;
+    clearNotesFlag = false;
+    purgeReleasedFlag = false;
+    foldTicks = 0;
     stepWidth = 1.0;     // stepWidth relative to global queue stepWidth
     minStepWidth = 1.0;
     maxOctave = 0;
@@ -98,8 +100,6 @@ MidiArp::MidiArp()
     octMode = 0;
     octLow = 0;
     octHigh = 0;
-    octOfs = 0;
-    octIncr = 0;
 
     nSteps = 1.0;
     len = 0.5;       // note length
@@ -108,7 +108,6 @@ MidiArp::MidiArp()
     patternLen = 0;
     semitone = 0;
     patternMaxIndex = 0;
-    noteOfs = 0;
     arpTick = 0;
     returnTick = 0;
     chordMode = false;
@@ -121,41 +120,52 @@ MidiArp::MidiArp()
     repeatPatternThroughChord = 1;
     attack_time = 0.0;
     release_time = 0.0;
-    sustain = false;
-    sustainBufferCount = 0;
     latch_mode = false;
-    latchBufferCount = 0;
-    lastLatchTick = 0;
     latchDelayTicks = latchDelayMsec * TPQN / 1000;
     trigDelayTicks = 4;
     
     nextLength = 0;
     Sample sample = {0, 0, 0, false};
-    outFrame.resize(MAXCHORD);
+    outFrame.resize(MAXCHORD * 16);
     
     for (int l1 = 0; l1 < MAXCHORD; l1++) {
         noteIndex[l1] = 0;
         chordSemitone[l1] = 0;
+    }
+    for (int l1 = 0; l1 < MAXCHORD * 16; l1++) {
         outFrame[l1] = sample;
         nextVelocity[l1] = 0;
         nextNote[l1] = 0;
+        nextChannel[l1] = 0;
+        outChannel[l1] = 0;
+    }
+    for (int l1 = 0; l1 < 16; l1++) {
+        voice = &voices[l1];
+        voice->noteCount = 0;
+        voice->noteOfs = 0;
+        voice->octOfs = 0;
+        voice->octIncr = 0;
+        voice->sustain = false;
+        voice->sustainBufferCount = 0;
+        voice->latchBufferCount = 0;
+        voice->lastLatchTick = 0;
+        for (int l2 = 0; l2 < MAXNOTES; l2++) {
+            voice->sustainBuffer[l2] = 0;
+            voice->latchBuffer[l2] = 0;
+            voice->old_attackfn[l2] = 0.;
+        }
     }
-    for (int l1 = 0; l1 < MAXNOTES; l1++) {
-        for (int l2 = 0; l2 < 4; l2++) notes[0][l2][l1] = 0;
-        for (int l2 = 0; l2 < 4; l2++) notes[1][l2][l1] = 0;
-        sustainBuffer[l1] = 0;
-        latchBuffer[l1] = 0;
-        old_attackfn[l1] = 0.;
-    }
-    
+    voice = &voices[0];
 }
 
 bool MidiArp::handleEvent(MidiEvent inEv, int64_t tick, int keep_rel)
 {
-    if (inEv.channel != chIn && chIn != OMNI) return(true);
+    if (inEv.channel != chIn && chIn != OMNI && chIn != PERCHANNEL) return(true);
+    applyNoteRequests();
+    voice = &voices[(chIn == PERCHANNEL) ? (inEv.channel & 15) : 0];
     if ((inEv.type == EV_CONTROLLER) && 
         ((inEv.data == CT_ALLNOTESOFF) || (inEv.data == CT_ALLSOUNDOFF))) {
-        clearNoteBuffer();
+        clearVoice();
         return(true); // In case we receive all notes off we still forward
     }
     if ((inEv.type == EV_CONTROLLER) && (inEv.data == CT_FOOTSW)) {
@@ -175,12 +185,12 @@ bool MidiArp::handleEvent(MidiEvent inEv, int64_t tick, int keep_rel)
             purgeLatchBuffer(tick);
             if (restartByKbd) restartFlag = true;
             // if we have been triggered, remove pending release notes
-            if (trigByKbd && release_time > 0) purgeReleaseNotes(noteBufPtr);
+            if (trigByKbd && release_time > 0) purgeReleaseNotes();
         }
         
         addNote(inEv.data, inEv.value, tick);
         
-        if (repeatPatternThroughChord == 2) noteOfs = noteCount - 1;
+        if (repeatPatternThroughChord == 2) voice->noteOfs = voice->noteCount - 1;
 
         if ((trigByKbd && (getPressedNoteCount() == 1))
                     || trigLegato) {
@@ -191,24 +201,24 @@ bool MidiArp::handleEvent(MidiEvent inEv, int64_t tick, int keep_rel)
     else {
         // This is a NOTE OFF event
 
-        if (!noteCount) {
+        if (!voice->noteCount) {
             return(false);
         }
-        if (sustain) {
-            if (sustainBufferCount == MAXNOTES - 1) purgeSustainBuffer(tick);
-            sustainBuffer[sustainBufferCount] = inEv.data;
-            sustainBufferCount++;
+        if (voice->sustain) {
+            if (voice->sustainBufferCount == MAXNOTES - 1) purgeSustainBuffer(tick);
+            voice->sustainBuffer[voice->sustainBufferCount] = inEv.data;
+            voice->sustainBufferCount++;
             return(false);
         }
 
         if (latch_mode && keep_rel) {
-            if (latchBufferCount == MAXNOTES - 1) purgeLatchBuffer(tick);
-            latchBuffer[latchBufferCount] = inEv.data;
-            latchBufferCount++;
-            if (latchBufferCount != noteCount) {
-                if ((uint64_t)tick > (uint64_t)(lastLatchTick + latchDelayTicks) 
-                    && (latchBufferCount > 1)) purgeLatchBuffer(tick);
-                lastLatchTick = tick;
+            if (voice->latchBufferCount == MAXNOTES - 1) purgeLatchBuffer(tick);
+            voice->latchBuffer[voice->latchBufferCount] = inEv.data;
+            voice->latchBufferCount++;
+            if (voice->latchBufferCount != voice->noteCount) {
+                if ((uint64_t)tick > (uint64_t)(voice->lastLatchTick + latchDelayTicks) 
+                    && (voice->latchBufferCount > 1)) purgeLatchBuffer(tick);
+                voice->lastLatchTick = tick;
             }
             return(false);
         }
@@ -221,146 +231,80 @@ bool MidiArp::handleEvent(MidiEvent inEv, int64_t tick, int keep_rel)
 
 void MidiArp::addNote(int note, int vel, int64_t tick)
 {
-        // modify buffer that is not accessed by arpeggio output
-    int bufPtr = (noteBufPtr) ? 0 : 1;
-    int index = 0;
-
-    if (!noteCount || (note > notes[bufPtr][0][noteCount - 1])
-            || (repeatPatternThroughChord == 4) )
-        index = noteCount;
-    else {
-        while (index < MAXNOTES && note > notes[bufPtr][0][index]) index++;
-
-        for (int l3 = 0; l3 < 4; l3++) {
-            for (int l2 = noteCount; l2 > index; l2--) {
-                notes[bufPtr][l3][l2] = notes[bufPtr][l3][l2 - 1];
-            }
-        }
-    }
-    notes[bufPtr][0][index] = note;
-    notes[bufPtr][1][index] = vel;
-    notes[bufPtr][2][index] = tick;
-    notes[bufPtr][3][index] = 0;
-    noteCount++;
-
-    copyNoteBuffer();
+    voice->notes.add(note, vel, tick);
+    voice->noteCount = voice->notes.count();
 }
 
 void MidiArp::releaseNote(int note, int64_t tick, bool keep_rel)
 {
-    // modify buffer that is not accessed by arpeggio output
-    int bufPtr = (noteBufPtr) ? 0 : 1;
+    bool asPlayed = (repeatPatternThroughChord == 4);
+
     if ((!keep_rel) || (!release_time)) {
         //definitely remove from buffer
-        if (note == notes[bufPtr][0][noteCount - 1]
-                && (repeatPatternThroughChord != 4)) {
-            //note is on top of buffer: only decrement noteCount
-            noteCount--;
-            if (repeatPatternThroughChord == 2) noteOfs = noteCount - 1;
-        }
-        else {
-            //note is not on top: take out the note and pull down all above
-            int index = 0;
-            while ((index < MAXNOTES) && (index < noteCount) 
-                && (note != notes[bufPtr][0][index])) index++;
-            deleteNoteAt(index, bufPtr);
-        }
+        bool top = (voice->noteCount && (note == voice->notes.noteAt(voice->noteCount - 1, asPlayed)));
+        voice->notes.remove(note);
+        voice->noteCount = voice->notes.count();
+        if (top && (repeatPatternThroughChord == 2)) voice->noteOfs = voice->noteCount - 1;
     }
-    else tagAsReleased(note, tick, bufPtr);
-    
-    copyNoteBuffer();
+    else voice->notes.release(note, tick);
 }
 
-void MidiArp::removeNote(int64_t *noteptr, int64_t tick, int keep_rel)
+void MidiArp::removeNote(int note, int64_t tick, int keep_rel)
 {
-    int bufPtr, note ;
-    note = *noteptr;
+    bool asPlayed = (repeatPatternThroughChord == 4);
 
-    // modify buffer that is not accessed by arpeggio output
-    bufPtr = (noteBufPtr) ? 0 : 1;
-    if (!noteCount) {
+    if (!voice->noteCount) {
         return;
     }
     if (!keep_rel || (!release_time)) {
-        // definitely remove from buffer, do NOT check for doubles
-        if (note == notes[bufPtr][0][noteCount - 1]
-                && (repeatPatternThroughChord != 4)) {
-            // note is on top of buffer: only decrement noteCount
-            noteCount--;
-            if (tick == -1) releaseNoteCount--;
-            if ((repeatPatternThroughChord == 2) && (noteOfs)) noteOfs--;
-        }
-        else {
-            // note is not on top: take out the note and pull down all above
-            int index = 0;
-            if (tick != -1) {
-                while ((index < noteCount) 
-                        && (note != notes[bufPtr][0][index])) index++;
-            }
-            else {
-                while ((index < noteCount) 
-                        && ((note != notes[bufPtr][0][index])
-                        || (!notes[bufPtr][3][index]))) index++;
-            }
-
-            
-            if (note == notes[bufPtr][0][index]) {
-                deleteNoteAt(index, bufPtr);
-                if (tick == -1) releaseNoteCount--;
-                for (int l2 = index; l2 < noteCount; l2++) {
-                    old_attackfn[l2] = old_attackfn[l2 + 1];
-                }
-            }
-        }
+        // definitely remove from buffer
+        bool top = (note == voice->notes.noteAt(voice->noteCount - 1, asPlayed));
+        if (tick == -1) voice->notes.removeReleased(note);
+        else voice->notes.remove(note);
+        if (top && (voice->notes.count() < voice->noteCount)
+                && (repeatPatternThroughChord == 2) && (voice->noteOfs)) voice->noteOfs--;
+        voice->noteCount = voice->notes.count();
     }
-    else tagAsReleased(note, tick, bufPtr);
-
-    copyNoteBuffer();
+    else voice->notes.release(note, tick);
 }
 
-void MidiArp::deleteNoteAt(int index, int bufPtr)
+void MidiArp::applyNoteRequests()
 {
-    for (int l3 = 0; l3 < 4; l3++) {
-        for (int l2 = index; l2 < noteCount - 1; l2++) {
-            notes[bufPtr][l3][l2] = notes[bufPtr][l3][l2 + 1];
-        }
-    }
-    noteCount--;
-}
+    bool clear = clearNotesFlag.exchange(false);
+    bool purge = purgeLatchFlag.exchange(false);
+    bool purgeReleased = purgeReleasedFlag.exchange(false);
+    int64_t fold = foldTicks.exchange(0);
 
-void MidiArp::tagAsReleased(int note, int64_t tick, int bufPtr)
-{
-    //mark as released but keep with note off time tick
-    int l1 = 0;
-    while ((l1 < noteCount) 
-        && ((note != notes[bufPtr][0][l1]) || (notes[bufPtr][3][l1]))) {
-        l1++;
-    }
-    if (note == notes[bufPtr][0][l1]) {
-        notes[bufPtr][3][l1] = 1;
-        notes[bufPtr][2][l1] = tick;
-        releaseNoteCount++;
+    if (!clear && !purge && !purgeReleased && !fold) return;
+
+    for (int l1 = 0; l1 < 16; l1++) {
+        voice = &voices[l1];
+        if (clear) clearVoice();
+        if (purge) purgeLatchBuffer(arpTick);
+        if (purgeReleased) {
+            voice->notes.purgeReleased();
+            voice->noteCount = voice->notes.count();
+        }
+        if (fold) {
+            voice->notes.shiftTicks(-fold);
+            voice->lastLatchTick -= fold;
+        }
     }
 }
 
-void MidiArp::copyNoteBuffer()
+void MidiArp::clearVoice()
 {
-    int newBufPtr = noteBufPtr;
-    noteBufPtr++;
-    noteBufPtr%=2;
-
-    for (int l2 = 0; l2 < noteCount; l2++) {
-        for (int l3 = 0; l3 < 4; l3++) {
-            notes[newBufPtr][l3][l2] = notes[noteBufPtr][l3][l2];
-        }
-    }
+    voice->notes.clear();
+    voice->noteCount = 0;
+    voice->latchBufferCount = 0;
 }
 
-void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int *length)
+void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int channel[], int *length)
 {
     char c;
-    int l1, tmpIndex[MAXCHORD], chordIndex, grooveTmp;
-    int current_octave = 0;
+    int l1, l2, ch, first, tmpIndex[MAXCHORD], chordIndex, grooveTmp, pitch;
+    int stepOfs[16], stepOct[16];
+    int nvoices = voiceCount();
     bool outOfRange = false;
     bool gotCC, pause;
 
@@ -371,10 +315,13 @@ void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int *length
     gotCC = false;
     pause = false;
     
-    if (purgeReleaseFlag) {
-        purgeLatchBuffer(arpTick);
-        purgeReleaseNotes(noteBufPtr);
-        purgeReleaseFlag = false;
+    applyNoteRequests();
+    if (purgeReleaseFlag.exchange(false)) {
+        for (ch = 0; ch < nvoices; ch++) {
+            voice = &voices[ch];
+            purgeLatchBuffer(arpTick);
+            purgeReleaseNotes();
+        }
     }
     if (restartFlag) advancePatternIndex(true);
 
@@ -383,6 +330,13 @@ void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int *length
     framePtr++;
     if (framePtr >= nPoints) framePtr = 0;
 
+    // chord position of each voice for this step, the pattern index
+    // can revolve below, which moves them on for the next step
+    for (ch = 0; ch < nvoices; ch++) {
+        stepOfs[ch] = voices[ch].noteOfs;
+        stepOct[ch] = voices[ch].octOfs;
+    }
+
     chordSemitone[0] = semitone;
     do {
         if (patternLen)
@@ -392,7 +346,7 @@ void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int *length
 
         if (c != ' ') {
             if (isdigit(c) || (c == 'p')) {
-                tmpIndex[chordIndex] = c - '0' + noteOfs;
+                tmpIndex[chordIndex] = c - '0';
                 if ((chordIndex < MAXCHORD - 1) && chordMode) {
                     chordIndex++;
                     chordSemitone[chordIndex] = semitone;
@@ -453,58 +407,70 @@ void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int *length
                 chordSemitone[chordIndex] = semitone;
             }
         }
-        current_octave = octOfs;
     } while (advancePatternIndex(false) && (gotCC || chordMode || c == ' '));
 
-    l1 = 0;
-    if (noteCount) do {
-        noteIndex[l1] = (noteCount) ? tmpIndex[l1] % noteCount : 0;
-        note[l1] = clip(notes[noteBufPtr][0][noteIndex[l1]] + current_octave * 12
-                + chordSemitone[l1], 0, 127, &outOfRange);
-        if (outOfRange) checkOctaveAtEdge(false);
-
-        grooveTmp = (framePtr % 2) ? grooveVelocity : -grooveVelocity;
+    l2 = 0;
+    for (ch = 0; ch < nvoices; ch++) {
+        voice = &voices[ch];
+        first = l2;
+        l1 = 0;
+        if (voice->noteCount) do {
+            noteIndex[l1] = (voice->noteCount) ? (tmpIndex[l1] + stepOfs[ch]) % voice->noteCount : 0;
+            pitch = voice->notes.noteAt(noteIndex[l1], repeatPatternThroughChord == 4);
+            note[l2] = clip(pitch + stepOct[ch] * 12
+                    + chordSemitone[l1], 0, 127, &outOfRange);
+            channel[l2] = (nvoices > 1) ? ch : channelOut;
+            if (outOfRange) checkOctaveAtEdge(voice, false);
+
+            grooveTmp = (framePtr % 2) ? grooveVelocity : -grooveVelocity;
         
-        double releasefn = 0;
-        if ((release_time > 0) && (notes[noteBufPtr][3][noteIndex[l1]])) {
-            releasefn = 1.0 - (double)(arpTick
-                    - notes[noteBufPtr][2][noteIndex[l1]])
-                    / (release_time * (double)TPQN * 2);
+            double releasefn = 0;
+            if ((release_time > 0) && (voice->notes.isReleased(pitch))) {
+                releasefn = 1.0 - (double)(arpTick
+                        - voice->notes.tick(pitch))
+                        / (release_time * (double)TPQN * 2);
 
-            if (releasefn < 0.0) releasefn = 0.0;
-        }
-        else releasefn = 1.0;
+                if (releasefn < 0.0) releasefn = 0.0;
+            }
+            else releasefn = 1.0;
         
-        double attackfn = 0;
-        if (attack_time > 0) {
-            if (!notes[noteBufPtr][3][noteIndex[l1]]) {
-                attackfn = (double)(arpTick
-                    - notes[noteBufPtr][2][noteIndex[l1]])
-                    / (attack_time * (double)TPQN * 2);
-
-                if (attackfn > 1.0) attackfn = 1.0;
-                old_attackfn[noteIndex[l1]] = attackfn;
+            double attackfn = 0;
+            if (attack_time > 0) {
+                if (!voice->notes.isReleased(pitch)) {
+                    attackfn = (double)(arpTick
+                        - voice->notes.tick(pitch))
+                        / (attack_time * (double)TPQN * 2);
+
+                    if (attackfn > 1.0) attackfn = 1.0;
+                    voice->old_attackfn[pitch] = attackfn;
+                }
+                else attackfn = voice->old_attackfn[pitch];
             }
-            else attackfn = old_attackfn[noteIndex[l1]];
-        }
-        else attackfn = 1.0;
+            else attackfn = 1.0;
 
-        velocity[l1] = clip((double)notes[noteBufPtr][1][noteIndex[l1]]
-                * vel * (1.0 + 0.005 * (double)(randomVelocity + grooveTmp))
-                * releasefn * attackfn, 0, 127, &outOfRange);
+            velocity[l2] = clip((double)voice->notes.velocity(pitch)
+                    * vel * (1.0 + 0.005 * (double)(randomVelocity + grooveTmp))
+                    * releasefn * attackfn, 0, 127, &outOfRange);
 
-        if ((release_time > 0.) && (notes[noteBufPtr][3][noteIndex[l1]]) && (!velocity[l1])) {
-            removeNote(&notes[noteBufPtr][0][noteIndex[l1]], -1, 0);
-        }
-        else {
-            l1++;
+            if ((release_time > 0.) && (voice->notes.isReleased(pitch)) && (!velocity[l2])) {
+                removeNote(pitch, -1, 0);
+            }
+            else {
+                l1++;
+                l2++;
+            }
+        } while (  (l1 < MAXCHORD - 1)
+                && (tmpIndex[l1] >= 0)
+                && ((l1 < voice->noteCount) || (tmpIndex[l1] + stepOfs[ch] == 0))
+                && (voice->noteCount));
+
+        if (!patternLen || pause || isMuted) {
+            velocity[first] = 0;
         }
-    } while (  (l1 < MAXCHORD - 1)
-            && (tmpIndex[l1] >= 0)
-            && ((l1 < noteCount) || (tmpIndex[l1] == 0))
-            && (noteCount));
+    }
 
-    note[l1] = -1; // mark end of array
+    note[l2] = -1; // mark end of array
+    velocity[l2] = 0;
     grooveTmp = (framePtr % 2) ? grooveLength : -grooveLength;
     *length = clip(len * stepWidth * (double)TPQN
             * (1.0 + 0.005 * (double)(randomLength + grooveTmp)), 2,
@@ -527,49 +493,45 @@ void MidiArp::getNote(int64_t *tick, int64_t note[], int velocity[], int *length
 
     *tick = arpTick + clip(stepWidth * 0.25 * (double)randomTick, 0,
             1000, &outOfRange);
-
-    if (!(patternLen && noteCount) || pause || isMuted) {
-        velocity[0] = 0;
-    }
 }
 
-void MidiArp::checkOctaveAtEdge(bool reset)
+void MidiArp::checkOctaveAtEdge(ArpVoice *v, bool reset)
 {
     if (!octMode) return;
     if (!octHigh && !octLow) {
-        octOfs = 0;
+        v->octOfs = 0;
         return;
     }
     
     if (reset) {
         if (octMode == 2) {
-            octOfs = octHigh;
-            octIncr = -1;
+            v->octOfs = octHigh;
+            v->octIncr = -1;
         }
         else {
-            octOfs = octLow;
-            octIncr = 1;
+            v->octOfs = octLow;
+            v->octIncr = 1;
         }
         return;
     }
-    if (octOfs > octHigh) {
+    if (v->octOfs > octHigh) {
         if (octMode == 3){
-            octIncr = - octIncr;
-            octOfs--;
-            octOfs--;
+            v->octIncr = - v->octIncr;
+            v->octOfs--;
+            v->octOfs--;
         }
         else {
-            octOfs = octLow;
+            v->octOfs = octLow;
         }
     }
-    if (octOfs < octLow) {
+    if (v->octOfs < octLow) {
         if (octMode == 3) {
-            octIncr = - octIncr;
-            octOfs++;
-            octOfs++;
+            v->octIncr = - v->octIncr;
+            v->octOfs++;
+            v->octOfs++;
         }
         else {
-            octOfs = octHigh;
+            v->octOfs = octHigh;
         }
     }
 }
@@ -587,37 +549,40 @@ bool MidiArp::advancePatternIndex(bool reset)
         currentRepetition++;
         currentRepetition %= nRepetitions;
 
-        switch (repeatPatternThroughChord) {
-            case 1:
-            case 4:
-                noteOfs++;
-                if ((noteCount - 1 < patternMaxIndex + noteOfs) || reset) {
-                    noteOfs = 0;
-                    octOfs+=octIncr;
-                    checkOctaveAtEdge(reset);
-                }
-                break;
-            case 2:
-                noteOfs--;
-                if ((noteCount -1 < patternMaxIndex) ||
-                    (noteOfs < patternMaxIndex) || reset) {
-                    noteOfs = noteCount - 1;
-                    octOfs+=octIncr;
-                    checkOctaveAtEdge(reset);
-                }
-                break;
-            case 3:
-                if (noteCount > 1) {
-                    int oldnoteofs = noteOfs;
-                    while (noteOfs == oldnoteofs) noteOfs = rand() % noteCount;
-                }
-                if ((noteOfs == noteCount) || (noteOfs == 0) || reset) {
-                    octOfs+=octIncr;
-                    checkOctaveAtEdge(reset);
-                }
-                break;
-            default:
-                noteOfs = 0;
+        for (int l1 = 0; l1 < voiceCount(); l1++) {
+            ArpVoice *v = &voices[l1];
+            switch (repeatPatternThroughChord) {
+                case 1:
+                case 4:
+                    v->noteOfs++;
+                    if ((v->noteCount - 1 < patternMaxIndex + v->noteOfs) || reset) {
+                        v->noteOfs = 0;
+                        v->octOfs+=v->octIncr;
+                        checkOctaveAtEdge(v, reset);
+                    }
+                    break;
+                case 2:
+                    v->noteOfs--;
+                    if ((v->noteCount -1 < patternMaxIndex) ||
+                        (v->noteOfs < patternMaxIndex) || reset) {
+                        v->noteOfs = v->noteCount - 1;
+                        v->octOfs+=v->octIncr;
+                        checkOctaveAtEdge(v, reset);
+                    }
+                    break;
+                case 3:
+                    if (v->noteCount > 1) {
+                        int oldnoteofs = v->noteOfs;
+                        while (v->noteOfs == oldnoteofs) v->noteOfs = randomValue(v->noteCount);
+                    }
+                    if ((v->noteOfs == v->noteCount) || (v->noteOfs == 0) || reset) {
+                        v->octOfs+=v->octIncr;
+                        checkOctaveAtEdge(v, reset);
+                    }
+                    break;
+                default:
+                    v->noteOfs = 0;
+            }
         }
         return(false);
     }
@@ -635,6 +600,7 @@ void MidiArp::initLoop()
 
 void MidiArp::getNextFrame(int64_t askedTick)
 {
+    applyRandomReset();
     gotKbdTrig = false;
     Sample sample = {0, 0, 0, false};
     
@@ -643,12 +609,13 @@ void MidiArp::getNextFrame(int64_t askedTick)
     int l1 = 0;
     if (askedTick >= nextTick) {
         returnTick = nextTick;
-        getNote(&nextTick, nextNote, nextVelocity, &nextLength);
-        while ((l1 < MAXCHORD - 1) && (nextNote[l1] >= 0)) {
+        getNote(&nextTick, nextNote, nextVelocity, nextChannel, &nextLength);
+        while ((l1 < MAXCHORD * 16 - 1) && (nextNote[l1] >= 0)) {
             sample.data = nextNote[l1];
             sample.value = nextVelocity[l1];
             sample.tick = returnTick;
             outFrame[l1] = sample;
+            outChannel[l1] = nextChannel[l1];
             l1++;
         }
         returnLength = nextLength;
@@ -659,25 +626,15 @@ void MidiArp::getNextFrame(int64_t askedTick)
     }
     sample.data = -1;
     outFrame[l1] = sample; // mark end of chord
+    outFrameCount = l1;
 }
 
 void MidiArp::foldReleaseTicks(int64_t tick)
 {
-    int bufPtr, l2;
-
-    bufPtr = (noteBufPtr) ? 0 : 1;
-
-    if (tick <= 0) {
-        purgeReleaseNotes(bufPtr);
-        return;
-    }
-
-    for (l2 = 0; l2 < noteCount; l2++) {
-            notes[bufPtr][2][l2] -= tick;
-    }
-
-    copyNoteBuffer();
-    lastLatchTick -= tick;    
+    // called by Engine on the GUI thread, the notes belong to the
+    // input thread
+    if (tick <= 0) purgeReleasedFlag = true;
+    else foldTicks += tick;
 }
 
 void MidiArp::initArpTick(uint64_t tick)
@@ -799,19 +756,16 @@ void MidiArp::updatePattern(const std::string& p_pattern)
 
     patternIndex = 0;
     framePtr = 0;
-    noteOfs = 0;
+    for (l1 = 0; l1 < 16; l1++) voices[l1].noteOfs = 0;
     nSteps = nsteps;
     nPoints = npoints;
 }
 
 void MidiArp::newRandomValues()
 {
-    randomTick = (double)randomTickAmp * (0.5 - (double)rand()
-            / (double)RAND_MAX);
-    randomVelocity = (double)randomVelocityAmp * (0.5 - (double)rand()
-            / (double)RAND_MAX);
-    randomLength = (double)randomLengthAmp * (0.5 - (double)rand()
-            / (double)RAND_MAX);
+    randomTick = (double)randomTickAmp * (0.5 - randomUnit());
+    randomVelocity = (double)randomVelocityAmp * (0.5 - randomUnit());
+    randomLength = (double)randomLengthAmp * (0.5 - randomUnit());
 }
 
 void MidiArp::updateRandomTickAmp(int val)
@@ -821,26 +775,31 @@ void MidiArp::updateRandomTickAmp(int val)
 
 void MidiArp::updateOctaveMode(int val)
 {
+    int incr = 0;
+
     octMode = val;
-    octOfs = 0;
     
     switch (val) {
         case 0: 
-            octIncr = 0;
+            incr = 0;
         break;
 
         case 1:
-            octIncr = 1;
+            incr = 1;
         break;
 
         case 2:
-            octIncr = -1;
+            incr = -1;
         break;
 
         case 3:
-            octIncr = 1;
+            incr = 1;
         break;
     }
+    for (int l1 = 0; l1 < 16; l1++) {
+        voices[l1].octOfs = 0;
+        voices[l1].octIncr = incr;
+    }
 }
 
 void MidiArp::updateRandomVelocityAmp(int val)
@@ -867,21 +826,19 @@ void MidiArp::updateReleaseTime(int val)
 
 void MidiArp::clearNoteBuffer()
 {
-    noteCount = 0;
-    latchBufferCount = 0;
-    releaseNoteCount = 0;
+    clearNotesFlag = true;
 }
 
 int MidiArp::getPressedNoteCount()
 {
-    int c = noteCount - latchBufferCount - releaseNoteCount;
+    int c = voice->noteCount - voice->latchBufferCount - voice->notes.releasedCount();
     return(c);
 }
 
 void MidiArp::setSustain(bool on, uint64_t sustick)
 {
-    sustain = on;
-    if (!sustain) {
+    voice->sustain = on;
+    if (!voice->sustain) {
         purgeSustainBuffer(sustick);
         if (latch_mode) purgeLatchBuffer(sustick);
     }
@@ -889,36 +846,30 @@ void MidiArp::setSustain(bool on, uint64_t sustick)
 
 void MidiArp::purgeSustainBuffer(uint64_t sustick)
 {
-    for (int l1 = 0; l1 < sustainBufferCount; l1++) {
-        int64_t buf = sustainBuffer[l1];
-        removeNote(&buf, sustick, 1);
+    for (int l1 = 0; l1 < voice->sustainBufferCount; l1++) {
+        removeNote(voice->sustainBuffer[l1], sustick, 1);
     }
-    sustainBufferCount = 0;
+    voice->sustainBufferCount = 0;
 }
 
 void MidiArp::setLatchMode(bool on)
 {
     latch_mode = on;
-    if (!latch_mode) purgeLatchBuffer(arpTick);
+    if (!latch_mode) purgeLatchFlag = true;
 }
 
 void MidiArp::purgeLatchBuffer(uint64_t latchtick)
 {
-    for (int l1 = 0; l1 < latchBufferCount; l1++) {
-        int64_t buf = latchBuffer[l1];
-        removeNote(&buf, latchtick, 1);
+    for (int l1 = 0; l1 < voice->latchBufferCount; l1++) {
+        removeNote(voice->latchBuffer[l1], latchtick, 1);
     }
-    latchBufferCount = 0;
+    voice->latchBufferCount = 0;
 }
 
-void MidiArp::purgeReleaseNotes(int bufptr)
+void MidiArp::purgeReleaseNotes()
 {
-    for (int l1 = noteCount - 1; l1 >= 0; l1--) {
-        if (notes[bufptr][3][l1]) {
-            deleteNoteAt(l1, bufptr);
-            releaseNoteCount--;
-        }
-    }
+    voice->notes.purgeReleased();
+    voice->noteCount = voice->notes.count();
 }
 
 void MidiArp::applyPendingParChanges()
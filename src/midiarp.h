@@ -24,8 +24,49 @@
 #ifndef MIDIARP_H
 #define MIDIARP_H
 
+#include <atomic>
 #include <string>
 #include "midiworker.h"
+#include "noteset.h"
+
+/*! @brief Input note state of MidiArp for one input channel
+ *
+ * MidiArp uses only the first ArpVoice unless MidiWorker::chIn is set
+ * to PERCHANNEL, in which case each input channel has its own ArpVoice.
+ * All voices share the pattern and its timing, each of them follows
+ * the pattern through its own chord and octave.
+ */
+struct ArpVoice {
+ /*! @brief The input note buffer of the voice.
+  *
+  * It holds note value, velocity, the timing of the note event in
+  * internal ticks (NOTE_ON or NOTE_OFF) and a release tag for each
+  * note. Notes tagged as released have their velocity decreased by
+  * MidiArp::getNote() until it reaches 0, and are then removed by a
+  * MidiArp::removeNote call.
+  *
+  * It is only changed by the thread handling MIDI input, which also
+  * runs MidiArp::getNote(). Other threads request changes with
+  * MidiArp::clearNoteBuffer() and MidiArp::setLatchMode(), which take
+  * effect at the next input event or arpeggio step.
+  * */
+    NoteSet notes;
+    int noteCount;      /*!< The number of notes in ArpVoice::notes */
+    int noteOfs;        /*!< The current index in a chord. @see MidiArp::repeatPatternThroughChord */
+    int octOfs;         /*!< The currently active octave shift. @see MidiArp::repeatPatternThroughChord */
+    int octIncr;        /*!< The octave increment at repeat end. @see MidiArp::repeatPatternThroughChord */
+    bool sustain;
+    int sustainBufferCount, latchBufferCount;
+    uint64_t lastLatchTick;
+    int sustainBuffer[MAXNOTES]; /*!< Holds released note values when ArpVoice::sustain is True */
+    int latchBuffer[MAXNOTES];   /*!< Holds released note values when MidiArp::latch_mode is True */
+ /*! @brief The storage copy of dynamic attack values.
+  *
+  * These values are to be multiplied with the
+  * velocity at each new arpeggiator step. Its index is the note value.
+  * */
+    double old_attackfn[MAXNOTES];
+};
 
  /*!
  * @brief MIDI worker class for the Arpeggiator Module. Implements the
@@ -44,59 +85,35 @@
  * accesses this output buffer and sends it to the backend driver. Engine
  * also calls MidiArp::handleEvent() in particular to store incoming notes
  * in its note buffer. 
+ * When MidiWorker::chIn is set to PERCHANNEL, the notes of each input
+ * channel are arpeggiated independently and output on the channel they
+ * came in on, see ArpVoice.
  */
 class MidiArp : public MidiWorker  {
 
   private:
-    int64_t nextNote[MAXCHORD]; /*!< Holds the note values to be output next
+    int64_t nextNote[MAXCHORD * 16]; /*!< Holds the note values to be output next
                                 @see MidiArp::updateNotes */
-    int nextVelocity[MAXCHORD]; /*!< Holds the associated velocities to be output next
+    int nextVelocity[MAXCHORD * 16]; /*!< Holds the associated velocities to be output next
                                     @see MidiArp::updateNotes, MidiArp::nextNote */
+    int nextChannel[MAXCHORD * 16];  /*!< Holds the associated output channels */
+    int outChannel[MAXCHORD * 16];   /*!< Output channels of MidiWorker::outFrame */
     uint64_t arpTick;
     int nextLength;
     bool chordMode;
-    bool purgeReleaseFlag; /*!< Causes MidiArp::getNote() to call MidiArp::purgeReleaseNotes() */
+    std::atomic<bool> purgeReleaseFlag; /*!< Causes MidiArp::getNote() to call MidiArp::purgeReleaseNotes() */
+    std::atomic<bool> purgeLatchFlag;   /*!< Causes the input thread to call MidiArp::purgeLatchBuffer() */
+    std::atomic<bool> clearNotesFlag;   /*!< Causes the input thread to clear the note buffer */
+    std::atomic<bool> purgeReleasedFlag; /*!< Causes the input thread to remove the notes in release stage */
+    std::atomic<int64_t> foldTicks;     /*!< Ticks the input thread shifts the note ticks back by */
     int patternIndex; /*!< Holds the current position within the pattern text*/
     int randomTick, randomVelocity, randomLength;
-    int sustainBufferCount, latchBufferCount;
-    uint64_t lastLatchTick;
     int latchDelayTicks;
     double stepWidth, len, vel;
-    int sustainBuffer[MAXNOTES]; /*!< Holds released note values when MidiArp::sustain is True */
-    int latchBuffer[MAXNOTES];   /*!< Holds released note values when MidiArp::latch_mode is True */
-
-    bool sustain;
     int noteIndex[MAXCHORD], chordSemitone[MAXCHORD];
     int semitone;
- /*! @brief The input note buffer array of the Arpeggiator, which has
-  * two array copies.
-  *
-  * @par The first index (0:1) selects the copy to be modified
-  * avoiding access conflicts while modifying its data.
-  * @par The second index selects the columns corresponding to
-  * - 0: Note value
-  * - 1: Note velocity
-  * - 2: Timing of the note event in internal ticks (NOTE_ON or NOTE_OFF)
-  * - 3: Release tag (0: note is kept in buffer, 1: MidiArp::getNote
-  * will decrease this note's velocity until it reaches 0, and then
-  * definitely remove the by a MidiArp::removeNote call.
-  *
-  * @par The third index is the note index in the buffer.
-  * */
-    int64_t notes[2][4][MAXNOTES];
-
- /*! @brief The storage copy of dynamic attack values.
-  *
-  * These values are to be multiplied with the
-  * velocity at each new arpeggiator step. Its index corresponds
-  * to that of the third MidiArp::notes buffer index.
-  * */
-    double old_attackfn[MAXNOTES];
-    int64_t noteBufPtr;     /*!< Pointer to the currently active note buffer copy */
-    int noteOfs;        /*!< The current index in a chord. @see repeatPatternThroughChord */
-    int octOfs;        /*!< The currently active octave shift. @see repeatPatternThroughChord */
-    int octIncr;        /*!< The octave increment at repeat end. @see repeatPatternThroughChord */
-    int releaseNoteCount; /*!< The number of notes currently in release stage */
+    ArpVoice voices[16];    /*!< Input note state, per input channel with PERCHANNEL */
+    ArpVoice *voice;        /*!< The voice currently worked on */
 
 /**
  * @brief  resets all attributes the pattern
@@ -110,26 +127,28 @@ class MidiArp : public MidiWorker  {
  * @brief This is MidiArp's main note processor producing output notes
  * from input notes.
  *
- * It analyzes the MidiArp::pattern text and MidiArp::notes input buffer
+ * It analyzes the MidiArp::pattern text and ArpVoice::notes input buffer
  * to yield arrays of notes that have to be sent at the given timing.
  * The calculated note data is stored in arrays, copied again by
  * getNextFrame() and the copy is accessed by Engine::echoCallback().
  * Only in case of an arpeggio step involving chords, these arrays have
- * sizes > 1.
+ * sizes > 1. With PERCHANNEL, the notes of all voices follow each
+ * other in the arrays.
  * @param tick The timing of the notes to be scheduled
  * @param note The array of notes to be filled
  * @param velocity The associated array of velocites to be filled
+ * @param channel The associated array of output channels to be filled
  * @param length The note length for this arpeggio step
  */
-    void getNote(int64_t *tick, int64_t note[], int velocity[], int *length);
+    void getNote(int64_t *tick, int64_t note[], int velocity[], int channel[], int *length);
 /**
  * @brief  returns the number of notes present at the MIDI
  * input port.
  *
  * This is the number of notes currently pressed on the keyboard. Note
- * that the input MidiArp::notes buffer size can be different from this
+ * that the input ArpVoice::notes buffer size can be different from this
  * number, since it can contain notes in release state or in the
- * MidiArp::latchBuffer.
+ * ArpVoice::latchBuffer.
  *
  * @return Number of notes present at the MIDI input port.
  */
@@ -152,16 +171,17 @@ class MidiArp : public MidiWorker  {
  *
  * This function is called when the latch and sustain buffers are 
  * cleared. The specified note is either 
- * deleted via MidiArp::deleteNoteAt() or tagged as released if the 
+ * deleted from ArpVoice::notes or tagged as released if the 
  * release function is active and if the keep_rel flag is set to 1. 
  *
- * @param noteptr pointer to the note to be looked for
- * @param tick the current tick position
+ * @param note the note to be looked for
+ * @param tick the current tick position, -1 to delete the note only
+ * if it is in release stage
  * @param keep_rel If set to 1 and MidiArp::release_time is set, the 
  * note is marked as released. If set to 0, the note will be deleted
  * 
  */
-    void removeNote(int64_t *noteptr, int64_t tick, int keep_rel);
+    void removeNote(int note, int64_t tick, int keep_rel);
 /**
  * @brief Handles a released incoming note
  *
@@ -177,41 +197,30 @@ class MidiArp : public MidiWorker  {
  */
     void releaseNote(int note, int64_t tick, bool keep_rel);
 /**
- * @brief  Deletes a note inside the MidiArp::notes input
- * note buffer.
+ * @brief Applies the changes of the note buffer requested by
+ * MidiArp::clearNoteBuffer(), MidiArp::setLatchMode() and
+ * MidiArp::foldReleaseTicks()
  *
- * The note  at the given index is deleted from the buffer with the
- * given bufPtr index (0 or 1), and notes at higher positions in the
- * buffer are moved in position.
- * @param index Index of the note to delete from the buffer
- * @param bufPtr Buffer copy to work with
+ * It is called by the thread handling MIDI input before it accesses
+ * ArpVoice::notes.
  */
-    void deleteNoteAt(int index, int bufPtr);
+    void applyNoteRequests();
 /**
- * @brief  sets the released flag (value 1) for the note
- * at the given index
- *
- * This operation is done for the buffer with given bufPtr index (0 or 1).
- * A released flag set will cause getNote to diminish the velocity of
- * this note at each arpeggio step, and to remove it when the velocity
- * reaches zero.
- *
- * @param note Note value to be tagged as released
- * @param tick The time in internal ticks at which the note was released
- * @param bufPtr The index of the MidiArp::notes buffer currently in use
+ * @brief Removes all notes of MidiArp::voice including the latched ones
  */
-    void tagAsReleased(int note, int64_t tick, int bufPtr);
+    void clearVoice();
 /**
- * @brief  performs a copy within MidiArp::notes from the
- * currently active index to the inactive index
+ * @brief Returns the number of voices in use, 16 with PERCHANNEL and 1
+ * otherwise
  */
-    void copyNoteBuffer();
+    int voiceCount() { return (chIn == PERCHANNEL) ? 16 : 1; }
 /**
  * @brief Advances octOfs according to the settings. Called when the octave
  * reaches an edge condition (at octave range or outside permitted range)
+ * @param v The voice whose octave shift is advanced
  * @param reset Set to True in order to set the octave shift to zero
  */
-    void checkOctaveAtEdge(bool reset);
+    void checkOctaveAtEdge(ArpVoice *v, bool reset);
 
   public:
     bool latch_mode; /*!< If True hold notes released earlier than latch delay in latch buffer */
@@ -258,7 +267,7 @@ class MidiArp : public MidiWorker  {
  */
     bool advancePatternIndex(bool reset);
 
-    bool handleEvent(MidiEvent inEv, int64_t tick, int keep_rel = 0) override;
+    bool handleEvent(MidiEvent inEv, int64_t tick, int keep_rel = 0) final;
 /**
  * @brief Causes calculation of a new note set at a step and copies it
  * to arrays accessed by Engine.
@@ -272,7 +281,8 @@ class MidiArp : public MidiWorker  {
  * @param askedTick the current transport position in ticks.
  *
  */
-    void getNextFrame(int64_t tick) override;
+    void getNextFrame(int64_t tick) final;
+    int frameChannel(int ix) final { return outChannel[ix]; }
 /**
  * @brief  resets the pattern index and sets the current
  * timing of the arpeggio to currentTick.
@@ -285,6 +295,9 @@ class MidiArp : public MidiWorker  {
  */
     void initArpTick(uint64_t tick);
 
+/*! @brief requests removing the notes in release stage if tick <= 0,
+ * or shifting the note ticks back by tick, which is done by
+ * MidiArp::applyNoteRequests(). */
     void foldReleaseTicks(int64_t tick) override;
 /**
  * @brief  seeds new random values for the three parameters
@@ -299,24 +312,25 @@ class MidiArp : public MidiWorker  {
     void newRandomValues();
  /*! @brief Set by Engine when MidiCC #64 is received.
   *
-  * Will cause notes remaining in MidiArp::sustainBuffer until
+  * Will cause notes remaining in ArpVoice::sustainBuffer until
   * set to false.
   * @param sustain Set to True to cause hold mode
   * @param tick Time in internal ticks at which the controller was received */
     void setSustain(bool sustain, uint64_t tick);
- /*! @brief Will cause notes remaining in MidiArp::latchBuffer until new
+ /*! @brief Will cause notes remaining in ArpVoice::latchBuffer until new
   * stakato note received
   *
   *  It is called by ArpWidget::setLatchMode
   */
     void setLatchMode(bool);
- /*! @brief Calls MidiArp::removeNote for all notes in MidiArp::sustainBuffer
+ /*! @brief Calls MidiArp::removeNote for all notes in ArpVoice::sustainBuffer
   * and then clears sustainBuffer.
   *
   *  It is called by MidiArp::setSustain
   * @param sustick Time in internal ticks at which the controller was received */
     void purgeSustainBuffer(uint64_t sustick);
- /*! @brief sets MidiArp::noteCount to zero and clears MidiArp::latchBuffer. */
+ /*! @brief requests clearing ArpVoice::notes and ArpVoice::latchBuffer,
+  * which is done by MidiArp::applyNoteRequests(). */
     void clearNoteBuffer() override;
 /*! @brief Checks if deferred parameter changes are pending and applies
  * them if so
@@ -329,16 +343,13 @@ class MidiArp : public MidiWorker  {
     void updateOctaveMode(int val);
 
  /*! @brief Calls MidiArp::removeNote for
-  * all notes in MidiArp::latchBuffer and then clears latchBuffer.
+  * all notes in ArpVoice::latchBuffer and then clears latchBuffer.
   * @param latchtick Time of note release in internal ticks
   */
     void purgeLatchBuffer(uint64_t latchtick);
 
- /*! @brief Untags notes tagged as released in the specified buffer.
-  * 
-  * @param bufptr Buffer pointer (0 or 1) to the buffer to act on
-  */
-    void purgeReleaseNotes(int bufptr);
+ /*! @brief Removes the notes tagged as released from ArpVoice::notes. */
+    void purgeReleaseNotes();
 /**
  * @brief sets MidiArp::nextTick and MidiArp::patternIndex position
  * according to the specified tick.
@@ -25,6 +25,7 @@
 #include <cstdio>
 #include <cmath>
 #include "midiarp_lv2.h"
+#include "rtcheck.h"
 
 MidiArpLV2::MidiArpLV2 (
     double sample_rate, const LV2_Feature *const *host_features )
@@ -42,7 +43,8 @@ MidiArpLV2::MidiArpLV2 (
     transportBpm = 120.0f;
     transportFramesDelta = 0;
     curTick = 0;
-    tempoChangeTick = 0;
+    tempoMap.setRate(sampleRate);
+    tempoMap.reset(0, 0, tempo);
     hostTransport = true;
     transportSpeed = 0;
     trStartingTick = 0;
@@ -132,33 +134,42 @@ void MidiArpLV2::updatePosAtom(const LV2_Atom_Object* obj)
 
 void MidiArpLV2::updatePos(uint64_t pos, float bpm, int speed, bool ignore_pos)
 {
+    /* While rolling on, a tempo change continues the tempo map at the
+     * current frame, so that the position follows host tempo ramps */
+    const bool rolling = transportSpeed && (transportSpeed == speed)
+                && (ignore_pos || (pos == curFrame));
+
     if (transportBpm != bpm) {
         /* Tempo changed */
         transportBpm = bpm;
         tempo = transportBpm;
-        transportSpeed = 0;
+        if (rolling) tempoMap.setTempo(curFrame, tempo);
     }
 
     if (!ignore_pos) {
-        const float frames_per_beat = 60.0f / transportBpm * sampleRate;
         transportFramesDelta = pos;
-        tempoChangeTick = pos * TPQN / frames_per_beat;
-    }    
+        if (!rolling) {
+            const float frames_per_beat = 60.0f / transportBpm * sampleRate;
+            tempoMap.reset(pos, pos * TPQN / frames_per_beat, tempo);
+        }
+    }
     if (transportSpeed != speed) {
         /* Speed changed, e.g. 0 (stop) to 1 (play) */
+        const uint64_t tick = tempoMap.frameToTick(transportFramesDelta);
         transportSpeed = speed;
         if (transportSpeed) {
             curFrame = transportFramesDelta;
-            foldReleaseTicks(trStartingTick - tempoChangeTick);
-            setNextTick(tempoChangeTick);
+            foldReleaseTicks(trStartingTick - tick);
+            setNextTick(tick);
         } 
 
-        trStartingTick = tempoChangeTick;
+        trStartingTick = tick;
     }
 }
 
 void MidiArpLV2::run ( uint32_t nframes )
 {
+    RT_SCOPE("MidiArpLV2::run");
     const QMidiArpURIs* uris = &m_uris;
     const uint32_t capacity = outEventBuffer->atom.size;
 
@@ -204,46 +215,38 @@ void MidiArpLV2::run ( uint32_t nframes )
             }
             // MIDI Input
             else if (event && event->body.type == uris->midi_MidiEvent) {
-                uint8_t *di = (uint8_t *) LV2_ATOM_BODY(&event->body);
+                const uint8_t *di = (const uint8_t *) LV2_ATOM_BODY(&event->body);
+                const uint8_t *msg;
+                uint32_t pos = 0;
+                uint32_t len, msg_len;
                 MidiEvent inEv = {0, 0, 0, 0};
-                if ( (di[0] & 0xf0) == 0x90 ) {
-                    inEv.type = EV_NOTEON;
-                    inEv.value = di[2];
-                }
-                else if ( (di[0] & 0xf0) == 0x80 ) {
-                    inEv.type = EV_NOTEON;
-                    inEv.value = 0;
-                }
-                else if ( (di[0] & 0xf0) == 0xb0 ) {
-                    inEv.type = EV_CONTROLLER;
-                    inEv.value = di[2];
-                }
-                else inEv.type = EV_NONE;
-
-                inEv.channel = di[0] & 0x0f;
-                inEv.data=di[1];
-                int tick = ((uint64_t)(curFrame - transportFramesDelta) 
-                        * nframes
-                        + (uint64_t)(&event->time.frames) % nframes)
-                        * TPQN*tempo/nframes/60/sampleRate 
-                        + tempoChangeTick;
-                        
-                //printf("curFrame %d \n", curFrame - transportFramesDelta);
-                // Set ticks to zero whenever notes with stopped
-                // transport are received.
-                // Also, when note offs are received when transport is
-                // not rolling, these notes should be removed without
-                // release.
-                bool unmatched = false;
-                if ((hostTransport) && (transportSpeed == 0)) {
-                    tick = 2;
-                    unmatched = handleEvent(inEv, tick - 2, 0);
-                } 
-                else {
-                    unmatched = handleEvent(inEv, tick - 2, 1);
+                while ((len = midiDecoder.decode(di + pos, event->body.size - pos,
+                            &inEv, &msg, &msg_len))) {
+                    pos += len;
+                    if (!msg_len) continue;
+                    if (inEv.type == EV_NOTEOFF) {
+                        inEv.type = EV_NOTEON;
+                        inEv.value = 0;
+                    }
+                    int64_t tick = tempoMap.frameToTick(curFrame + event->time.frames);
+
+                    //printf("curFrame %d \n", curFrame - transportFramesDelta);
+                    // Set ticks to zero whenever notes with stopped
+                    // transport are received.
+                    // Also, when note offs are received when transport is
+                    // not rolling, these notes should be removed without
+                    // release.
+                    bool unmatched = false;
+                    if ((hostTransport) && (transportSpeed == 0)) {
+                        tick = 2;
+                        unmatched = handleEvent(inEv, tick - 2, 0);
+                    } 
+                    else {
+                        unmatched = handleEvent(inEv, tick - 2, 1);
+                    }
+                    if (unmatched) //if event is unmatched, forward it
+                        forgeMidiEvent(event->time.frames, msg, msg_len);
                 }
-                if (unmatched) //if event is unmatched, forward it
-                    forgeMidiEvent((int)((uint64_t)(&event->time.frames) % nframes), di, 3);
             }
         }
     }
@@ -251,21 +254,21 @@ void MidiArpLV2::run ( uint32_t nframes )
 
         // MIDI Output
     for (uint32_t f = 0 ; f < nframes; f++) {
-        curTick = (uint64_t)(curFrame - transportFramesDelta)
-                        *TPQN*tempo/60/sampleRate + tempoChangeTick;
-        if ((curTick >= nextTick) && (transportSpeed)) {
+        curTick = tempoMap.frameToTick(curFrame);
+        if ((curTick >= (uint64_t)nextTick) && (transportSpeed)) {
             getNextFrame(curTick);
             if (!isMuted) {
                 if (outFrame[0].value) {
                     int l2 = 0;
                     while(outFrame[l2].data >= 0) {
                         unsigned char d[3];
-                        d[0] = 0x90 + channelOut;
+                        d[0] = 0x90 + frameChannel(l2);
                         d[1] = outFrame[l2].data;
                         d[2] = outFrame[l2].value;
                         forgeMidiEvent(f, d, 3);
                         evTickQueue[bufPtr] = curTick + returnLength / 4;
-                        evQueue[bufPtr] = outFrame[l2].data;
+                        evQueue[bufPtr] = outFrame[l2].data
+                                        | (frameChannel(l2) << 8);
                         bufPtr++;
                         l2++;
                     }
@@ -276,10 +279,10 @@ void MidiArpLV2::run ( uint32_t nframes )
         }
 
         // Note Off Queue handling
-        int noteofftick = evTickQueue[0];
+        uint64_t noteofftick = evTickQueue[0];
         int idx = 0;
         for (int l1 = 0; l1 < bufPtr; l1++) {
-            int tmptick = evTickQueue[l1];
+            uint64_t tmptick = evTickQueue[l1];
             if (noteofftick > tmptick) {
                 idx = l1;
                 noteofftick = tmptick;
@@ -295,8 +298,8 @@ void MidiArpLV2::run ( uint32_t nframes )
             bufPtr--;
 
             unsigned char d[3];
-            d[0] = 0x80 + channelOut;
-            d[1] = outval;
+            d[0] = 0x80 + (outval >> 8);
+            d[1] = outval & 0x7f;
             d[2] = 127;
             forgeMidiEvent(f, d, 3);
         }
@@ -360,11 +363,17 @@ void MidiArpLV2::updateParams()
 
     repeatPatternThroughChord = (int)*val[REPEAT_MODE];
     channelOut =      (int)*val[CH_OUT];
+    if (((int)*val[CH_IN] == PERCHANNEL) != (chIn == PERCHANNEL))
+        clearNoteBuffer();
     chIn =            (int)*val[CH_IN];
 
     if (internalTempo != *val[TEMPO]) {
         internalTempo = *val[TEMPO];
-        initTransport();
+        if (!hostTransport) {
+            transportBpm = internalTempo;
+            tempo = internalTempo;
+            tempoMap.setTempo(curFrame, tempo);
+        }
     }
 
     if (hostTransport != (bool)(*val[TRANSPORT_MODE])) {
@@ -384,14 +393,15 @@ void MidiArpLV2::initTransport()
 {
     if (!hostTransport) {
         transportFramesDelta = curFrame;
-        if (curTick > 0) tempoChangeTick = curTick;
         transportBpm = internalTempo;
         tempo = internalTempo;
+        tempoMap.reset(curFrame, tempoMap.frameToTick(curFrame), tempo);
         transportSpeed = 1;
     }
     else transportSpeed = 0;
 
-    setNextTick(tempoChangeTick);
+    const uint64_t tick = tempoMap.frameToTick(curFrame);
+    setNextTick(tick);
 }
 
 void MidiArpLV2::sendPattern(const std::string & p)
@@ -432,6 +442,10 @@ static LV2_State_Status MidiArpLV2_state_restore ( LV2_Handle instance,
 
     if (type == 0) return LV2_STATE_ERR_BAD_TYPE;
 
+    uint32_t seed;
+    if (retrieve_random_seed(retrieve, handle, uris, seed))
+        pPlugin->setRandomSeed(seed);
+
     size_t size = 0;
 
     uint32_t key = uris->pattern_string;
@@ -465,13 +479,17 @@ static LV2_State_Status MidiArpLV2_state_save ( LV2_Handle instance,
 
     flags |= (LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 
+    LV2_State_Status result = store_random_seed(store, handle, uris,
+                    pPlugin->randomSeed);
+    if (result != LV2_STATE_SUCCESS) return result;
+
     const char* c = pPlugin->pattern.c_str();
 
     size_t size = strlen(c) + 1;
     uint32_t key = uris->pattern_string;
     if (!key) return LV2_STATE_ERR_NO_PROPERTY;
 
-    LV2_State_Status result = (*store)(handle, key, c, size, type, flags);
+    result = (*store)(handle, key, c, size, type, flags);
 
     return result;
 }
@@ -484,6 +502,7 @@ static const LV2_State_Interface MidiArpLV2_state_interface =
 
 void MidiArpLV2::activate (void)
 {
+    resetRandom();
     initTransport();
 }
 
@@ -27,6 +27,7 @@
 
 #include "midiarp.h"
 #include "lv2_common.h"
+#include "timebase.h"
 
 #define QMIDIARP_ARP_LV2_URI QMIDIARP_LV2_URI "/arp"
 #define QMIDIARP_ARP_LV2_PREFIX QMIDIARP_ARP_LV2_URI "#"
@@ -90,9 +91,10 @@ private:
 
         float *val[30];
         uint64_t curFrame;
-        uint64_t tempoChangeTick;
+        TempoMap tempoMap;  /**< Maps curFrame to ticks */
+        MidiDecoder midiDecoder;  /**< Decodes the raw bytes of the MIDI input */
         uint64_t trStartingTick;
-        int curTick;
+        uint64_t curTick;
         double internalTempo;
         double sampleRate;
         double tempo;
@@ -106,8 +108,8 @@ private:
         float transportBpm;
         float transportSpeed;
         bool hostTransport;
-        uint32_t evQueue[JQ_BUFSZ];
-        uint32_t evTickQueue[JQ_BUFSZ];
+        uint32_t evQueue[JQ_BUFSZ];    /**< Pending note offs, note value + channel * 256 */
+        uint64_t evTickQueue[JQ_BUFSZ];
         int bufPtr;
 
         LV2_Atom_Sequence *inEventBuffer;
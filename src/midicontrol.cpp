@@ -27,14 +27,10 @@ MidiControl::MidiControl(QWidget *parent)
 {
     setParent(parent);
     ID = 0;
-    // QSignalMappers allow identifying signal senders for MIDI learn/forget
-    learnSignalMapper = new QSignalMapper(this);
-    connect(learnSignalMapper, SIGNAL(mapped(int)),
-             this, SLOT(midiLearn(int)));
-
-    forgetSignalMapper = new QSignalMapper(this);
-    connect(forgetSignalMapper, SIGNAL(mapped(int)),
-             this, SLOT(midiForget(int)));
+    // the context menu is built on first request in showMidiLearnMenu()
+    learnMenu = NULL;
+    learnAction = NULL;
+    forgetAction = NULL;
 
     // we need the cancel MIDI Learn action only once for all
     cancelMidiLearnAction = new QAction(tr("Cancel MIDI &Learning"), this);
@@ -48,6 +44,7 @@ MidiControl::MidiControl(QWidget *parent)
 
 MidiControl::~MidiControl()
 {
+    delete learnMenu;
 }
 void MidiControl::update()
 {
@@ -141,19 +138,41 @@ void MidiControl::midiLearnCancel()
 
 void MidiControl::addMidiLearnMenu(const QString &name, QWidget *widget, int count)
 {
-    widget->setContextMenuPolicy(Qt::ContextMenuPolicy(Qt::ActionsContextMenu));
-    QAction *learnAction = new QAction(tr("MIDI &Learn"), this);
-    widget->addAction(learnAction);
-    connect(learnAction, SIGNAL(triggered()), learnSignalMapper, SLOT(map()));
-    learnSignalMapper->setMapping(learnAction, count);
+    widget->setContextMenuPolicy(Qt::ContextMenuPolicy(Qt::CustomContextMenu));
+    widget->setProperty("midiControlID", count);
+    connect(widget, SIGNAL(customContextMenuRequested(const QPoint &)),
+            this, SLOT(showMidiLearnMenu(const QPoint &)));
+    names[count] = name;
+}
 
-    QAction *forgetAction = new QAction(tr("MIDI &Forget"), this);
-    widget->addAction(forgetAction);
-    connect(forgetAction, SIGNAL(triggered()), forgetSignalMapper, SLOT(map()));
-    forgetSignalMapper->setMapping(forgetAction, count);
+void MidiControl::showMidiLearnMenu(const QPoint &pos)
+{
+    QWidget *widget = qobject_cast<QWidget *>(sender());
+    if (widget == NULL) return;
 
-    widget->addAction(cancelMidiLearnAction);
-    names[count] = name;
+    if (learnMenu == NULL) {
+        learnMenu = new QMenu();
+        learnAction = learnMenu->addAction(tr("MIDI &Learn"));
+        connect(learnAction, SIGNAL(triggered()), this, SLOT(learnActionTriggered()));
+        forgetAction = learnMenu->addAction(tr("MIDI &Forget"));
+        connect(forgetAction, SIGNAL(triggered()), this, SLOT(forgetActionTriggered()));
+        learnMenu->addAction(cancelMidiLearnAction);
+    }
+
+    int controlID = widget->property("midiControlID").toInt();
+    learnAction->setData(controlID);
+    forgetAction->setData(controlID);
+    learnMenu->popup(widget->mapToGlobal(pos));
+}
+
+void MidiControl::learnActionTriggered()
+{
+    midiLearn(learnAction->data().toInt());
+}
+
+void MidiControl::forgetActionTriggered()
+{
+    midiForget(forgetAction->data().toInt());
 }
 
 void MidiControl::readData(QXmlStreamReader& xml)
@@ -25,7 +25,7 @@
 #define MIDICONTROL_H
 
 #include <QAction>
-#include <QSignalMapper>
+#include <QMenu>
 #include <QStringList>
 #include <QVector>
 #include <QXmlStreamWriter>
@@ -62,17 +62,16 @@ class MidiControl : public QObject
   private:
     QAction *cancelMidiLearnAction;
 /*!
-* @brief Forwards the MIDI-learn context menu action signal to the
-* MidiControl::midiLearn() slot along with the ID of the
-* controllable QWidget
-*/
-    QSignalMapper *learnSignalMapper;
-/*!
-* @brief Forwards the MIDI-forget context menu action signal to the
-* MidiControl::midiForget() slot along with the ID of the
-* controllable QWidget
+* @brief MIDI-Learn context menu shared by all controllable QWidgets
+* of this module.
+*
+* It is only built by MidiControl::showMidiLearnMenu() the first time
+* a context menu is requested, so that loading a session with many
+* modules does not create two QActions per controllable QWidget.
 */
-    QSignalMapper *forgetSignalMapper;
+    QMenu *learnMenu;
+    QAction *learnAction;   /*!< MIDI Learn entry of MidiControl::learnMenu */
+    QAction *forgetAction;  /*!< MIDI Forget entry of MidiControl::learnMenu */
     bool newCCPending;
     bool modified;
     MidiCC pendingCC;
@@ -97,10 +96,11 @@ class MidiControl : public QObject
 */
     void setModified(bool);
 /*!
-* @brief Creates and attributes a MIDI-Learn context menu to the passed QWidget.
+* @brief Attributes the MIDI-Learn context menu to the passed QWidget.
 *
-* The menu entries are connected to MidiControl::learnSignalMapper and
-* MidiControl::forgetSignalMapper for dispatching actions
+* The control ID is stored as the "midiControlID" property of the
+* QWidget, the menu itself is built lazily by
+* MidiControl::showMidiLearnMenu() when it is first requested.
 *
 * @param name Convenient name for attribution to the controllable QWidget
 * @param widget QWidget to which the context menu is attributed
@@ -128,6 +128,20 @@ void skipXmlElement(QXmlStreamReader& xml);
 */
     void setMidiLearn(int ID, int controlID);
 
+  private slots:
+/*!
+* @brief Shows the MIDI-Learn context menu for the QWidget sending
+* the customContextMenuRequested() signal.
+*
+* The menu is created on first call and then reused for all
+* controllable QWidgets of this module. The control ID of the sending
+* QWidget is attached to the learn and forget actions.
+* @param pos Position of the request in sender QWidget coordinates
+*/
+    void showMidiLearnMenu(const QPoint &pos);
+    void learnActionTriggered();
+    void forgetActionTriggered();
+
   public slots:
 /*!
 * @brief Calls MidiControl::requestAppendMidiCC() and MidiControl::update()
@@ -169,8 +183,7 @@ void skipXmlElement(QXmlStreamReader& xml);
 */
     void removeMidiCC(int controlID, int ccnumber, int channel);
 /*!
-* @brief Slot for the MidiControl::learnSignalMapper signal forwarded from
-* the MIDI-Learn context menu "MIDI Learn" actions.
+* @brief Slot for the MIDI-Learn context menu "MIDI Learn" action.
 *
 * It emits the MidiControl::setMidiLearn() signal with the necessary
 * module and GUI element information parameters to Engine::setMidiLearn().
@@ -178,8 +191,7 @@ void skipXmlElement(QXmlStreamReader& xml);
 */
     void midiLearn(int controlID);
 /*!
-* @brief Slot for the MidiControl::forgetSignalMapper signal forwarded from
-* the MIDI-Learn context menu "MIDI Forget" actions.
+* @brief Slot for the MIDI-Learn context menu "MIDI Forget" action.
 *
 * Removes a controller binding attribution by calling
 * MidiControl::removeMidiCC().
@@ -25,13 +25,15 @@
 #ifndef SAMPLE_H
 #define SAMPLE_H
 
+#include <cstdint>
+
 /*! @brief Structure holding elements of a MIDI note or controller representing
  * one point of a waveform
  */
     struct Sample {
         int data;
         int value;
-        int tick;
+        int64_t tick;
         bool muted;
     };
 #endif
@@ -39,6 +41,8 @@
 #ifndef MIDIEVENT_H
 #define MIDIEVENT_H
 
+#include <cstdint>
+
 
 /*! @brief Structure holding elements of a MIDI event
  */
@@ -100,4 +104,233 @@ enum midi_event_type {
     EV_NONE = 255
 };
 
+/*! @brief Event types of the MIDI channel messages by status byte high
+ * nibble minus 8 */
+static const uint8_t midiChannelType[7] = {
+    EV_NOTEOFF, EV_NOTEON, EV_KEYPRESS, EV_CONTROLLER,
+    EV_PGMCHANGE, EV_CHANPRESS, EV_PITCHBEND
+};
+
+/*! @brief Lengths of the MIDI channel messages by status byte high
+ * nibble minus 8 */
+static const uint8_t midiChannelLength[7] = { 3, 3, 3, 3, 2, 2, 3 };
+
+/*! @brief Event types of the MIDI system messages by status byte
+ * minus 0xf0 */
+static const uint8_t midiSystemType[16] = {
+    EV_SYSEX, EV_QFRAME, EV_SONGPOS, EV_SONGSEL,
+    EV_NONE, EV_NONE, EV_TUNE_REQUEST, EV_NONE,
+    EV_CLOCK, EV_NONE, EV_START, EV_CONTINUE,
+    EV_STOP, EV_NONE, EV_SENSING, EV_RESET
+};
+
+/*! @brief Lengths of the MIDI system messages by status byte minus 0xf0,
+ * SysEx has variable length and is given as 0 */
+static const uint8_t midiSystemLength[16] = {
+    0, 2, 3, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+/*! @brief Decoder of raw MIDI byte streams into MidiEvent structures
+ *
+ * MidiDecoder::decode() is called repeatedly on a buffer of raw MIDI
+ * bytes as delivered by JACK or LV2, and returns one message at a time.
+ * Message types and lengths are looked up in the tables above.
+ * Running status is followed across calls and buffers. Realtime bytes
+ * are returned as messages of their own, also when they interrupt
+ * another message, whose decoding then continues.
+ *
+ * SysEx is returned as EV_SYSEX fragments, one per input buffer it
+ * spans. The first fragment starts with 0xf0 and the last one ends
+ * with 0xf7, so forwarding all fragments in order reproduces the
+ * message. A SysEx contained in one buffer is a single fragment.
+ * Realtime bytes inside a fragment stay part of it, those at the
+ * start of a buffer are returned as messages of their own. A status
+ * byte other than realtime ends a SysEx unterminated.
+ *
+ * Each message is also returned as a pointer and a length for
+ * forwarding. It points into the input buffer when the message is
+ * contiguous there, which is the usual case, and to a copy within the
+ * decoder only when its status byte has to be restored from running
+ * status or when a realtime byte has been cut out of it.
+ */
+class MidiDecoder {
+
+  private:
+    uint8_t runningStatus;  /*!< Status of the last channel message, 0 if none */
+    uint8_t msgBuf[3];      /*!< Channel or system common message being assembled */
+    uint32_t count;         /*!< Bytes in msgBuf, 0 if no message is pending */
+    uint32_t need;          /*!< Length of the message in msgBuf */
+    bool inSysex;           /*!< A SysEx continues in the next buffer */
+
+    static uint32_t length(uint8_t status)
+    {
+        if (status >= 0xf0) return midiSystemLength[status - 0xf0];
+        return midiChannelLength[(status >> 4) - 8];
+    }
+
+  public:
+    MidiDecoder() : runningStatus(0), count(0), need(0), inSysex(false) {}
+
+/*!
+* @brief Fills a MidiEvent from a complete MIDI message
+*
+* Channel messages are given their channel, system messages channel 0.
+* The value is the second data byte of note, key pressure and
+* controller messages, the first one for program change and channel
+* pressure, and the combined 14 bit value for pitch bend (centered
+* around 0) and song position.
+* @param msg Pointer to the status byte of the message
+* @param len Length of the message in bytes
+* @param ev MidiEvent to fill
+*/
+    static void fillEvent(const uint8_t *msg, uint32_t len, MidiEvent *ev)
+    {
+        uint8_t status = msg[0];
+
+        ev->data = (len > 1) ? msg[1] : 0;
+        ev->value = 0;
+        if (status >= 0xf0) {
+            ev->type = midiSystemType[status - 0xf0];
+            ev->channel = 0;
+            if ((ev->type == EV_SONGPOS) && (len > 2))
+                ev->value = msg[2] * 128 + msg[1];
+            return;
+        }
+        ev->type = midiChannelType[(status >> 4) - 8];
+        ev->channel = status & 0x0f;
+        switch (ev->type) {
+            case EV_PGMCHANGE:
+            case EV_CHANPRESS:
+                ev->value = msg[1];
+            break;
+            case EV_PITCHBEND:
+                ev->value = msg[2] * 128 + msg[1] - 8192;
+            break;
+            default:
+                ev->value = msg[2];
+        }
+    }
+
+/*!
+* @brief Decodes the next MIDI message from a byte buffer
+*
+* @param buf Pointer to the bytes not consumed so far
+* @param size Number of bytes not consumed so far
+* @param ev MidiEvent filled when a message is complete
+* @param msg Set to the complete message for forwarding
+* @param len Set to the length of the complete message, 0 if the
+* consumed bytes did not complete a message
+* @return Number of bytes consumed, 0 when size is 0
+*/
+    uint32_t decode(const uint8_t *buf, uint32_t size, MidiEvent *ev,
+                    const uint8_t **msg, uint32_t *len)
+    {
+        uint32_t pos = 0;
+        uint8_t b;
+
+        *len = 0;
+        if (!size) return 0;
+        b = buf[0];
+
+        if (b >= 0xf8) {
+            *msg = buf;
+            *len = 1;
+            fillEvent(buf, 1, ev);
+            return 1;
+        }
+        if (inSysex && (b == 0xf7)) {
+            /* end of a SysEx continued from the previous buffer */
+            pos = 1;
+            inSysex = false;
+        }
+        else if ((b == 0xf0) || (inSysex && (b < 0x80))) {
+            runningStatus = 0;
+            count = 0;
+            inSysex = true;
+            for (pos = 1; pos < size; pos++) {
+                if (buf[pos] == 0xf7) {
+                    pos++;
+                    inSysex = false;
+                    break;
+                }
+                /* a status byte other than realtime ends SysEx unterminated */
+                if ((buf[pos] & 0x80) && (buf[pos] < 0xf8)) {
+                    inSysex = false;
+                    break;
+                }
+            }
+        }
+        else inSysex = false;
+
+        if (pos) {
+            *msg = buf;
+            *len = pos;
+            /* continuation fragments have no status byte of their own */
+            if (b == 0xf0) fillEvent(buf, pos, ev);
+            else {
+                ev->type = EV_SYSEX;
+                ev->channel = 0;
+                ev->data = 0;
+                ev->value = 0;
+            }
+            return pos;
+        }
+        if (b & 0x80) {
+            runningStatus = (b < 0xf0) ? b : 0;
+            need = length(b);
+            /* fast path for a message contiguous in the buffer */
+            if (need <= size) {
+                for (pos = 1; pos < need; pos++) {
+                    if (buf[pos] & 0x80) break;
+                }
+                if (pos == need) {
+                    count = 0;
+                    *msg = buf;
+                    *len = need;
+                    fillEvent(buf, need, ev);
+                    return need;
+                }
+            }
+            msgBuf[0] = b;
+            count = 1;
+            pos = 1;
+        }
+        else if (!count) {
+            /* data byte without status, dropped */
+            if (!runningStatus) return 1;
+            msgBuf[0] = runningStatus;
+            need = length(runningStatus);
+            count = 1;
+        }
+
+        while ((pos < size) && (count < need)) {
+            b = buf[pos];
+            /* a realtime byte is returned by the next call */
+            if (b >= 0xf8) return pos;
+            if (b & 0x80) {
+                /* a new status aborts the incomplete message */
+                count = 0;
+                return pos;
+            }
+            msgBuf[count++] = b;
+            pos++;
+        }
+        if (count == need) {
+            count = 0;
+            *msg = msgBuf;
+            *len = need;
+            fillEvent(msgBuf, need, ev);
+        }
+        return pos;
+    }
+
+/*! @brief Clears running status and any incomplete message */
+    void reset()
+    {
+        runningStatus = 0;
+        count = 0;
+        inSysex = false;
+    }
+};
+
 #endif
@@ -43,26 +43,34 @@ MidiLfo::MidiLfo()
     isRecording = false;
     recValue = 0;
     cwmin = 0;
+    thinDelta = 0;
+    thinInterval = 0;
+    lastSentValue = -1;
+    lastSentData = 0;
+    lastSentTick = 0;
     const int wavesize = 32768;
 
     customWave.resize(wavesize);
-    muteMask.resize(wavesize);
+    customWave.fill(63, false);
     data.reserve(wavesize);
+
+    WaveSnapshot snapshot;
+    snapshot.wave.resize(wavesize);
+    snapshot.res = res;
+    snapshot.npoints = 0;
+    snapshot.loopMarker = 0;
+    waveBuffer.init(snapshot);
     outFrame.resize(32);
     
     Sample sample = {0, 0, 0, false};
     sample.value = 63;
     sample.data = 0;
-    for (int l1 = 0; l1 < wavesize; l1++) {
+    for (int l1 = 0; l1 < 32; l1++) {
         sample.tick =  l1 * TPQN / res;;
-        sample.muted = false;
-        customWave[l1] = sample;
-        data[l1] = sample;
-        if (l1 < 32) outFrame[l1] = sample;
-        muteMask[l1] = false;
+        outFrame[l1] = sample;
     }
     updateWaveForm(waveFormIndex);
-    getData(&data);
+    updateData();
     lastMouseLoc = 0;
     lastMouseY = 0;
     frameSize = 1;
@@ -72,15 +80,26 @@ MidiLfo::MidiLfo()
 
 void MidiLfo::getNextFrame(int64_t tick)
 {
+    applyRandomReset();
     //this function is called by engine and returns one sample
     //if res <= LFO_FRAMELIMIT. If res > LFO_FRAMELIMIT, a frame is output
     //The FRAMELIMIT avoids excessive cursor updating
 
-    if ((uint32_t)framePtr >= data.size()) return;
-    
+    // take over wave and resolution last published by the GUI thread,
+    // they replace the res and size members within this function
+    waveBuffer.update();
+    const WaveSnapshot &wave = waveBuffer.readBuffer();
+    const int npoints = wave.npoints;
+    const int res = wave.res;
+
+    if (!npoints) {
+        outFrameCount = 0;
+        return;
+    }
+
     Sample sample = {0, 0, 0, false};
-    const int npoints = size * res;
-    int lt, l1;
+    int64_t lt;
+    int l1;
     int framelimit;
     int index;
 
@@ -93,6 +112,8 @@ void MidiLfo::getNextFrame(int64_t tick)
     const int step = TPQN * frameSize / res;
 
     if (restartFlag) setFramePtr(0);
+    /* the wave may have been shortened since the last step */
+    if (framePtr >= npoints) framePtr %= npoints;
     if (!framePtr) grooveTick = newGrooveTick;
 
     l1 = 0;
@@ -104,7 +125,8 @@ void MidiLfo::getNextFrame(int64_t tick)
         else {
             index = (l1 + framePtr) % npoints;
         }
-        sample = data.at(index);
+        sample.value = wave.wave.value(index);
+        sample.muted = wave.wave.isMuted(index);
 
         if (isRecording) {
             if (frameSize < 2) {
@@ -119,13 +141,14 @@ void MidiLfo::getNextFrame(int64_t tick)
                             + (double)(recValue - lastSampleValue) / res * framelimit
                             * ((double)l1 + .5);
             }
-            customWave[index] = sample;
+            customWave.setValue(index, sample.value);
             dataChanged = true;
         }
         sample.tick = lt;
         sample.data = ccnumber;
         
         if (seqFinished) sample.muted = true;
+        if (!sample.muted && thinOut(sample)) sample.muted = true;
         outFrame[l1] = sample;
         l1++;
     } while ((l1 < frameSize) && (l1 < npoints));
@@ -138,7 +161,7 @@ void MidiLfo::getNextFrame(int64_t tick)
         || (framePtr == npoints - l1 && reverse)) applyPendingParChanges();
 
     if (curLoopMode == 6) {
-        framePtr = (rand() % npoints) / l1;
+        framePtr = randomValue(npoints) / l1;
         framePtr *= l1;
     }
     else {
@@ -184,6 +207,7 @@ void MidiLfo::getNextFrame(int64_t tick)
     sample.data = -1;
     sample.tick = nextTick;
     outFrame[l1] = sample;
+    outFrameCount = l1;
 
     if (!trigByKbd && !(framePtr % 2) && !grooveTick) {
         /* round-up to current resolution (quantize) */
@@ -194,17 +218,15 @@ void MidiLfo::getNextFrame(int64_t tick)
     if (seqFinished) framePtr = 0;
 }
 
-void MidiLfo::getData(std::vector<Sample> *p_data)
+void MidiLfo::updateData()
 {
-    //this function returns the full LFO wave
+    //this function calculates the full LFO wave into data
 
-    Sample sample = {0, 0, 0, false};
     const int npoints = size * res;
     int val = 0;
     bool cl = false;
-    std::vector<Sample> tmpdata;
 
-    tmpdata.clear();
+    data.resize(npoints);
 
     int phase_max = res * 32 / freq;
     int ph = phase_max * phase / 128;
@@ -212,22 +234,16 @@ void MidiLfo::getData(std::vector<Sample> *p_data)
     switch(waveFormIndex) {
         case 0: //sine
             for (int l1 = 0; l1 < npoints; l1++) {
-                sample.value = clip((-cos((double)((l1 + ph) * 6.28 /
-                res * freq / 32)) + 1) * amp / 2 + offs, 0, 127, &cl);
-                sample.tick = l1 * TPQN / res;;
-                sample.muted = muteMask.at(l1);
-                tmpdata.push_back(sample);
+                data.setValue(l1, clip((-cos((double)((l1 + ph) * 6.28 /
+                res * freq / 32)) + 1) * amp / 2 + offs, 0, 127, &cl));
             }
         break;
         case 1: //sawtooth up
             val = freq * ph;
             val %= res * 32;
             for (int l1 = 0; l1 < npoints; l1++) {
-                sample.value = clip(val * amp / res / 32
-                + offs, 0, 127, &cl);
-                sample.tick = l1 * TPQN / res;;
-                sample.muted = muteMask.at(l1);
-                tmpdata.push_back(sample);
+                data.setValue(l1, clip(val * amp / res / 32
+                + offs, 0, 127, &cl));
                 val += freq;
                 val %= res * 32;
             }
@@ -238,11 +254,8 @@ void MidiLfo::getData(std::vector<Sample> *p_data)
             for (int l1 = 0; l1 < npoints; l1++) {
                 int tempval = val - res * 16;
                 if (tempval < 0 ) tempval = -tempval;
-                sample.value = clip((res * 16 - tempval) * amp
-                        / res / 16 + offs, 0, 127, &cl);
-                sample.tick = l1 * TPQN / res;;
-                sample.muted = muteMask.at(l1);
-                tmpdata.push_back(sample);
+                data.setValue(l1, clip((res * 16 - tempval) * amp
+                        / res / 16 + offs, 0, 127, &cl));
                 val += freq;
                 val %= res * 32;
             }
@@ -251,37 +264,61 @@ void MidiLfo::getData(std::vector<Sample> *p_data)
             val = freq * ph;
             val %= res * 32;
             for (int l1 = 0; l1 < npoints; l1++) {
-                sample.value = clip((res * 32 - val)
-                        * amp / res / 32 + offs, 0, 127, &cl);
-                sample.tick = l1 * TPQN / res;;
-                sample.muted = muteMask.at(l1);
-                tmpdata.push_back(sample);
+                data.setValue(l1, clip((res * 32 - val)
+                        * amp / res / 32 + offs, 0, 127, &cl));
                 val += freq;
                 val %= res * 32;
             }
         break;
         case 4: //square
             for (int l1 = 0; l1 < npoints; l1++) {
-                sample.value = clip(amp * (( (l1 + ph) * freq / 16
-                        / res) % 2 == 0) + offs, 0, 127, &cl);
-                sample.tick = l1 * TPQN / res;;
-                sample.muted = muteMask.at(l1);
-                tmpdata.push_back(sample);
+                data.setValue(l1, clip(amp * (( (l1 + ph) * freq / 16
+                        / res) % 2 == 0) + offs, 0, 127, &cl));
             }
         break;
         case 5: //custom
-            for (int l1 = 0; l1 < npoints; l1++) {
-                tmpdata.push_back(customWave[l1]);
-            }
+            data.copyFrom(customWave, npoints);
         break;
         default:
         break;
     }
+    if (waveFormIndex != 5) {
+        for (int l1 = 0; l1 < npoints; l1++) {
+            data.setMuted(l1, customWave.isMuted(l1));
+        }
+    }
+    publishData();
+}
+
+void MidiLfo::publishData()
+{
+    WaveSnapshot &snapshot = waveBuffer.writeBuffer();
+
+    snapshot.wave.copyFrom(data, data.size());
+    snapshot.res = res;
+    snapshot.npoints = data.size();
+    waveBuffer.publish();
+}
+
+void MidiLfo::getData(std::vector<Sample> *p_data)
+{
+    //this function returns the full LFO wave
+
+    Sample sample = {0, 0, 0, false};
+
+    updateData();
+
+    const int npoints = data.size();
+    p_data->resize(npoints + 1);
+    for (int l1 = 0; l1 < npoints; l1++) {
+        sample.value = data.value(l1);
+        sample.tick = l1 * TPQN / res;
+        sample.muted = data.isMuted(l1);
+        (*p_data)[l1] = sample;
+    }
     sample.data = -1;
-    sample.tick = npoints * TPQN / res;;
-    tmpdata.push_back(sample);
-    data = tmpdata;
-    *p_data = data;
+    sample.tick = npoints * TPQN / res;
+    (*p_data)[npoints] = sample;
 }
 
 void MidiLfo::updateWaveForm(int val)
@@ -337,7 +374,6 @@ void MidiLfo::updateLoop(int val)
 
 int MidiLfo::setCustomWavePoint(double mouseX, double mouseY, bool newpt)
 {
-    Sample sample = {0, 0, 0, false};
     int loc = mouseX * (res * size);
     int Y = mouseY * 128;
 
@@ -362,9 +398,7 @@ int MidiLfo::setCustomWavePoint(double mouseX, double mouseY, bool newpt)
             lastMouseY -= (double)(lastMouseY - Y) / (lastMouseLoc - loc) - .5;
             lastMouseLoc--;
         }
-        sample = customWave[lastMouseLoc];
-        sample.value = lastMouseY;
-        customWave[lastMouseLoc] = sample;
+        customWave.setValue(lastMouseLoc, lastMouseY);
     } while (lastMouseLoc != loc);
 
     newCustomOffset();
@@ -398,19 +432,9 @@ int MidiLfo::mouseEvent(double mouseX, double mouseY, int buttons, int pressed)
 void MidiLfo::resizeAll()
 {
     const int npoints = res * size;
-    Sample sample = {0, 0, 0, false};
-
-    framePtr%=npoints;
 
     if (maxNPoints < npoints) {
-        for (int l1 = 0; l1 < npoints; l1++) {
-            if (l1 >= maxNPoints)
-                muteMask[l1] = muteMask[l1 % maxNPoints];
-            sample = customWave[l1 % maxNPoints];
-            sample.tick = l1 * TPQN / res;
-            sample.muted = muteMask[l1];
-            customWave[l1] = sample;
-        }
+        customWave.repeat(maxNPoints, npoints);
         maxNPoints = npoints;
     }
     nPoints = npoints;
@@ -420,8 +444,9 @@ void MidiLfo::resizeAll()
 void MidiLfo::copyToCustom()
 {
     updateWaveForm(5);
+    // mute states are kept, they apply to all waveforms
     for (int l1 = 0; l1 < nPoints; l1++)
-        customWave[l1] = data[l1];
+        customWave.setValue(l1, data.value(l1));
 
 }
 
@@ -430,7 +455,7 @@ void MidiLfo::newCustomOffset()
     int min = 127;
     const int npoints = res * size;
     for (int l1 = 0; l1 < npoints; l1++) {
-        int value = customWave[l1].value;
+        int value = customWave.value(l1);
         if (value < min) min = value;
     }
     cwmin = min;
@@ -441,7 +466,6 @@ void MidiLfo::newCustomOffset()
 
 void MidiLfo::flipWaveVertical()
 {
-    Sample sample = {0, 0, 0, false};
     int min = 127;
     int max = 0;
     const int npoints = res * size;
@@ -451,15 +475,13 @@ void MidiLfo::flipWaveVertical()
     }
     
     for (int l1 = 0; l1 < npoints; l1++) {
-        int value = customWave[l1].value;
+        int value = customWave.value(l1);
         if (value < min) min = value;
         if (value > max) max = value;
     }
 
     for (int l1 = 0; l1 < npoints; l1++) {
-        sample = customWave[l1];
-        sample.value = min + max - sample.value;
-        customWave[l1] = sample;
+        customWave.setValue(l1, min + max - customWave.value(l1));
     }
     cwmin = min;
 #ifdef APPBUILD
@@ -469,47 +491,36 @@ void MidiLfo::flipWaveVertical()
 
 void MidiLfo::updateCustomWaveOffset(int o)
 {
-    Sample sample = {0, 0, 0, false};
     const int count = res * size;
     int l1 = 0;
     bool cl = false;
 
     while ((!cl) && (l1 < count)) {
-        sample.value = clip(customWave[l1].value + o - cwmin,
-                            0, 127, &cl);
+        clip(customWave.value(l1) + o - cwmin, 0, 127, &cl);
         l1++;
         }
 
     if (cl) return;
 
     for (l1 = 0; l1 < count; l1++) {
-        sample = customWave[l1];
-        sample.value += o - cwmin;
-        customWave[l1] = sample;
+        customWave.setValue(l1, customWave.value(l1) + o - cwmin);
     }
     cwmin = o;
 }
 
 bool MidiLfo::toggleMutePoint(double mouseX)
 {
-    Sample sample = {0, 0, 0, false};
     bool m;
     int loc = mouseX * (res * size);
 
-    m = muteMask.at(loc);
-    muteMask[loc] = !m;
-    if (waveFormIndex == 5) {
-        sample = customWave[loc];
-        sample.muted = !m;
-        customWave[loc] = sample;
-    }
+    m = customWave.isMuted(loc);
+    customWave.setMuted(loc, !m);
     lastMouseLoc = loc;
     return(!m);
 }
 
 int MidiLfo::setMutePoint(double mouseX, bool on)
 {
-    Sample sample = {0, 0, 0, false};
     int loc = mouseX * (res * size);
     
     // Return negative value to signal that data hasn't changed
@@ -518,12 +529,7 @@ int MidiLfo::setMutePoint(double mouseX, bool on)
     if (lastMouseLoc >= (res * size)) lastMouseLoc = loc;
 
     do {
-        if (waveFormIndex == 5) {
-            sample = customWave[lastMouseLoc];
-            sample.muted = on;
-            customWave[lastMouseLoc] = sample;
-        }
-        muteMask[lastMouseLoc] = on;
+        customWave.setMuted(lastMouseLoc, on);
         if (loc > lastMouseLoc) lastMouseLoc++;
         if (loc < lastMouseLoc) lastMouseLoc--;
     } while (lastMouseLoc != loc);
@@ -554,6 +560,33 @@ void MidiLfo::setRecordMode(bool on)
     recordMode = on;
 }
 
+bool MidiLfo::thinOut(const Sample &sample)
+{
+    int delta = (thinDelta > 1) ? thinDelta : 1;
+
+    if (!thinDelta && !thinInterval) return false;
+
+    /* start over after a mute, a controller change or a transport restart */
+    if (isMuted || (sample.data != lastSentData) || (sample.tick < lastSentTick)) {
+        lastSentValue = -1;
+    }
+    if ((lastSentValue >= 0)
+            && ((abs(sample.value - lastSentValue) < delta)
+            || (sample.tick - lastSentTick < thinInterval))) return true;
+
+    lastSentValue = sample.value;
+    lastSentData = sample.data;
+    lastSentTick = sample.tick;
+    return false;
+}
+
+void MidiLfo::updateThinning(int delta, int interval)
+{
+    thinDelta = delta;
+    thinInterval = interval;
+    lastSentValue = -1;
+}
+
 void MidiLfo::record(int value)
 {
     recValue = value;
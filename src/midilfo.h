@@ -26,6 +26,8 @@
 #define MIDILFO_H
 
 #include "midiworker.h"
+#include "wavestore.h"
+#include "swapbuffer.h"
 
 
 /*! @brief MIDI worker class for the LFO Module. Implements a sequencer
@@ -39,7 +41,8 @@
  * the driver's transport. MidiLfo::frame is then accessed by Engine. It
  * has size 1 except for resolution higher than 16th notes.
  * The MidiLfo::data buffer is populated by the getData() function
- * at each modification done via the LfoWidget. It can consist of
+ * at each modification done via the LfoWidget and handed to the driver
+ * thread through the MidiLfo::waveBuffer. It can consist of
  * a classic waveform calculation or a hand-drawn waveform. In all cases
  * the waveform has resolution, offset and size attributes and single
  * points can be tagged as muted, which will avoid data output at the
@@ -52,6 +55,16 @@ class MidiLfo : public MidiWorker  {
     int lastMouseY;     /*!< The Y location at the last modification of the wave, used for interpolation*/
     int recValue;
     int lastSampleValue;
+    int lastSentValue;      /*!< Value of the last point output when thinning, -1 if none */
+    int lastSentData;       /*!< Controller number of the last point output when thinning */
+    int64_t lastSentTick;   /*!< Tick of the last point output when thinning */
+/*! @brief  decides whether a point is dropped by the output thinning
+ * set with MidiLfo::updateThinning().
+ *
+ * @param sample Point to be output
+ * @return True if the point is dropped
+ */
+    bool thinOut(const Sample &sample);
 /*! @brief  recalculates the MidiLfo::customWave as a function
  * of a new offset value.
  *
@@ -59,6 +72,12 @@ class MidiLfo : public MidiWorker  {
  * @param cwoffs New offset value
  */
     void updateCustomWaveOffset(int cwoffs);
+/*! @brief  copies MidiLfo::data together with its resolution to the
+ * MidiLfo::waveBuffer, from which getNextFrame() takes it over at the
+ * next step.
+ */
+    void publishData();
+    SwapBuffer<WaveSnapshot> waveBuffer; /*!< Wave as played by getNextFrame() */
 
   public:
     bool recordMode, isRecording;
@@ -77,9 +96,14 @@ class MidiLfo : public MidiWorker  {
                                         @par 4: Square
                                         @par 5: Use Custom Wave */
     int cwmin;                      /*!< The minimum of MidiLfo::customWave */
-    std::vector<Sample> customWave; /*!< Vector of Sample points holding the custom drawn wave */
-    std::vector<bool> muteMask;     /*!< Vector of booleans with mute state information for each wave point */
-    std::vector<Sample> data;
+    int thinDelta;                  /*!< Minimum change of value for a point to be
+                                        output, 0 to output every point */
+    int thinInterval;               /*!< Minimum ticks between output points,
+                                        0 for no limit */
+    WaveStore customWave;           /*!< Custom drawn wave, its mute states are
+                                        the mute mask applying to all waveforms */
+    WaveStore data;                 /*!< Currently active wave as calculated by
+                                        MidiLfo::updateData() */
 
   public:
     MidiLfo();
@@ -93,6 +117,21 @@ class MidiLfo : public MidiWorker  {
     void updateSize(int);
     void updateLoop(int);
     void record(int value);
+/*! @brief  sets the output thinning of the LFO.
+ *
+ * With thinning enabled, points that repeat the value last output are
+ * dropped, as are points that change it by less than delta or that
+ * follow the last output point within interval ticks. A change held
+ * back by the interval is output with the first point at or after the
+ * end of the interval, so the output lags the wave by at most interval
+ * plus the spacing of two points, TPQN / res ticks. Apart from that
+ * lag it stays within delta of the wave.
+ * Thinning is disabled when both parameters are 0.
+ *
+ * @param delta Minimum change of value for a point to be output
+ * @param interval Minimum ticks between output points
+ */
+    void updateThinning(int delta, int interval);
     void setRecordMode(bool on);
 /*! @brief  Called by LfoWidget::mouseEvent()
  */
@@ -128,13 +167,11 @@ class MidiLfo : public MidiWorker  {
  */
     int setCustomWavePoint(double mouseX, double mouseY, bool newpt);
 /*! @brief  sets the mute state of one point of the
- * MidiLfo::muteMask array to the given state.
+ * MidiLfo::customWave mute mask to the given state.
  *
  * The method is called when the right mouse button is clicked on the
- * LfoScreen via the mouseEvent() function.
- * If calculated waveforms are active, only the MidiLfo::muteMask is
- * changed. If a custom waveform is active, the Sample.mute status
- * at the given position is changed as well.
+ * LfoScreen via the mouseEvent() function. The mute mask applies to
+ * calculated and custom waveforms.
  *
  * @returns index in the wave vector that has been set
  * @param mouseX Normalized Horizontal location of the mouse on the
@@ -171,36 +208,46 @@ class MidiLfo : public MidiWorker  {
  */
     void setFramePtr(int idx);
 
-    bool handleEvent(MidiEvent inEv, int64_t tick, int keep_rel = 0) override;
+    bool handleEvent(MidiEvent inEv, int64_t tick, int keep_rel = 0) final;
 
 /*! @brief  is the main calculator for the data contained
  * in a waveform.
  *
- * It is called upon every change of parameters in LfoWidget or upon
+ * It is called upon every change of parameters or upon
  * input by mouse clicks on the LfoScreen. It fills the
- * MidiLfo::data buffer with Sample points, which it either calculates
- * or which it copies from the MidiLfo::customWave data.
+ * MidiLfo::data buffer with points, which it either calculates
+ * or which it copies from the MidiLfo::customWave data. It does not
+ * allocate memory and can be called from the realtime thread.
+ */
+    void updateData();
+/*! @brief  calls MidiLfo::updateData() and expands the result to
+ * Sample points for display.
  *
- * @param *data reference to an array the waveform is copied to
+ * The returned array has an additional end tag point with data -1
+ * and the total tick length of the wave.
+ *
+ * @param *p_data reference to an array the waveform is copied to
  */
-    void getData(std::vector<Sample> *data);
+    void getData(std::vector<Sample> *p_data);
 /*! @brief fills the MidiLfo::frame with Sample data points taken from
  * the currently active waveform MidiLfo::data.
  *
+ * The wave, resolution and number of points are those last published
+ * by MidiLfo::updateData(), so that changes done by the GUI thread take
+ * effect at a step boundary and never while a frame is calculated.
+ *
  * MidiLfo::frame is then accessed by Engine::echoCallback() and sequenced
  * to the driver backend.
  *
  * @param tick current tick
  */
-    void getNextFrame(int64_t tick) override;
+    void getNextFrame(int64_t tick) final;
+    int frameChannel(int ix) final { (void)ix; return channelOut; }
 /*! @brief  toggles the mute state of one point of the
- * MidiLfo::muteMask array.
+ * MidiLfo::customWave mute mask.
  *
  * The function is called when the right mouse button is clicked on the
  * LfoScreen.
- * If calculated waveforms are active, only the MidiLfo::muteMask is
- * changed. If a custom waveform is active, the Sample.mute status
- * at the given position is changed as well.
  *
  * @param mouseX Normalized Horizontal location of the mouse on the
  * LfoScreen (0.0 ... 1.0)
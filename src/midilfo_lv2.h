@@ -27,6 +27,7 @@
 
 #include "midilfo.h"
 #include "lv2_common.h"
+#include "timebase.h"
 
 #define QMIDIARP_LFO_LV2_URI QMIDIARP_LV2_URI "/lfo"
 #define QMIDIARP_LFO_LV2_PREFIX QMIDIARP_LFO_LV2_URI "#"
@@ -98,7 +99,8 @@ private:
 
         float *val[35];
         uint64_t curFrame;
-        uint64_t tempoChangeTick;
+        TempoMap tempoMap;  /**< Maps curFrame to ticks */
+        MidiDecoder midiDecoder;  /**< Decodes the raw bytes of the MIDI input */
         uint64_t curTick;
         int inLfoFrame;
         double mouseXCur;
@@ -109,6 +111,10 @@ private:
         double sampleRate;
         double tempo;
         bool ui_up;
+        WaveStore uiWave;   /**< Wave as last sent to the UI */
+        int uiWaveSize;     /**< Number of points in uiWave, 0 forces a full resync */
+        bool wavePending;   /**< Wave changes not yet sent to the UI */
+        uint64_t waveSendFrame; /**< curFrame of the last wave update sent to the UI */
         bool transportAtomReceived;
         void updateParams();
         void forgeMidiEvent(uint32_t f, const uint8_t* const buffer, uint32_t size);
@@ -55,26 +55,22 @@ MidiSeq::MidiSeq()
     const int wavesize = 8192;
 
     customWave.resize(wavesize);
-    muteMask.resize(wavesize);
-    data.reserve(wavesize);
+    customWave.fill(60, false);
     outFrame.resize(2);
     
     Sample sample = {0, 0, 0, false};
     sample.data = 60;
     sample.value = 0;
-    
-    for (int l1 = 0; l1 < wavesize; l1++) {
-        sample.tick = l1 * TPQN / res;
-        sample.muted = false;
-        customWave[l1] = sample;
-        data[l1] = sample;
-        muteMask[l1] = false;
-    }
     outFrame[0] = sample;
     sample.data = -1;
     sample.tick = nextTick;
     outFrame[1] = sample;
 
+    WaveSnapshot layout;
+    layout.res = res;
+    layout.npoints = res * size;
+    layout.loopMarker = loopMarker;
+    waveBuffer.init(layout);
 }
 
 bool MidiSeq::handleEvent(MidiEvent inEv, int64_t tick, int keep_rel)
@@ -126,16 +122,24 @@ bool MidiSeq::handleEvent(MidiEvent inEv, int64_t tick, int keep_rel)
 
 void MidiSeq::getNextFrame(int64_t tick)
 {
-    const int frame_nticks = TPQN / res;
+    applyRandomReset();
+    // take over the layout last published by the GUI thread
+    waveBuffer.update();
+    const WaveSnapshot &layout = waveBuffer.readBuffer();
+
+    const int frame_nticks = TPQN / layout.res;
     Sample sample = {0, 0, 0, false};
     int cur_grv_sft;
 
     gotKbdTrig = false;
     if (restartFlag) setFramePtr(0);
+    /* the sequence may have been shortened since the last step */
+    if (framePtr >= layout.npoints) framePtr %= layout.npoints;
     if (!framePtr) grooveTick = newGrooveTick;
 
-    sample = customWave[framePtr];
-    advancePatternIndex();
+    sample.data = customWave.value(framePtr);
+    sample.muted = customWave.isMuted(framePtr);
+    advancePatternIndex(layout);
 
     if (nextTick < (tick - frame_nticks)) nextTick = tick;
 
@@ -169,19 +173,21 @@ void MidiSeq::getNextFrame(int64_t tick)
     sample.data = -1;
     sample.tick = nextTick;
     outFrame[1] = sample;
+    outFrameCount = 1;
 }
 
-void MidiSeq::advancePatternIndex()
+void MidiSeq::advancePatternIndex(const WaveSnapshot &layout)
 {
-    const int npoints = res * size;
+    const int npoints = layout.npoints;
+    const int loopMarker = layout.loopMarker;
     int pivot = abs(loopMarker);
     reflect = pingpong;
 
     if (curLoopMode == 6) {
         if (pivot)
-            framePtr = rand() % pivot;
+            framePtr = randomValue(pivot);
         else
-            framePtr = rand() % npoints;
+            framePtr = randomValue(npoints);
         return;
     }
 
@@ -248,15 +254,18 @@ void MidiSeq::getData(std::vector<Sample> * p_data)
     
     const int npoints = res * size;
 
-    data.resize(npoints);
+    p_data->resize(npoints + 1);
 
-    for (int l1 = 0; l1 < npoints; l1++) data[l1] = customWave[l1];
+    for (int l1 = 0; l1 < npoints; l1++) {
+        sample.data = customWave.value(l1);
+        sample.tick = l1 * TPQN / res;
+        sample.muted = customWave.isMuted(l1);
+        (*p_data)[l1] = sample;
+    }
     sample.data = -1;
     sample.tick = npoints * TPQN / res;
     sample.muted = false;
-    data.push_back(sample);
-    
-    *p_data = data;
+    (*p_data)[npoints] = sample;
 }
 
 void MidiSeq::updateResolution(int val)
@@ -375,6 +384,7 @@ void MidiSeq::setLoopMarker(int ix)
     if (abs(loopMarker) >= npoints) loopMarker = 0;
     if (!loopMarker) nPoints = npoints;
     else nPoints = abs(loopMarker);
+    publishLayout();
 }
 
 void MidiSeq::updateDispVert(int mode)
@@ -409,62 +419,51 @@ void MidiSeq::setRecordMode(int on)
 
 void MidiSeq::setRecordedNote(int note)
 {
-    Sample sample = {0, 0, 0, false};
-
-    sample = customWave[currentRecStep];
-    sample.data = note;
-    sample.tick = currentRecStep * TPQN / res;
-    customWave[currentRecStep] = sample;
+    customWave.setValue(currentRecStep, note);
 }
 
 void MidiSeq::resizeAll()
 {
     const int npoints = res * size;
-    Sample sample = {0, 0, 0, false};
 
-    framePtr%=npoints;
     currentRecStep%=npoints;
 
     if (maxNPoints < npoints) {
-        for (int l1 = 0; l1 < npoints; l1++) {
-            if (l1 >= maxNPoints)
-                muteMask[l1] = muteMask[l1 % maxNPoints];
-            sample = customWave[l1 % maxNPoints];
-            sample.tick = l1 * TPQN / res;
-            sample.muted = muteMask[l1];
-            customWave[l1] = sample;
-        }
+        customWave.repeat(maxNPoints, npoints);
         maxNPoints = npoints;
     }
 
     if (!loopMarker) nPoints = npoints;
     if (abs(loopMarker) >= npoints) loopMarker = 0;
+    publishLayout();
     dataChanged = true;
 }
 
+void MidiSeq::publishLayout()
+{
+    WaveSnapshot &layout = waveBuffer.writeBuffer();
+
+    layout.res = res;
+    layout.npoints = res * size;
+    layout.loopMarker = loopMarker;
+    waveBuffer.publish();
+}
+
 bool MidiSeq::toggleMutePoint(double mouseX)
 {
-    Sample sample = {0, 0, 0, false};
     bool m;
     int loc = mouseX * (res * size);
 
-    m = muteMask[loc];
-    muteMask[loc] = !m;
-    sample = customWave[loc];
-    sample.muted = !m;
-    customWave[loc] = sample;
+    m = customWave.isMuted(loc);
+    customWave.setMuted(loc, !m);
     return(!m);
 }
 
 int MidiSeq::setMutePoint(double mouseX, bool on)
 {
-    Sample sample = {0, 0, 0, false};
     int loc = mouseX * (res * size);
 
-    sample = customWave[loc];
-    sample.muted = on;
-    customWave[loc] = sample;
-    muteMask[loc] = on;
+    customWave.setMuted(loc, on);
     return (loc);
 }
 
@@ -26,6 +26,8 @@
 #define MIDISEQ_H
 
 #include "midiworker.h"
+#include "wavestore.h"
+#include "swapbuffer.h"
 #include <vector>
 
 /*! @brief MIDI worker class for the Seq Module. Implements a monophonic
@@ -35,14 +37,15 @@
  * The backend driver thread calls the Engine::echoCallback(), which will
  * query each module, in this case via
  * the MidiSeq::getNextFrame() method. MidiSeq will return a note from
- * its internal MidiSeq::data buffer as a function of the position of
- * the driver's transport. The MidiSeq::data buffer is populated by the
- * MidiSeq::getData() function at each modification done via
- * the SeqWidget. It is modified by drawing a sequence of notes on the
+ * its internal MidiSeq::customWave buffer as a function of the position of
+ * the driver's transport. The MidiSeq::customWave buffer is
+ * modified by drawing a sequence of notes on the
  * SeqWidget display or by recording incoming notes step by step. In all
  * cases the sequence has resolution, velocity, note length and
  * size attributes and single points can be tagged as muted, which will
  * avoid data output at the corresponding position.
+ * Resolution, size and loop marker are handed to the driver thread
+ * through the MidiSeq::waveBuffer.
  */
 class MidiSeq : public MidiWorker  {
 
@@ -54,8 +57,20 @@ class MidiSeq : public MidiWorker  {
  * function of the current value, play direction, loop marker position
  * and orientation. It is called by MidiSeq::getNextFrame() so that upon
  * every new output note, the sequence pointer advances.
+ *
+ * @param layout Sequence layout currently played by getNextFrame()
+ */
+    void advancePatternIndex(const WaveSnapshot &layout);
+/*! @brief  copies resolution, size and loop marker to the
+ * MidiSeq::waveBuffer, from which getNextFrame() takes them over at the
+ * next step.
+ *
+ * The notes in MidiSeq::customWave are played in place, since its
+ * storage is never reallocated. A point value is a single byte and the
+ * mute bits are changed with atomic operations on their word.
  */
-    void advancePatternIndex();
+    void publishLayout();
+    SwapBuffer<WaveSnapshot> waveBuffer; /*!< Layout as played by getNextFrame() */
 
   public:
     bool lastMute;              /**< Contains the mute state of the last waveForm point modified by mouse click*/
@@ -68,9 +83,7 @@ class MidiSeq : public MidiWorker  {
     int maxNPoints;        /*!< Maximum number of steps that have been used in the session */
     int nOctaves;
     int baseOctave;
-    std::vector<Sample> customWave;
-    std::vector<bool> muteMask;
-    std::vector<Sample> data;
+    WaveStore customWave;  /*!< Notes and mute states of the sequence */
 
   public:
     MidiSeq();
@@ -86,7 +99,7 @@ class MidiSeq : public MidiWorker  {
 
     void recordNote(int note);
 
-    bool handleEvent(MidiEvent inEv, int64_t tick, int keep_rel = 0) override;
+    bool handleEvent(MidiEvent inEv, int64_t tick, int keep_rel = 0) final;
 /*! @brief  sets the (controller) value of one point of the
  * MidiSeq::customWave array. It is used for handling drawing functionality.
  *
@@ -129,13 +142,10 @@ class MidiSeq : public MidiWorker  {
  */
     void setLoopMarkerMouse(double mouseX);
 /*! @brief  sets the mute state of one point of the
- * MidiSeq::muteMask array to the given state.
+ * MidiSeq::customWave to the given state.
  *
  * It is called when the right mouse button is clicked on the
  * SeqScreen via the mouseEvent() function.
- * If calculated waveforms are active, only the MidiSeq::muteMask is
- * changed. If a custom waveform is active, the Sample.mute status
- * at the given position is changed as well.
  *
  * @param mouseX Normalized horizontal location of the mouse on the
  * SeqScreen (0.0 ... 1.0)
@@ -161,29 +171,29 @@ class MidiSeq : public MidiWorker  {
 /*! @brief  is called upon every change of parameters in
  * SeqWidget or upon input by mouse clicks on the SeqScreen.
  *
- * It fills the
- * MidiSeq::data buffer with Sample points, which it copies from the
- * MidiSeq::customWave data.
+ * It expands the MidiSeq::customWave data to Sample points for display.
+ * The returned array has an additional end tag point with data -1
+ * and the total tick length of the sequence.
  *
- * @param data reference to an array the waveform is copied to
+ * @param p_data reference to an array the waveform is copied to
  */
     void getData(std::vector<Sample> * p_data);
 /*! @brief  transfers the next Sample to returnNote
  * 
  * Transfers one Sample of data taken from the currently active sequence 
- * MidiSeq::data at the index framePtr into the returnNote to be read
+ * MidiSeq::customWave at the index framePtr into the returnNote to be read
  * by engine. This is called by Engine at every step.
  *
  * @param tick the current tick at which we request a note. This tick will be
  * used to calculate the nextTick which is quantized to the pattern
  */
-    void getNextFrame(int64_t tick) override;
+    void getNextFrame(int64_t tick) final;
+    int frameChannel(int ix) final { (void)ix; return channelOut; }
 /*! @brief  toggles the mute state of one point of the
- * MidiSeq::muteMask array.
+ * MidiSeq::customWave.
  *
  * It is called when the right mouse button is clicked on the
- * SeqScreen. The Sample.mute status at the given position in
- * MidiSeq::customWave is changed as well.
+ * SeqScreen.
  *
  * @param mouseX Normalized Horizontal location of the mouse on the
  * SeqScreen (0.0 ... 1.0)
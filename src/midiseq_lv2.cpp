@@ -25,6 +25,7 @@
 #include <cstdio>
 #include <cmath>
 #include "midiseq_lv2.h"
+#include "rtcheck.h"
 
 MidiSeqLV2::MidiSeqLV2 (
     double sample_rate, const LV2_Feature *const *host_features )
@@ -36,7 +37,6 @@ MidiSeqLV2::MidiSeqLV2 (
     curFrame = 0;
     inEventBuffer = NULL;
     outEventBuffer = NULL;
-    getData(&data);
     mouseXCur = 0;
     mouseYCur = 0;
     mouseEvCur = 0;
@@ -54,7 +54,8 @@ MidiSeqLV2::MidiSeqLV2 (
     currentSample.value = 0;
     currentSample.muted = false;
     
-    tempoChangeTick = 0;
+    tempoMap.setRate(sampleRate);
+    tempoMap.reset(0, 0, tempo);
     hostTransport = true;
     transportSpeed = 0;
     transportAtomReceived = false;
@@ -70,6 +71,10 @@ MidiSeqLV2::MidiSeqLV2 (
     bufPtr = 0;
     dataChanged = true;
     ui_up = false;
+    uiWave.resize(customWave.size());
+    uiWaveSize = 0;
+    wavePending = false;
+    waveSendFrame = 0;
 
     LV2_URID_Map *urid_map;
 
@@ -143,24 +148,31 @@ void MidiSeqLV2::updatePosAtom(const LV2_Atom_Object* obj)
 
 void MidiSeqLV2::updatePos(uint64_t pos, float bpm, int speed, bool ignore_pos)
 {
+    /* While rolling on, a tempo change continues the tempo map at the
+     * current frame, so that the position follows host tempo ramps */
+    const bool rolling = transportSpeed && (transportSpeed == speed)
+                && (ignore_pos || (pos == curFrame));
+
     if (transportBpm != bpm) {
         /* Tempo changed */
         transportBpm = bpm;
         tempo = transportBpm;
-        transportSpeed = 0;
+        if (rolling) tempoMap.setTempo(curFrame, tempo);
     }
 
     if (!ignore_pos && (transportBpm > 0)) {
-        const float frames_per_beat = 60.0f / transportBpm * sampleRate;
         transportFramesDelta = pos;
-        tempoChangeTick = pos * TPQN / frames_per_beat;
+        if (!rolling) {
+            const float frames_per_beat = 60.0f / transportBpm * sampleRate;
+            tempoMap.reset(pos, pos * TPQN / frames_per_beat, tempo);
+        }
     }
     if (transportSpeed != speed) {
         /* Speed changed, e.g. 0 (stop) to 1 (play) */
         transportSpeed = speed;
         curFrame = transportFramesDelta;
         if (transportSpeed) {
-            setNextTick(tempoChangeTick);
+            setNextTick(tempoMap.frameToTick(curFrame));
         }
     }
     //printf("transportBpm %f, transportFramesDelta %d\n", transportBpm, transportFramesDelta);
@@ -168,6 +180,7 @@ void MidiSeqLV2::updatePos(uint64_t pos, float bpm, int speed, bool ignore_pos)
 
 void MidiSeqLV2::run (uint32_t nframes )
 {
+    RT_SCOPE("MidiSeqLV2::run");
     const QMidiArpURIs* uris = &m_uris;
     const uint32_t capacity = outEventBuffer->atom.size;
 
@@ -190,6 +203,7 @@ void MidiSeqLV2::run (uint32_t nframes )
                 else if (obj->body.otype == uris->ui_up) {
                     /* UI was activated */
                     ui_up = true;
+                    uiWaveSize = 0;
                     dataChanged = true;
                 }
                 else if (obj->body.otype == uris->ui_down) {
@@ -199,29 +213,23 @@ void MidiSeqLV2::run (uint32_t nframes )
             }
             // MIDI Input
             else if (event && event->body.type == uris->midi_MidiEvent) {
-                uint8_t *di = (uint8_t *) LV2_ATOM_BODY(&event->body);
+                const uint8_t *di = (const uint8_t *) LV2_ATOM_BODY(&event->body);
+                const uint8_t *msg;
+                uint32_t pos = 0;
+                uint32_t len, msg_len;
                 MidiEvent inEv = {0, 0, 0, 0};
-                if ( (di[0] & 0xf0) == 0x90 ) {
-                    inEv.type = EV_NOTEON;
-                    inEv.value = di[2];
-                }
-                else if ( (di[0] & 0xf0) == 0x80 ) {
-                    inEv.type = EV_NOTEON;
-                    inEv.value = 0;
+                while ((len = midiDecoder.decode(di + pos, event->body.size - pos,
+                            &inEv, &msg, &msg_len))) {
+                    pos += len;
+                    if (!msg_len) continue;
+                    if (inEv.type == EV_NOTEOFF) {
+                        inEv.type = EV_NOTEON;
+                        inEv.value = 0;
+                    }
+                    int64_t tick = tempoMap.frameToTick(curFrame + event->time.frames);
+                    if (handleEvent(inEv, tick - 2)) //if event is unmatched, forward it
+                        forgeMidiEvent(event->time.frames, msg, msg_len);
                 }
-                else if ( (di[0] & 0xf0) == 0xb0 ) {
-                    inEv.type = EV_CONTROLLER;
-                    inEv.value = di[2];
-                }
-                else inEv.type = EV_NONE;
-
-                inEv.channel = di[0] & 0x0f;
-                inEv.data=di[1];
-                int tick = ((uint64_t)(curFrame - transportFramesDelta) * nframes
-                            +(uint64_t)(&event->time.frames) % nframes)
-                            *TPQN*tempo/nframes/60/sampleRate + tempoChangeTick;
-                if (handleEvent(inEv, tick - 2)) //if event is unmatched, forward it
-                    forgeMidiEvent((int)((uint64_t)(&event->time.frames) % nframes), di, 3);
             }
         }
     }
@@ -229,8 +237,7 @@ void MidiSeqLV2::run (uint32_t nframes )
 
         // MIDI Output
     for (uint32_t f = 0 ; f < nframes; f++) {
-        curTick = (uint64_t)(curFrame - transportFramesDelta)
-                        *TPQN*tempo/60/sampleRate + tempoChangeTick;
+        curTick = tempoMap.frameToTick(curFrame);
         if ((curTick >= (uint64_t)nextTick) && (transportSpeed)) {
             getNextFrame(curTick);
             if (!outFrame[0].muted && !isMuted) {
@@ -376,7 +383,11 @@ void MidiSeqLV2::updateParams()
 
     if (internalTempo != *val[TEMPO]) {
         internalTempo = *val[TEMPO];
-        initTransport();
+        if (!hostTransport) {
+            transportBpm = internalTempo;
+            tempo = internalTempo;
+            tempoMap.setTempo(curFrame, tempo);
+        }
     }
 
     if (hostTransport != (bool)(*val[TRANSPORT_MODE])) {
@@ -394,162 +405,81 @@ void MidiSeqLV2::updateParams()
     if (changed) {
         dataChanged = true;
     }
-    if (dataChanged) {
-        getData(&data);
-    }
 }
 
 void MidiSeqLV2::initTransport()
 {
     if (!hostTransport) {
         transportFramesDelta = curFrame;
-        if (curTick > 0) tempoChangeTick = curTick;
         transportBpm = internalTempo;
         tempo = internalTempo;
+        tempoMap.reset(curFrame, tempoMap.frameToTick(curFrame), tempo);
         transportSpeed = 1;
     }
     else transportSpeed = 0;
 
-    setNextTick(tempoChangeTick);
+    const uint64_t tick = tempoMap.frameToTick(curFrame);
+    setNextTick(tick);
 }
 
 void MidiSeqLV2::sendWave()
 {
-    if (!(dataChanged && ui_up)) return;
-    dataChanged = false;
-
-    const QMidiArpURIs* uris = &m_uris;
-    int ct = res * size + 1; // last element in wave is an end tag
-    int tempArray[ct];
-
-    for (int l1 = 0; l1 < ct; l1++) {
-        tempArray[l1]=data[l1].data*((data[l1].muted) ? -1 : 1);
+    if (dataChanged) {
+        dataChanged = false;
+        wavePending = true;
     }
+    if (!(wavePending && ui_up)) return;
 
-    /* forge container object of type 'hex_customwave' */
-    LV2_Atom_Forge_Frame frame;
-    lv2_atom_forge_frame_time(&forge, 0);
-    lv2_atom_forge_object(&forge, &frame, 1, uris->hex_customwave);
+    /* Coalesce changes to the UI refresh rate, resyncs are sent at once */
+    if (uiWaveSize && (curFrame - waveSendFrame
+                < sampleRate / QMIDIARP_LV2_WAVE_RATE)) return;
 
-    /* Send customWave to UI */
-    lv2_atom_forge_property_head(&forge, uris->hex_customwave, 0);
-    lv2_atom_forge_vector(&forge, sizeof(int), uris->atom_Int,
-        ct, tempArray);
+    /* last element in a full wave is an end tag */
+    if (!forge_wave_update(&forge, &m_uris, customWave, res * size, -1,
+                uiWave, uiWaveSize)) return;
 
-    /* close-off frame */
-    lv2_atom_forge_pop(&forge, &frame);
+    wavePending = false;
+    waveSendFrame = curFrame;
 }
 
 static LV2_State_Status MidiSeqLV2_state_restore ( LV2_Handle instance,
     LV2_State_Retrieve_Function retrieve, LV2_State_Handle handle,
-    uint32_t flags, const LV2_Feature* const* )
+    uint32_t, const LV2_Feature* const* )
 {
     MidiSeqLV2 *pPlugin = static_cast<MidiSeqLV2 *> (instance);
 
     if (pPlugin == NULL) return LV2_STATE_ERR_UNKNOWN;
 
-    QMidiArpURIs* const uris = &pPlugin->m_uris;
-
-    uint32_t type = uris->atom_String;
-
-    if (type == 0) return LV2_STATE_ERR_BAD_TYPE;
+    uint32_t seed;
+    if (retrieve_random_seed(retrieve, handle, &pPlugin->m_uris, seed))
+        pPlugin->setRandomSeed(seed);
 
-    size_t size = 0;
-    uint32_t key = uris->hex_mutemask;
-    if (!key) return LV2_STATE_ERR_NO_PROPERTY;
+    int npoints = retrieve_wave_state(retrieve, handle, &pPlugin->m_uris,
+                    pPlugin->customWave);
 
-    const char *value1
-        = (const char *) (*retrieve)(handle, key, &size, &type, &flags);
-
-    if (size < 2) return LV2_STATE_ERR_UNKNOWN;
+    if (!npoints) return LV2_STATE_ERR_UNKNOWN;
 
     pPlugin->setFramePtr(0);
-    pPlugin->maxNPoints = (size - 1 ) / 2;
-
-    for (int l1 = 0; l1 <  pPlugin->maxNPoints; l1++) {
-        pPlugin->muteMask[l1] = (value1[2 * l1 + 1] == '1');
-    }
-
-    key = uris->hex_customwave;
-    if (!key) return LV2_STATE_ERR_NO_PROPERTY;
-
-    const char *value
-        = (const char *) (*retrieve)(handle, key, &size, &type, &flags);
-
-    if (size < 2) return LV2_STATE_ERR_UNKNOWN;
-
-    Sample sample = {0, 0, 0, false};
+    pPlugin->maxNPoints = npoints;
 
-    for (int l1 = 0; l1 <  pPlugin->maxNPoints; l1++) {
-        int hi = 0;
-        int lo = 0;
-        if (value[2*l1] <= '9' && value[2*l1] >= '0') hi = value[2*l1] - '0';
-        if (value[2*l1] <= 'f' && value[2*l1] >= 'a') hi = value[2*l1] - 'a' + 10;
-
-        if (value[2*l1 + 1] <= '9' && value[2*l1 + 1] >= '0') lo = value[2*l1 + 1] - '0';
-        if (value[2*l1 + 1] <= 'f' && value[2*l1 + 1] >= 'a') lo = value[2*l1 + 1] - 'a' + 10;
-
-        sample.data = hi * 16 + lo;
-        sample.tick = l1 * TPQN / pPlugin->res;
-        sample.muted = pPlugin->muteMask[l1];
-        pPlugin->customWave[l1] = sample;
-    }
-
-    pPlugin->getData(&pPlugin->data);
     pPlugin->dataChanged = true;
     return LV2_STATE_SUCCESS;
 }
 
 static LV2_State_Status MidiSeqLV2_state_save ( LV2_Handle instance,
     LV2_State_Store_Function store, LV2_State_Handle handle,
-    uint32_t flags, const LV2_Feature* const* )
+    uint32_t, const LV2_Feature* const* )
 {
     MidiSeqLV2 *pPlugin = static_cast<MidiSeqLV2 *> (instance);
-    
-    if (pPlugin == NULL) return LV2_STATE_ERR_UNKNOWN;
 
-    QMidiArpURIs* const uris = &pPlugin->m_uris;
-
-    uint32_t type = uris->atom_String;
-
-    if (type == 0) return LV2_STATE_ERR_BAD_TYPE;
-
-    flags |= (LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
-
-    const char hexmap[] = {'0', '1', '2', '3', '4', '5', '6', '7',
-                           '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
-    int l1;
-    char bt[pPlugin->maxNPoints * 2 + 1];
-    
-    for (l1 = 0; l1 < pPlugin->maxNPoints; l1++) {
-        bt[2*l1] = hexmap[(pPlugin->customWave[l1].data  & 0xF0) >> 4];
-        bt[2*l1 + 1] = hexmap[pPlugin->customWave[l1].data  & 0x0F];
-    }
-    bt[pPlugin->maxNPoints * 2] = '\0';
-    
-    const char *value = bt;
-    
-    size_t size = strlen(value) + 1;
-    
-    uint32_t key = uris->hex_customwave;
-    if (!key) return LV2_STATE_ERR_NO_PROPERTY;
-
-    store(handle, key, value, size, type, flags);
-
-    for (l1 = 0; l1 < pPlugin->maxNPoints; l1++) {
-        bt[2*l1] = '0';
-        bt[2*l1 + 1] = hexmap[pPlugin->muteMask[l1]];
-    }
-
-    const char *value1 = bt;
-
-    size = strlen(value1) + 1;
-    key = uris->hex_mutemask;
-    if (!key) return LV2_STATE_ERR_NO_PROPERTY;
+    if (pPlugin == NULL) return LV2_STATE_ERR_UNKNOWN;
 
-    LV2_State_Status result = (*store)(handle, key, value1, size, type, flags);
+    LV2_State_Status result = store_random_seed(store, handle,
+                    &pPlugin->m_uris, pPlugin->randomSeed);
+    if (result != LV2_STATE_SUCCESS) return result;
 
-    return result;
+    return store_wave_state(store, handle, &pPlugin->m_uris,
+                    pPlugin->customWave, pPlugin->maxNPoints);
 }
 
 static const LV2_State_Interface MidiSeqLV2_state_interface =
@@ -560,6 +490,7 @@ static const LV2_State_Interface MidiSeqLV2_state_interface =
 
 void MidiSeqLV2::activate (void)
 {
+    resetRandom();
     initTransport();
 }
 
@@ -27,6 +27,7 @@
 
 #include "midiseq.h"
 #include "lv2_common.h"
+#include "timebase.h"
 
 #define QMIDIARP_SEQ_LV2_URI QMIDIARP_LV2_URI "/seq"
 #define QMIDIARP_SEQ_LV2_PREFIX QMIDIARP_SEQ_LV2_URI "#"
@@ -94,7 +95,8 @@ private:
 
         float *val[35];
         uint64_t curFrame;
-        uint64_t tempoChangeTick;
+        TempoMap tempoMap;  /**< Maps curFrame to ticks */
+        MidiDecoder midiDecoder;  /**< Decodes the raw bytes of the MIDI input */
         uint64_t curTick;
         Sample currentSample;
         double mouseXCur;
@@ -108,6 +110,10 @@ private:
         double sampleRate;
         double tempo;
         bool ui_up;
+        WaveStore uiWave;   /**< Wave as last sent to the UI */
+        int uiWaveSize;     /**< Number of points in uiWave, 0 forces a full resync */
+        bool wavePending;   /**< Wave changes not yet sent to the UI */
+        uint64_t waveSendFrame; /**< curFrame of the last wave update sent to the UI */
         bool transportAtomReceived;
         void updateParams();
         void sendWave();
@@ -61,6 +61,7 @@ MidiWorker::MidiWorker()
     nextTick = 0;
 
     returnLength = 0;
+    outFrameCount = 0;
 
     grooveTick = 0;
     newGrooveTick = 0;
@@ -75,6 +76,10 @@ MidiWorker::MidiWorker()
     needsGUIUpdate = false;
     parChangesPending = false;
 
+    /* The libc generator is only used to give each new module its own seed */
+    randomSeed = rand();
+    randomResetFlag = false;
+    seedRandom();
 }
 
 void MidiWorker::setMuted(bool on)
@@ -88,6 +93,56 @@ void MidiWorker::setMuted(bool on)
     needsGUIUpdate = false;
 }
 
+void MidiWorker::setRandomSeed(uint32_t seed)
+{
+    randomSeed = seed;
+    resetRandom();
+}
+
+void MidiWorker::resetRandom()
+{
+    randomResetFlag = true;
+}
+
+void MidiWorker::seedRandom()
+{
+    /* fill the state using splitmix32, which never leaves it all zero */
+    uint32_t x = randomSeed;
+    for (int l1 = 0; l1 < 4; l1++) {
+        uint32_t z = (x += 0x9e3779b9);
+        z = (z ^ (z >> 16)) * 0x85ebca6b;
+        z = (z ^ (z >> 13)) * 0xc2b2ae35;
+        randomState[l1] = z ^ (z >> 16);
+    }
+}
+
+uint32_t MidiWorker::nextRandom()
+{
+    uint32_t *s = randomState;
+    const uint32_t m = s[1] * 5;
+    const uint32_t result = ((m << 7) | (m >> 25)) * 9;
+    const uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+
+    return result;
+}
+
+uint32_t MidiWorker::randomValue(uint32_t range)
+{
+    return ((uint64_t)nextRandom() * range) >> 32;
+}
+
+double MidiWorker::randomUnit()
+{
+    return (double)nextRandom() / 4294967295.0;
+}
+
 int MidiWorker::clip(int value, int min, int max, bool *outOfRange)
 {
     int tmp = value;
@@ -26,6 +26,7 @@
 #define MIDIWORKER_H
 
 #include "main.h"
+#include <atomic>
 #include <cstdlib>
 #include <cstdio>
 #include <cstdint>
@@ -80,7 +81,9 @@ class MidiWorker {
     bool needsGUIUpdate; /*!< Flag set to true when MidiWorker members changed and queried by ModuleWidget::updateDisplay() */
     int frameSize;                  /*!< Current size of a vector returned by MidiLfo::getNextFrame() */
     std::vector<Sample> outFrame;   /*!< Vector of Sample points holding the current frame for transfer */
+    int outFrameCount;              /*!< Number of events in MidiWorker::outFrame, which are followed by a data == -1 end mark */
     int returnLength; /*!< Holds the note length of the currently active step */
+    uint32_t randomSeed; /*!< Seed of the module's random generator, stored with the session */
 
   public:
     MidiWorker();
@@ -125,10 +128,29 @@ class MidiWorker {
     virtual int getFramePtr() { return framePtr; }
 /*! @brief  transfers the next Midi data Frame to an intermediate internal object
  * 
+ * The frame is MidiWorker::outFrame with MidiWorker::outFrameCount events.
  * @param tick the current tick at which we request a note. This tick will be
  * used to calculate the nextTick which is quantized to the pattern
  */
     virtual void getNextFrame(int64_t tick) = 0;
+/*! @brief  returns True when getNextFrame() is due at tick
+ *
+ * Frames of a module triggered by the keyboard are only rendered for
+ * echoes requested by the trigger, and the other frames only for the
+ * regular echoes.
+ * @param echo_from_trig True if the echo was requested by a trigger
+ * @param tick Current tick including the synchronization tolerance
+ */
+    bool frameDue(bool echo_from_trig, int64_t tick) const
+    {
+        return (gotKbdTrig == echo_from_trig) && (tick >= nextTick);
+    }
+/*! @brief  returns the MIDI output channel of an event in
+ * MidiWorker::outFrame. Only the Arp outputs on more than one channel.
+ *
+ * @param ix Index of the event in MidiWorker::outFrame
+ */
+    virtual int frameChannel(int ix) { (void)ix; return channelOut; }
 /**
  * @brief sets MidiSeq::nextTick and MidiSeq::framePtr position
  * according to the specified tick.
@@ -154,6 +176,51 @@ class MidiWorker {
  * clears MidiArp::latchBuffer. 
  */
     virtual void clearNoteBuffer() { };
+
+/*! @brief  sets MidiWorker::randomSeed and restarts the random sequence
+ * of this module from it at the next frame, see resetRandom().
+ *
+ * @param seed New seed value
+ */
+    void setRandomSeed(uint32_t seed);
+/*! @brief  restarts the random sequence of this module from
+ * MidiWorker::randomSeed, so that the same random values are produced
+ * after each transport start.
+ *
+ * Only a request is set here, the realtime thread reseeds the generator
+ * at the start of its next frame in applyRandomReset(), so that the
+ * state is never rewritten while a value is drawn.
+ */
+    void resetRandom();
+/*! @brief  reseeds the random generator if resetRandom() was called
+ * since the last frame. Called at the start of getNextFrame().
+ */
+    void applyRandomReset()
+    {
+        if (randomResetFlag.load(std::memory_order_relaxed)
+                && randomResetFlag.exchange(false)) seedRandom();
+    }
+/*! @brief  returns the next value of the module's own random generator.
+ *
+ * The generator is xoshiro128**, its state is private to the module, so
+ * that modules do not share state with each other or with other threads.
+ *
+ * @param range Number of possible values, must be greater than zero
+ * @return A pseudo-random value between 0 and range - 1
+ */
+    uint32_t randomValue(uint32_t range);
+/*! @brief  returns the next value of the module's own random generator
+ * as a floating point value.
+ *
+ * @return A pseudo-random value between 0.0 and 1.0
+ */
+    double randomUnit();
+
+  private:
+    uint32_t randomState[4];
+    std::atomic<bool> randomResetFlag; /*!< Causes applyRandomReset() to reseed */
+    void seedRandom();
+    uint32_t nextRandom();
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include "config.h"
 
 #ifdef APPBUILD
+#include <QTimer>
 
 #include "pixmaps/lfowavcp.xpm"
 #include "pixmaps/seqwavcp.xpm"
@@ -38,12 +39,65 @@ ModuleWidget::ModuleWidget(MidiWorker *p_midiWorker, GlobStore *p_globStore,
     name(p_name),
     globStore(p_globStore),
     prefs(p_prefs),
-    modified(false)
+    modified(false),
+    uiBuilt(false)
 {
-    bool compactStyle = p_prefs->compactStyle;
-    int portCount = p_prefs->portCount;
     midiControl = new MidiControl(this);
 
+    // the controls are built by ensureUi() when the dock is first shown
+    inOutBoxWidget = NULL;
+
+#else
+ModuleWidget::ModuleWidget(const QString& name):
+    midiWorker(NULL),
+    modified(false),
+    uiBuilt(true)
+{
+    bool inOutVisible = true;
+#endif
+
+    // Mute action that has to be added to each module widget outside the box
+    muteOutAction = new QAction(tr("&Mute"),this);
+    muteOutAction->setCheckable(true);
+    connect(muteOutAction, SIGNAL(toggled(bool)), this, 
+            SLOT(setMuted(bool)));
+    
+    // Defer action that has to be added to each module widget outside the box
+    deferChangesAction = new QAction("D", this);
+    deferChangesAction->setToolTip(tr("Defer mute to pattern end"));
+    deferChangesAction->setCheckable(true);
+    connect(deferChangesAction, SIGNAL(toggled(bool)), this, 
+            SLOT(updateDeferChanges(bool)));
+
+    // Hiding action that has to be added to each module widget outside the box
+    hideModuleWidgetAction = new QAction(tr("&Show/hide in-out settings"), this);
+    hideModuleWidgetAction->setCheckable(true);
+    hideModuleWidgetAction->setChecked(inOutVisible);
+
+#ifdef APPBUILD
+        parStore = new ParStore(globStore, name, muteOutAction
+                    , deferChangesAction, this);
+        connect(parStore, SIGNAL(store(int, bool)),
+                 this, SLOT(storeParams(int, bool)));
+        connect(parStore, SIGNAL(restore(int)),
+                 this, SLOT(restoreParams(int)));
+    if (p_prefs->compactStyle) parStore->setStyleSheet( COMPACT_STYLE );
+    midiControl->addMidiLearnMenu("Restore_"+name, parStore->topButton, PARAM_RESTORE);
+    muteOutAction->setChecked(p_prefs->mutedAdd);
+    modified = false;
+#else
+    buildInOutBox(name);
+#endif
+    needsGUIUpdate=false;
+    dataChanged = false;
+}
+
+void ModuleWidget::buildInOutBox(const QString& name)
+{
+#ifdef APPBUILD
+    bool compactStyle = prefs->compactStyle;
+    int portCount = prefs->portCount;
+
     QHBoxLayout *manageBoxLayout = new QHBoxLayout;
 
     QToolButton *cloneButton = new QToolButton;
@@ -77,12 +131,7 @@ ModuleWidget::ModuleWidget(MidiWorker *p_midiWorker, GlobStore *p_globStore,
     manageBoxLayout->addWidget(deleteButton);
 
 #else
-ModuleWidget::ModuleWidget(const QString& name):
-    midiWorker(NULL),
-    modified(false)
-{
     bool compactStyle = true;
-    bool inOutVisible = true;
 #endif
 
     // Input group box on left side
@@ -149,6 +198,7 @@ ModuleWidget::ModuleWidget(const QString& name):
     int l1;
     for (l1 = 0; l1 < 16; l1++) chIn->addItem(QString::number(l1 + 1));
     chIn->addItem("Omni");
+    if (name.startsWith("Arp")) chIn->addItem(tr("Per channel"));
     chIn->setCurrentIndex(OMNI);
     chInLabel->setBuddy(chIn);
 
@@ -255,47 +305,23 @@ ModuleWidget::ModuleWidget(const QString& name):
     }
     portBox->setLayout(portBoxLayout);
 
-    // Mute button that has to be added to each module widget outside the box
-    muteOutAction = new QAction(tr("&Mute"),this);
-    muteOutAction->setCheckable(true);
     muteOut = new QToolButton;
     muteOut->setDefaultAction(muteOutAction);
     muteOut->setMinimumSize(QSize(35,20));
-    connect(muteOutAction, SIGNAL(toggled(bool)), this, 
-            SLOT(setMuted(bool)));
-#ifdef APPBUILD
-    muteOutAction->setChecked(p_prefs->mutedAdd);
-#endif
-    
-    // Defer button that has to be added to each module widget outside the box
-    deferChangesAction = new QAction("D", this);
-    deferChangesAction->setToolTip(tr("Defer mute to pattern end"));
-    deferChangesAction->setCheckable(true);
+
     deferChangesButton = new QToolButton;
     deferChangesButton->setDefaultAction(deferChangesAction);
     deferChangesButton->setFixedSize(20, 20);
 
-    // Hiding button that has to be added to each module widget outside the box
-    hideModuleWidgetAction = new QAction(tr("&Show/hide in-out settings"), this);
     hideModuleWidgetButton = new QToolButton;
-    hideModuleWidgetAction->setCheckable(true);
-    hideModuleWidgetAction->setChecked(inOutVisible);
     hideModuleWidgetButton->setDefaultAction(hideModuleWidgetAction);
     hideModuleWidgetButton->setFixedSize(10, 80);
     hideModuleWidgetButton->setArrowType (Qt::ArrowType(0));
 
 #ifdef APPBUILD
-        parStore = new ParStore(globStore, name, muteOutAction
-                    , deferChangesAction, this);
-        connect(parStore, SIGNAL(store(int, bool)),
-                 this, SLOT(storeParams(int, bool)));
-        connect(parStore, SIGNAL(restore(int)),
-                 this, SLOT(restoreParams(int)));
-    if (compactStyle) parStore->setStyleSheet( COMPACT_STYLE );
     midiControl->addMidiLearnMenu("Note Low", indexIn[0], NOTE_LOW);
     midiControl->addMidiLearnMenu("Note Hi", indexIn[1], NOTE_HIGH);
     midiControl->addMidiLearnMenu("MuteToggle", muteOut, MUTE_BUTTON);
-    midiControl->addMidiLearnMenu("Restore_"+name, parStore->topButton, PARAM_RESTORE);
 #endif
     // Layout for left/right placements of in/out group boxes
     inOutBoxWidget = new QWidget;
@@ -307,7 +333,7 @@ ModuleWidget::ModuleWidget(const QString& name):
     inOutBoxLayout->addWidget(portBox);
     inOutBoxLayout->addStretch();
     inOutBoxWidget->setLayout(inOutBoxLayout);
-    inOutBoxWidget->setVisible(inOutVisible);
+    inOutBoxWidget->setVisible(hideModuleWidgetAction->isChecked());
     
     connect(ccnumberBox, SIGNAL(valueChanged(int)), this, 
             SLOT(updateCcnumber(int)));
@@ -337,16 +363,12 @@ ModuleWidget::ModuleWidget(const QString& name):
             SLOT(updateRangeIn(int)));
     connect(channelOut, SIGNAL(activated(int)), this,
             SLOT(updateChannelOut(int)));
-    connect(deferChangesAction, SIGNAL(toggled(bool)), this, 
-            SLOT(updateDeferChanges(bool)));
 #ifdef APPBUILD
     connect(portOut, SIGNAL(activated(int)), this, 
             SLOT(updatePortOut(int)));
 #endif
     connect(hideModuleWidgetAction, SIGNAL(toggled(bool)), inOutBoxWidget, 
                 SLOT(setVisible(bool)));
-    needsGUIUpdate=false;
-    dataChanged = false;
 }
 
 ModuleWidget::~ModuleWidget()
@@ -398,7 +420,12 @@ void ModuleWidget::checkIfInputFilterSet()
 
 void ModuleWidget::updateChIn(int value)
 {
-    if (midiWorker) midiWorker->chIn = value;
+    if (midiWorker) {
+        // notes held per channel do not carry over to a single buffer
+        if ((value == PERCHANNEL) != (midiWorker->chIn == PERCHANNEL))
+            midiWorker->clearNoteBuffer();
+        midiWorker->chIn = value;
+    }
     modified = true;
 }
 
@@ -489,8 +516,15 @@ void ModuleWidget::setMuted(bool on)
 {
     if (!midiWorker) return;
     midiWorker->setMuted(on);
-    needsGUIUpdate = true;
     modified = true;
+#ifdef APPBUILD
+    // without controls only the global store indicator shows the state
+    if (!uiBuilt) {
+        parStore->ndc->setMuted(on);
+        return;
+    }
+#endif
+    needsGUIUpdate = true;
 }
 
 void ModuleWidget::updateDeferChanges(bool on)
@@ -508,15 +542,16 @@ void ModuleWidget::updateNRep(int nrep)
 void ModuleWidget::storeParams(int ix, bool empty)
 {
 #ifdef APPBUILD
+    if (uiBuilt) controlsToData();
     parStore->temp.empty = empty;
-    parStore->temp.muteOut = muteOut->isChecked();
-    parStore->temp.chIn = chIn->currentIndex();
-    parStore->temp.channelOut = channelOut->currentIndex();
-    parStore->temp.portOut = portOut->currentIndex();
-    parStore->temp.indexIn0 = indexIn[0]->value();
-    parStore->temp.indexIn1 = indexIn[1]->value();
-    parStore->temp.rangeIn0 = rangeIn[0]->value();
-    parStore->temp.rangeIn1 = rangeIn[1]->value();
+    parStore->temp.muteOut = muteOutAction->isChecked();
+    parStore->temp.chIn = moduleData.chIn;
+    parStore->temp.channelOut = moduleData.channelOut;
+    parStore->temp.portOut = moduleData.portOut;
+    parStore->temp.indexIn0 = moduleData.indexIn[0];
+    parStore->temp.indexIn1 = moduleData.indexIn[1];
+    parStore->temp.rangeIn0 = moduleData.rangeIn[0];
+    parStore->temp.rangeIn1 = moduleData.rangeIn[1];
     doStoreParams(ix);
     
 #else
@@ -531,13 +566,27 @@ void ModuleWidget::restoreParams(int ix)
     doRestoreParams(ix);
     if (!parStore->onlyPatternList.at(ix)) {
         if (prefs->storeMuteState) muteOutAction->setChecked(parStore->list.at(ix).muteOut);
-        indexIn[0]->setValue(parStore->list.at(ix).indexIn0);
-        indexIn[1]->setValue(parStore->list.at(ix).indexIn1);
-        rangeIn[0]->setValue(parStore->list.at(ix).rangeIn0);
-        rangeIn[1]->setValue(parStore->list.at(ix).rangeIn1);
-        chIn->setCurrentIndex(parStore->list.at(ix).chIn);
+        if (uiBuilt) {
+            indexIn[0]->setValue(parStore->list.at(ix).indexIn0);
+            indexIn[1]->setValue(parStore->list.at(ix).indexIn1);
+            rangeIn[0]->setValue(parStore->list.at(ix).rangeIn0);
+            rangeIn[1]->setValue(parStore->list.at(ix).rangeIn1);
+            chIn->setCurrentIndex(parStore->list.at(ix).chIn);
+            channelOut->setCurrentIndex(parStore->list.at(ix).channelOut);
+        }
+        else {
+            moduleData.indexIn[0] = parStore->list.at(ix).indexIn0;
+            moduleData.indexIn[1] = parStore->list.at(ix).indexIn1;
+            moduleData.rangeIn[0] = parStore->list.at(ix).rangeIn0;
+            moduleData.rangeIn[1] = parStore->list.at(ix).rangeIn1;
+            moduleData.chIn = parStore->list.at(ix).chIn;
+            moduleData.channelOut = parStore->list.at(ix).channelOut;
+            for (int l1 = 0; l1 < 2; l1++) {
+                midiWorker->indexIn[l1] = moduleData.indexIn[l1];
+                midiWorker->rangeIn[l1] = moduleData.rangeIn[l1];
+            }
+        }
         updateChIn(parStore->list.at(ix).chIn);
-        channelOut->setCurrentIndex(parStore->list.at(ix).channelOut);
         updateChannelOut(parStore->list.at(ix).channelOut);
         setPortOut(parStore->list.at(ix).portOut);
         updatePortOut(parStore->list.at(ix).portOut);
@@ -551,9 +600,32 @@ void ModuleWidget::restoreParams(int ix)
 #ifdef APPBUILD
 void ModuleWidget::setPortOut(int value)
 {
-    portOut->setCurrentIndex(value);
+    moduleData.portOut = value;
+    if (uiBuilt) portOut->setCurrentIndex(value);
     modified = true;
 }
+
+void ModuleWidget::setPortCount(int count)
+{
+    if (!uiBuilt) {
+        // the port box is filled with prefs->portCount entries when built
+        if (moduleData.portOut >= count) {
+            moduleData.portOut = count - 1;
+            updatePortOut(moduleData.portOut);
+        }
+        return;
+    }
+
+    int port = portOut->currentIndex();
+
+    portOut->clear();
+    for (int l1 = 0; l1 < count; l1++) portOut->addItem(QString::number(l1 + 1));
+    if (port >= count) {
+        port = count - 1;
+        updatePortOut(port);
+    }
+    portOut->setCurrentIndex(port);
+}
 #endif
 
 void ModuleWidget::moduleDelete()
@@ -597,61 +669,103 @@ void ModuleWidget::moduleClone()
 #endif
 }
 
+void ModuleWidget::ensureUi()
+{
+#ifdef APPBUILD
+    if (uiBuilt) return;
+
+    MidiWorker *worker = midiWorker;
+    bool wasModified = modified;
+
+    // The worker already runs with moduleData, the control slots must
+    // not write to it while the controls are set up
+    midiWorker = NULL;
+    buildInOutBox(name);
+    setInOutControls();
+    buildUi();
+    midiWorker = worker;
+
+    modified = wasModified;
+    needsGUIUpdate = true;
+    uiBuilt = true;
+#endif
+}
+
+void ModuleWidget::dockVisibilityChanged(bool visible)
+{
+#ifdef APPBUILD
+    // tabified docks may report being visible while a session is
+    // loaded, so only build once the events are processed
+    if (visible && !uiBuilt) QTimer::singleShot(0, this, SLOT(ensureShownUi()));
+#else
+    (void)visible;
+#endif
+}
+
+void ModuleWidget::ensureShownUi()
+{
+    if (isVisible()) ensureUi();
+}
+
 #ifdef APPBUILD
 void ModuleWidget::writeCommonData(QXmlStreamWriter& xml)
 {
     xml.writeStartElement(name.left(3));
     xml.writeAttribute("name", name.mid(name.indexOf(':') + 1));
-    xml.writeAttribute("inOutVisible", QString::number(inOutBoxWidget->isVisible()));
+    xml.writeAttribute("inOutVisible", QString::number(
+        hideModuleWidgetAction->isChecked()));
 
         xml.writeStartElement("input");
             if (!name.startsWith('A')) {
             xml.writeTextElement("enableNoteOff", QString::number(
-                enableNoteOff->isChecked()));
+                moduleData.enableNoteOff));
             }
             if (name.startsWith('S')) {
             xml.writeTextElement("enableNote", QString::number(
-                enableNoteIn->isChecked()));
+                moduleData.enableNoteIn));
             xml.writeTextElement("enableVelocity", QString::number(
-                enableVelIn->isChecked()));
+                moduleData.enableVelIn));
             }
             xml.writeTextElement("restartByKbd", QString::number(
-                enableRestartByKbd->isChecked()));
+                moduleData.restartByKbd));
             xml.writeTextElement("trigByKbd", QString::number(
-                enableTrigByKbd->isChecked()));
+                moduleData.trigByKbd));
             xml.writeTextElement("trigLegato", QString::number(
-                enableTrigLegato->isChecked()));
+                moduleData.trigLegato));
             xml.writeTextElement("channel", QString::number(
-                chIn->currentIndex()));
+                moduleData.chIn));
             xml.writeTextElement("indexMin", QString::number(
-                indexIn[0]->value()));
+                moduleData.indexIn[0]));
             xml.writeTextElement("indexMax", QString::number(
-                indexIn[1]->value()));
+                moduleData.indexIn[1]));
             xml.writeTextElement("rangeMin", QString::number(
-                rangeIn[0]->value()));
+                moduleData.rangeIn[0]));
             xml.writeTextElement("rangeMax", QString::number(
-                rangeIn[1]->value()));
+                moduleData.rangeIn[1]));
             if (name.startsWith('L')) {
             xml.writeTextElement("ccnumber", QString::number(
-                ccnumberInBox->value()));
+                moduleData.ccnumberIn));
             }
         xml.writeEndElement();
 
         xml.writeStartElement("output");
             xml.writeTextElement("muted", QString::number(
-                muteOut->isChecked()));
+                muteOutAction->isChecked()));
             xml.writeTextElement("defer", QString::number(
-                deferChangesButton->isChecked()));
+                deferChangesAction->isChecked()));
             xml.writeTextElement("port", QString::number(
-                portOut->currentIndex()));
+                moduleData.portOut));
             xml.writeTextElement("channel", QString::number(
-                channelOut->currentIndex()));
+                moduleData.channelOut));
             if (name.startsWith('L')) {
             xml.writeTextElement("ccnumber", QString::number(
-                ccnumberBox->value()));
+                moduleData.ccnumber));
             }
         xml.writeEndElement();
-        
+
+        xml.writeTextElement("randomSeed", QString::number(
+            midiWorker->randomSeed));
+
         midiControl->writeData(xml);
 
         parStore->writeData(xml);
@@ -659,14 +773,15 @@ void ModuleWidget::writeCommonData(QXmlStreamWriter& xml)
 
 void ModuleWidget::readCommonData(QXmlStreamReader& xml)
 {
-    int tmp = 0;
-    
     if (xml.isStartElement() && (xml.name() == "midiControllers")) {
         midiControl->readData(xml);
     }
     else if (xml.isStartElement() && (xml.name() == "globalStores")) {
         parStore->readData(xml);
     }
+    else if (xml.isStartElement() && (xml.name() == "randomSeed")) {
+        midiWorker->setRandomSeed(xml.readElementText().toUInt());
+    }
 
     else if (xml.isStartElement() && (xml.name() == "input")) {
         while (!xml.atEnd()) {
@@ -675,31 +790,29 @@ void ModuleWidget::readCommonData(QXmlStreamReader& xml)
                 break;
                 
             if (xml.name() == "enableNote")
-                enableNoteIn->setChecked(xml.readElementText().toInt());
+                moduleData.enableNoteIn = xml.readElementText().toInt();
             else if (xml.name() == "enableNoteOff")
-                enableNoteOff->setChecked(xml.readElementText().toInt());
+                moduleData.enableNoteOff = xml.readElementText().toInt();
             else if (xml.name() == "enableVelocity")
-                enableVelIn->setChecked(xml.readElementText().toInt());
+                moduleData.enableVelIn = xml.readElementText().toInt();
             else if (xml.name() == "restartByKbd")
-                enableRestartByKbd->setChecked(xml.readElementText().toInt());
+                moduleData.restartByKbd = xml.readElementText().toInt();
             else if (xml.name() == "trigByKbd")
-                enableTrigByKbd->setChecked(xml.readElementText().toInt());
+                moduleData.trigByKbd = xml.readElementText().toInt();
             else if (xml.name() == "trigLegato")
-                enableTrigLegato->setChecked(xml.readElementText().toInt());
-            else if (xml.name() == "channel") {
-                tmp = xml.readElementText().toInt();
-                chIn->setCurrentIndex(tmp);
-            }
+                moduleData.trigLegato = xml.readElementText().toInt();
+            else if (xml.name() == "channel")
+                moduleData.chIn = xml.readElementText().toInt();
             else if (xml.name() == "indexMin")
-                indexIn[0]->setValue(xml.readElementText().toInt());
+                moduleData.indexIn[0] = xml.readElementText().toInt();
             else if (xml.name() == "indexMax")
-                indexIn[1]->setValue(xml.readElementText().toInt());
+                moduleData.indexIn[1] = xml.readElementText().toInt();
             else if (xml.name() == "rangeMin")
-                rangeIn[0]->setValue(xml.readElementText().toInt());
+                moduleData.rangeIn[0] = xml.readElementText().toInt();
             else if (xml.name() == "rangeMax")
-                rangeIn[1]->setValue(xml.readElementText().toInt());
+                moduleData.rangeIn[1] = xml.readElementText().toInt();
             else if (xml.name() == "ccnumber")
-                ccnumberInBox->setValue(xml.readElementText().toInt());
+                moduleData.ccnumberIn = xml.readElementText().toInt();
             else skipXmlElement(xml);
         }
     }
@@ -712,21 +825,92 @@ void ModuleWidget::readCommonData(QXmlStreamReader& xml)
                 muteOutAction->setChecked(xml.readElementText().toInt());
             else if (xml.name() == "defer")
                 deferChangesAction->setChecked(xml.readElementText().toInt());
-            else if (xml.name() == "channel") {
-                tmp = xml.readElementText().toInt();
-                channelOut->setCurrentIndex(tmp);
-            }
-            else if (xml.name() == "port") {
-                tmp = xml.readElementText().toInt();
-                portOut->setCurrentIndex(tmp);
-            }
+            else if (xml.name() == "channel")
+                moduleData.channelOut = xml.readElementText().toInt();
+            else if (xml.name() == "port")
+                moduleData.portOut = xml.readElementText().toInt();
             else if (xml.name() == "ccnumber")
-                ccnumberBox->setValue(xml.readElementText().toInt());
+                moduleData.ccnumber = xml.readElementText().toInt();
             else skipXmlElement(xml);
         }
     }
 }
 
+void ModuleWidget::applyData()
+{
+    if (name.startsWith('S')) {
+        midiWorker->enableNoteIn = moduleData.enableNoteIn;
+        midiWorker->enableVelIn = moduleData.enableVelIn;
+    }
+    if (!name.startsWith('A')) {
+        midiWorker->enableNoteOff = moduleData.enableNoteOff;
+    }
+    if (name.startsWith('L')) {
+        midiWorker->ccnumberIn = moduleData.ccnumberIn;
+        midiWorker->ccnumber = moduleData.ccnumber;
+    }
+    midiWorker->restartByKbd = moduleData.restartByKbd;
+    midiWorker->trigByKbd = moduleData.trigByKbd;
+    midiWorker->trigLegato = moduleData.trigLegato;
+    for (int l1 = 0; l1 < 2; l1++) {
+        midiWorker->indexIn[l1] = moduleData.indexIn[l1];
+        midiWorker->rangeIn[l1] = moduleData.rangeIn[l1];
+    }
+    updateChIn(moduleData.chIn);
+    updateChannelOut(moduleData.channelOut);
+    updatePortOut(moduleData.portOut);
+}
+
+void ModuleWidget::controlsToData()
+{
+    moduleData.enableNoteIn = enableNoteIn->isChecked();
+    moduleData.enableVelIn = enableVelIn->isChecked();
+    moduleData.enableNoteOff = enableNoteOff->isChecked();
+    moduleData.restartByKbd = enableRestartByKbd->isChecked();
+    moduleData.trigByKbd = enableTrigByKbd->isChecked();
+    moduleData.trigLegato = enableTrigLegato->isChecked();
+    moduleData.chIn = chIn->currentIndex();
+    for (int l1 = 0; l1 < 2; l1++) {
+        moduleData.indexIn[l1] = indexIn[l1]->value();
+        moduleData.rangeIn[l1] = rangeIn[l1]->value();
+    }
+    moduleData.ccnumberIn = ccnumberInBox->value();
+    moduleData.channelOut = channelOut->currentIndex();
+    moduleData.portOut = portOut->currentIndex();
+    moduleData.ccnumber = ccnumberBox->value();
+}
+
+void ModuleWidget::updateUnbuiltDisplay()
+{
+    midiControl->update();
+    if (midiWorker->needsGUIUpdate) {
+        muteOutAction->setChecked(midiWorker->isMuted);
+        parStore->ndc->setMuted(midiWorker->isMuted);
+        midiWorker->needsGUIUpdate = false;
+    }
+    if (needsGUIUpdate) ensureUi();
+}
+
+void ModuleWidget::setInOutControls()
+{
+    enableNoteIn->setChecked(moduleData.enableNoteIn);
+    enableVelIn->setChecked(moduleData.enableVelIn);
+    enableNoteOff->setChecked(moduleData.enableNoteOff);
+    enableRestartByKbd->setChecked(moduleData.restartByKbd);
+    enableTrigByKbd->setChecked(moduleData.trigByKbd);
+    enableTrigLegato->setChecked(moduleData.trigLegato);
+    chIn->setCurrentIndex(moduleData.chIn);
+    for (int l1 = 0; l1 < 2; l1++) {
+        indexIn[l1]->setValue(moduleData.indexIn[l1]);
+        rangeIn[l1]->setValue(moduleData.rangeIn[l1]);
+    }
+    ccnumberInBox->setValue(moduleData.ccnumberIn);
+    channelOut->setCurrentIndex(moduleData.channelOut);
+    portOut->setCurrentIndex(moduleData.portOut);
+    ccnumberBox->setValue(moduleData.ccnumber);
+    checkIfInputFilterSet();
+}
+
 void ModuleWidget::skipXmlElement(QXmlStreamReader& xml)
 {
     if (xml.isStartElement()) {
@@ -794,22 +978,6 @@ void ModuleWidget::checkIfRestore(int64_t *restoreTick, bool *restoreFlag)
     }
 }
 
-bool ModuleWidget::prepareNextFrame(bool echo_from_trig, int syncTol,
-                int64_t tick, int64_t *restoreTick, bool *restoreFlag)
-{
-    if ((echo_from_trig && midiWorker->gotKbdTrig)
-            || (!midiWorker->gotKbdTrig && !echo_from_trig)) {
-        if ((tick + syncTol) >= midiWorker->nextTick) {
-            updateCursorPos();
-            updateIndicators();
-            midiWorker->getNextFrame(tick);
-            checkIfRestore(restoreTick, restoreFlag);
-            return true;
-        }
-    }
-    return false;
-}
-
 void ModuleWidget::setID(int id)
 {
     ID = id;
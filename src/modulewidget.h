@@ -37,6 +37,7 @@
 #include <QLabel>
 #include <QCheckBox>
 
+#include <atomic>
 
 #ifdef APPBUILD
 #include <QInputDialog>
@@ -52,6 +53,12 @@
  * inherit from this class. It provides the input
  * output settings and widget and handlers and some other small functions
  * and member variables
+ *
+ * In the application, a module is created with its MidiWorker, its
+ * MidiControl, its ParStore and the mute, defer and in-out panel actions
+ * only. The widget controls are built by ensureUi() when the dock of the
+ * module is shown for the first time. Until then the module settings
+ * are kept in ModuleWidget::moduleData.
 */
 class ModuleWidget: public QWidget
 {
@@ -76,6 +83,63 @@ class ModuleWidget: public QWidget
     ModuleWidget(MidiWorker *p_midiWorker, GlobStore *p_globStore, 
             Prefs *p_prefs, bool inOutVisible, const QString& name);
     QAction *deleteAction, *renameAction, *cloneAction;
+
+/*! @brief Plain settings of a module whose controls are not built yet
+ *
+ * readData(), writeData(), storeParams() and restoreParams() work on
+ * this structure and pass its values to the MidiWorker as long as
+ * ModuleWidget::uiBuilt is false. ensureUi() sets the controls from it,
+ * later on it is refreshed from the controls by controlsToData(). The
+ * mute and defer states are held by their actions, the wave data by
+ * the MidiWorker.
+ */
+    struct ModuleData {
+        /* In-Out */
+        bool enableNoteIn = true;
+        bool enableVelIn = true;
+        bool enableNoteOff = false;
+        bool restartByKbd = false;
+        bool trigByKbd = false;
+        bool trigLegato = false;
+        int chIn = OMNI;
+        int indexIn[2] = {0, 127};
+        int rangeIn[2] = {0, 127};
+        int ccnumberIn = 74;
+        int channelOut = 0;
+        int portOut = 0;
+        int ccnumber = 74;
+        /* Arp Modules */
+        QString pattern = ">0";
+        int repeatMode = 3;
+        int octaveMode = 3;
+        int octaveLow = 0;      /**< Index of ArpWidget::octaveLowBox */
+        int octaveHigh = 1;
+        bool latchMode = false;
+        int rndTick = 0;
+        int rndVel = 0;
+        int rndLen = 0;
+        int attack = 0;
+        int release = 0;
+        /* LFO and Seq Modules, combo box indices */
+        int loopMode = 0;
+        int res = 3;
+        int size = 3;
+        /* LFO Modules */
+        int waveForm = 0;
+        int freq = 3;
+        int ampl = 64;
+        int offs = 0;
+        int phase = 0;
+        int thinning = 0;
+        int thinInterval = 0;
+        /* Seq Modules */
+        int dispVertIndex = 0;
+        int vel = 64;
+        int notelen = 60;       /**< Slider value, see SeqWidget::sliderToTickLen() */
+        int transp = 0;
+        int loopMarker = 0;
+    };
+    ModuleData moduleData;
     int ID;             /**< @brief Corresponds to the Engine::midi*List index of the associated MidiSeq */
     Prefs *prefs;
     ParStore *parStore;
@@ -87,6 +151,7 @@ class ModuleWidget: public QWidget
     bool modified;      /**< @brief Is set to True if unsaved parameter modifications exist */
     bool dataChanged;
     bool needsGUIUpdate;
+    std::atomic<bool> uiBuilt;  /**< @brief True once the widget controls exist, also read by the driver thread */
     QLabel *rangeInLabel, *indexInLabel;
     QGroupBox *inputFilterBox;
     QComboBox *chIn;                        // Channel of input events
@@ -114,7 +179,19 @@ class ModuleWidget: public QWidget
     virtual void setModified(bool);
     virtual void checkIfInputFilterSet();
     virtual int getFramePtr() { return midiWorker->getFramePtr(); }
-    virtual int getNextTick() { return midiWorker->nextTick; }
+    virtual int64_t getNextTick() { return midiWorker->nextTick; }
+
+/*!
+ * @brief Creates the input and output group boxes in
+ * ModuleWidget::inOutBoxWidget and the buttons of the module actions
+ * @param name The name of the module preceded by its type
+ */
+    void buildInOutBox(const QString& name);
+/*!
+ * @brief Creates the module specific controls and the widget layout,
+ * reimplemented by each module widget
+ */
+    virtual void buildUi() = 0;
 
 /*!
  * @brief ENUM for Internal MIDI Control IDs supported 
@@ -149,6 +226,14 @@ class ModuleWidget: public QWidget
 */
     virtual void setPortOut(int value);
 /*!
+* @brief Rebuilds the ModuleWidget::portOut spinbox for a changed number
+* of output ports. The module is moved to the last port if its port
+* was removed.
+* @param count Number of available output ports
+*
+*/
+    void setPortCount(int count);
+/*!
 * @brief stores some module parameters in a parameter
 * list object
 *
@@ -196,8 +281,6 @@ class ModuleWidget: public QWidget
     virtual void updateIndicators();
     virtual void updateCursorPos() = 0;
     virtual void checkIfRestore(int64_t *restoreTick, bool *restoreFlag);
-    virtual bool prepareNextFrame(bool echo_from_trig, int syncTol,
-                int64_t tick, int64_t *restoreTick, bool *restoreFlag);
 /*!
 * @brief reads all parameters of this LFO from an XML stream
 * passed by the caller, i.e. MainWindow.
@@ -223,10 +306,52 @@ class ModuleWidget: public QWidget
 * @param xml reference to QXmlStreamReader containing the open XML stream
 */
     virtual void skipXmlElement(QXmlStreamReader& xml);
+/*!
+* @brief Passes ModuleWidget::moduleData to the MidiWorker of a module
+* that was just created or read from file without its controls.
+*
+* The base class handles the in-out settings, each module widget
+* reimplements it for its own parameters.
+*/
+    virtual void applyData();
+/*!
+* @brief Copies the current control values to ModuleWidget::moduleData
+*
+* Called before writing or storing the parameters of a module whose
+* controls are built.
+*/
+    virtual void controlsToData();
+/*!
+* @brief Sets the in-out controls from ModuleWidget::moduleData
+*/
+    void setInOutControls();
+/*!
+* @brief Part of updateDisplay() for a module whose controls are not built
+*
+* Follows mute changes of the MidiWorker and builds the controls once
+* handleController() changed a parameter, since the new value is only
+* taken over from the MidiWorker by the controls.
+*/
+    void updateUnbuiltDisplay();
 #endif
     
   public slots:
 /*!
+* @brief Builds the widget controls of this module unless done already
+*
+* Sets them from ModuleWidget::moduleData and leaves the
+* ModuleWidget::needsGUIUpdate flag set so that the next updateDisplay()
+* takes over the state of the MidiWorker.
+*/
+    void ensureUi();
+/*!
+* @brief Slot for QDockWidget::visibilityChanged of the module dock,
+* builds the controls once the dock is visible.
+*
+* The build is queued so that it does not happen within a session load.
+*/
+    void dockVisibilityChanged(bool visible);
+/*!
 * @brief Slot for ModuleWidget::deleteAction.
 *
 * This function displays a warning and then emits the
@@ -328,6 +453,9 @@ class ModuleWidget: public QWidget
 
     virtual bool getReverse() { return midiWorker->reverse; }
 
+  private slots:
+    void ensureShownUi();
+
   signals:
 
 /*! @brief Emitted to MainWindow::removeSeq for module deletion.
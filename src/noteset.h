@@ -0,0 +1,187 @@
+/*!
+ * @file noteset.h
+ * @brief Defines the NoteSet class holding the input notes of MidiArp
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#ifndef NOTESET_H
+#define NOTESET_H
+
+#include <cstdint>
+
+/*! @brief Set of the held and released input notes of MidiArp
+ *
+ * The note data is stored by pitch, so that adding, releasing and
+ * removing a note does not move other notes. A 128 bit presence mask
+ * gives the notes in ascending pitch order, the n-th note is found by
+ * clearing the lowest bits of two words. The order in which the notes
+ * were played is kept in a byte list for the "as played" chord mode.
+ *
+ * Each pitch is held once. Repeated note ons of a held pitch are
+ * counted, the pitch is released with the last of their note offs.
+ * A note on of a pitch in release stage takes it back to held.
+ *
+ * Pitches have to be in the range 0 ... 127, others are ignored.
+ */
+class NoteSet {
+
+  private:
+    uint64_t mask[2];       /*!< Presence bit of each pitch */
+    uint8_t played[128];    /*!< Present pitches in the order they were played */
+    int nNotes;             /*!< Number of present pitches */
+    int nReleased;          /*!< Number of present pitches in release stage */
+    int presses[128];       /*!< Note ons not followed by a note off yet */
+    int vel[128];           /*!< Velocity of the last note on */
+    int64_t ticks[128];     /*!< Tick of the note on, of the note off once released */
+    bool released[128];     /*!< The pitch is in release stage */
+
+    static int select(uint64_t word, int n)
+    {
+        for (int l1 = 0; l1 < n; l1++) word &= word - 1;
+        return __builtin_ctzll(word);
+    }
+
+    void erase(int note)
+    {
+        int l1 = 0;
+
+        mask[note >> 6] &= ~((uint64_t)1 << (note & 63));
+        if (released[note]) nReleased--;
+        released[note] = false;
+        presses[note] = 0;
+        while ((l1 < nNotes) && (played[l1] != note)) l1++;
+        nNotes--;
+        for (; l1 < nNotes; l1++) played[l1] = played[l1 + 1];
+    }
+
+  public:
+    NoteSet() : nNotes(0)
+    {
+        for (int l1 = 0; l1 < 128; l1++) {
+            presses[l1] = 0;
+            vel[l1] = 0;
+            ticks[l1] = 0;
+            released[l1] = false;
+        }
+        clear();
+    }
+
+    /*! @brief Removes all notes */
+    void clear()
+    {
+        for (int l1 = 0; l1 < nNotes; l1++) {
+            presses[played[l1]] = 0;
+            released[played[l1]] = false;
+        }
+        mask[0] = 0;
+        mask[1] = 0;
+        nNotes = 0;
+        nReleased = 0;
+    }
+
+    int count() const { return nNotes; }
+    int releasedCount() const { return nReleased; }
+
+    bool contains(int note) const
+    {
+        if ((note < 0) || (note > 127)) return false;
+        return (mask[note >> 6] >> (note & 63)) & 1;
+    }
+
+    /*! @brief Returns the pitch at index
+     * @param index Position of the note, 0 ... count() - 1
+     * @param as_played Count in the order the notes were played instead
+     * of in ascending pitch order */
+    int noteAt(int index, bool as_played) const
+    {
+        int low;
+
+        if (as_played) return played[index];
+        low = __builtin_popcountll(mask[0]);
+        if (index < low) return select(mask[0], index);
+        return 64 + select(mask[1], index - low);
+    }
+
+    int velocity(int note) const { return vel[note]; }
+    int64_t tick(int note) const { return ticks[note]; }
+    bool isReleased(int note) const { return released[note]; }
+
+    /*! @brief Adds a note on, or counts it for a pitch already present */
+    void add(int note, int velocity, int64_t tick)
+    {
+        if ((note < 0) || (note > 127)) return;
+        if (!contains(note)) {
+            mask[note >> 6] |= (uint64_t)1 << (note & 63);
+            played[nNotes++] = note;
+            presses[note] = 0;
+            ticks[note] = tick;
+        }
+        else if (released[note]) {
+            released[note] = false;
+            nReleased--;
+            ticks[note] = tick;
+        }
+        presses[note]++;
+        vel[note] = velocity;
+    }
+
+    /*! @brief Counts a note off and tags the pitch as released at tick
+     * when it was the last one */
+    void release(int note, int64_t tick)
+    {
+        if (!contains(note) || released[note]) return;
+        if (--presses[note] > 0) return;
+        released[note] = true;
+        ticks[note] = tick;
+        nReleased++;
+    }
+
+    /*! @brief Counts a note off and removes the pitch when it was the
+     * last one, a pitch in release stage is removed right away */
+    void remove(int note)
+    {
+        if (!contains(note)) return;
+        if (!released[note] && (--presses[note] > 0)) return;
+        erase(note);
+    }
+
+    /*! @brief Removes the pitch if it is in release stage */
+    void removeReleased(int note)
+    {
+        if (contains(note) && released[note]) erase(note);
+    }
+
+    /*! @brief Removes all pitches in release stage */
+    void purgeReleased()
+    {
+        for (int l1 = nNotes - 1; l1 >= 0; l1--) {
+            if (released[played[l1]]) erase(played[l1]);
+        }
+    }
+
+    /*! @brief Adds delta to the ticks of all notes */
+    void shiftTicks(int64_t delta)
+    {
+        for (int l1 = 0; l1 < nNotes; l1++) ticks[played[l1]] += delta;
+    }
+};
+
+#endif
@@ -43,6 +43,8 @@ ParStore::ParStore(GlobStore *p_globStore, const QString &name,
     temp.chIn = 0;
     temp.wave.clear();
     temp.muteMask.clear();
+    temp.waveHash = 0;
+    temp.muteMaskHash = 0;
     /* LFO Modules */
     temp.ccnumber = -1;
     temp.ccnumberIn = -1;
@@ -237,28 +239,29 @@ void ParStore::writeData(QXmlStreamWriter& xml)
             xml.writeTextElement("nRep", QString::number(nRepList.at(ix)));
             xml.writeTextElement("onlyPattern", QString::number((int)onlyPatternList.at(ix)));
 
-            tempArray.clear();
-            int l1 = 0;
-            while (l1 < list.at(ix).muteMask.count()) {
-                tempArray.append(list.at(ix).muteMask.at(l1));
-                l1++;
-            }
-            xml.writeStartElement("muteMask");
-                xml.writeTextElement("data", tempArray.toHex());
-            xml.writeEndElement();
-
-            tempArray.clear();
-            l1 = 0;
-            while (l1 < list.at(ix).wave.count()) {
-                if (list.at(ix).ccnumber >= 0)
-                    tempArray.append(list.at(ix).wave.at(l1).value);
-                else
-                    tempArray.append(list.at(ix).wave.at(l1).data);
-                l1++;
+            // Wave and mute mask are omitted when identical to those of
+            // the previous location. The reader keeps the previous ones
+            // in ParStore::temp in that case, which also works with
+            // readers not knowing about this.
+            bool sameAsPrev = (ix > 0)
+                && (list.at(ix).res == list.at(ix - 1).res)
+                && ((list.at(ix).ccnumber >= 0) == (list.at(ix - 1).ccnumber >= 0))
+                && (list.at(ix).muteMask == list.at(ix - 1).muteMask)
+                && (list.at(ix).wave == list.at(ix - 1).wave);
+
+            if (!sameAsPrev) {
+                tempArray.clear();
+                for (int l1 = 0; l1 < list.at(ix).muteMask.count(); l1++) {
+                    tempArray.append(list.at(ix).muteMask.testBit(l1));
+                }
+                xml.writeStartElement("muteMask");
+                    xml.writeTextElement("data", tempArray.toHex());
+                xml.writeEndElement();
+
+                xml.writeStartElement("wave");
+                    xml.writeTextElement("data", list.at(ix).wave.toHex());
+                xml.writeEndElement();
             }
-            xml.writeStartElement("wave");
-                xml.writeTextElement("data", tempArray.toHex());
-            xml.writeEndElement();
         xml.writeEndElement();
     }
     xml.writeEndElement();
@@ -267,7 +270,6 @@ void ParStore::writeData(QXmlStreamWriter& xml)
 void ParStore::readData(QXmlStreamReader& xml)
 {
     int ix = 0;
-    int step = 0;
     int tmpjumpto = -2;
     int tmpnrep = 1;
     int tmponlypattern = 0;
@@ -356,11 +358,11 @@ void ParStore::readData(QXmlStreamReader& xml)
                         if (xml.isEndElement())
                             break;
                         if (xml.isStartElement() && (xml.name() == "data")) {
-                            temp.muteMask.clear();
                             QByteArray tmpArray =
                                     QByteArray::fromHex(xml.readElementText().toLatin1());
+                            temp.muteMask.fill(false, tmpArray.count());
                             for (int l1 = 0; l1 < tmpArray.count(); l1++) {
-                                temp.muteMask.append(tmpArray.at(l1));
+                                temp.muteMask.setBit(l1, tmpArray.at(l1));
                             }
                         }
                         else skipXmlElement(xml);
@@ -372,29 +374,7 @@ void ParStore::readData(QXmlStreamReader& xml)
                         if (xml.isEndElement())
                             break;
                         if (xml.isStartElement() && (xml.name() == "data")) {
-                            temp.wave.clear();
-                            QByteArray tmpArray =
-                                    QByteArray::fromHex(xml.readElementText().toLatin1());
-
-                            if (temp.ccnumber >= 0)
-                                step = TPQN / lfoResValues[temp.res];
-                            else
-                                step = TPQN / seqResValues[temp.res];
-
-                            int lt = 0;
-                            Sample sample = {0, 0, 0, false};
-                            for (int l1 = 0; l1 < tmpArray.count(); l1++) {
-                                if (temp.ccnumber >= 0) {
-                                    sample.value = tmpArray.at(l1);
-                                } 
-                                else {
-                                    sample.data = tmpArray.at(l1);
-                                }
-                                sample.tick = lt;
-                                sample.muted = temp.muteMask.at(l1);
-                                temp.wave.append(sample);
-                                lt+=step;
-                            }
+                            temp.wave = QByteArray::fromHex(xml.readElementText().toLatin1());
                         }
                         else skipXmlElement(xml);
                     }
@@ -534,8 +514,52 @@ void ParStore::updateRunOnce(int location, int choice)
     }
 }
 
+void ParStore::waveToTemp(const WaveStore &wave, int npoints)
+{
+    temp.wave = QByteArray((const char *)wave.constData(), npoints);
+    temp.muteMask.fill(false, npoints);
+    for (int l1 = 0; l1 < npoints; l1++) {
+        temp.muteMask.setBit(l1, wave.isMuted(l1));
+    }
+}
+
+void ParStore::listToWave(int ix, WaveStore &wave)
+{
+    const TempStore &store = list.at(ix);
+
+    for (int l1 = 0; l1 < store.wave.count(); l1++) {
+        wave.setValue(l1, store.wave.at(l1));
+        wave.setMuted(l1, (l1 < store.muteMask.count())
+                        && store.muteMask.testBit(l1));
+    }
+}
+
+void ParStore::shareWaveData(TempStore &store)
+{
+    store.waveHash = qHash(store.wave);
+    store.muteMaskHash = qHash(store.muteMask);
+
+    bool waveShared = false;
+    bool maskShared = false;
+    for (int l1 = 0; l1 < list.count(); l1++) {
+        const TempStore &other = list.at(l1);
+        if (!waveShared && (other.waveHash == store.waveHash)
+                && (other.wave == store.wave)) {
+            store.wave = other.wave;
+            waveShared = true;
+        }
+        if (!maskShared && (other.muteMaskHash == store.muteMaskHash)
+                && (other.muteMask == store.muteMask)) {
+            store.muteMask = other.muteMask;
+            maskShared = true;
+        }
+        if (waveShared && maskShared) break;
+    }
+}
+
 void ParStore::tempToList(int ix)
 {
+    shareWaveData(temp);
     if (ix >= list.size()) {
         list.append(temp);
         addLocation();
@@ -24,12 +24,14 @@
 #ifndef PARSTORE_H
 #define PARSTORE_H
 
+#include <QBitArray>
 #include <QMenu>
 #include <QToolButton>
 
 #include "globstore.h"
 #include "midievent.h"
 #include "storagebutton.h"
+#include "wavestore.h"
 
 
 /*!
@@ -94,8 +96,14 @@ class ParStore : public QWidget
         int portOut;
         int channelOut;
         int chIn;
-        QVector<Sample> wave;
-        QVector<bool> muteMask;
+        /*! Custom wave points, one byte per point holding the LFO value
+         * (ccnumber >= 0) or the Seq note. This is the same compact form
+         * as in the session file, implicitly shared between locations
+         * with identical content, see ParStore::shareWaveData() */
+        QByteArray wave;
+        QBitArray muteMask;     /**< One bit per wave point, set if muted */
+        uint waveHash;          /**< qHash() of ParStore::TempStore::wave */
+        uint muteMaskHash;      /**< qHash() of ParStore::TempStore::muteMask */
         /* LFO Modules */
         int ccnumber;
         int ccnumberIn;
@@ -155,6 +163,33 @@ class ParStore : public QWidget
 */
     void tempToList(int ix);
 /*!
+* @brief copies the first npoints of a module's custom wave and mute mask
+* to ParStore::temp
+*
+* @param wave Custom wave of the MidiWorker
+* @param npoints Number of points to store
+*/
+    void waveToTemp(const WaveStore &wave, int npoints);
+/*!
+* @brief copies the wave and mute mask stored at location ix
+* into a module's custom wave
+*
+* @param ix Location index to read from
+* @param wave Custom wave of the MidiWorker to write to
+*/
+    void listToWave(int ix, WaveStore &wave);
+/*!
+* @brief lets the wave and mute mask of the passed TempStore share the
+* data of an existing location with identical content
+*
+* Locations mostly differ in a few parameters only, so identical waves
+* are kept once and only copied when one of them is modified
+* (copy-on-write of the Qt containers).
+*
+* @param store TempStore about to be put into ParStore::list
+*/
+    void shareWaveData(TempStore &store);
+/*!
 * @brief reads the ParStore::list from an XML stream
 * passed by the caller, i.e. MainWindow.
 *
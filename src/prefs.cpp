@@ -35,4 +35,11 @@ Prefs::Prefs()
     midiControllable = true;
     outputMidiClock = false;
     portMidiClock = 0;
+    limitBandwidth = false;
+    rtPolicy.priority = 0;
+    rtPolicy.cpu = -1;
+    rtPolicy.guiCpu = -1;
+    rtPolicy.lockMemory = false;
+    rcRtPolicy = rtPolicy;
+    portOffset.fill(0, portCount);
 }
@@ -28,6 +28,10 @@
 #include <cstdlib>
 #include <cstdio>
 
+#include <QVector>
+
+#include "rtpolicy.h"
+
 
 class Prefs {
 
@@ -42,5 +46,10 @@ class Prefs {
     bool midiControllable;
     bool outputMidiClock;
     int portMidiClock;
+    bool limitBandwidth;
+    RtPolicy rtPolicy;      /*!< Realtime settings in effect */
+    RtPolicy rcRtPolicy;    /*!< Realtime settings of the resource file, which
+                                the command line does not overwrite */
+    QVector<int> portOffset;
 };
 #endif
@@ -24,6 +24,7 @@
 #include <QBoxLayout>
 #include <QDialogButtonBox>
 #include <QLabel>
+#include <QSpinBox>
 
 #include "prefswidget.h"
 
@@ -34,6 +35,22 @@ PrefsWidget::PrefsWidget(Engine *p_engine, Prefs *p_prefs, QWidget *parent)
     prefs = p_prefs;
     engine = p_engine;
 
+    QLabel *portCountLabel = new QLabel(tr("&Output ports"), this);
+    portCountSpin = new QSpinBox(this);
+    portCountSpin->setRange(1, 256);
+    portCountSpin->setValue(p_prefs->portCount);
+    portCountSpin->setToolTip(tr("Number of MIDI output ports, "
+            "can be changed while running with JACK"));
+    portCountLabel->setBuddy(portCountSpin);
+    QObject::connect(portCountSpin, SIGNAL(valueChanged(int)), this,
+            SLOT(updatePortCount(int)));
+    if (engine->alsaMidi) portCountSpin->setEnabled(false);
+
+    QHBoxLayout *portCountLayout = new QHBoxLayout;
+    portCountLayout->addWidget(portCountLabel);
+    portCountLayout->addStretch(1);
+    portCountLayout->addWidget(portCountSpin);
+
     forwardCheck = new QCheckBox(this);
     forwardCheck->setText(tr("&Forward unmatched events to port"));
     forwardCheck->setChecked(false);
@@ -92,6 +109,104 @@ PrefsWidget::PrefsWidget(Engine *p_engine, Prefs *p_prefs, QWidget *parent)
     portMidiClockLayout->addWidget(portMidiClockSpin);
     if (!(engine->alsaMidi)) portMidiClockSpin->setEnabled(false);
 
+    bandwidthCheck = new QCheckBox(this);
+    bandwidthCheck->setText(tr("&Limit output ports to DIN MIDI bandwidth"));
+    bandwidthCheck->setToolTip(tr("Notes are always sent, controllers "
+            "exceeding the bandwidth of a port are merged or dropped"));
+    bandwidthCheck->setChecked(false);
+    QObject::connect(bandwidthCheck, SIGNAL(toggled(bool)), this,
+            SLOT(updateBandwidth(bool)));
+
+    overloadLabel = new QLabel(this);
+    overloadLabel->setToolTip(tr("Events dropped or merged per output port "
+            "because of the bandwidth limit"));
+    overloadTimer = new QTimer(this);
+    QObject::connect(overloadTimer, SIGNAL(timeout()), this,
+            SLOT(updateOverloads()));
+
+    QHBoxLayout *bandwidthLayout = new QHBoxLayout;
+    bandwidthLayout->addWidget(bandwidthCheck);
+    bandwidthLayout->addStretch(1);
+    bandwidthLayout->addWidget(overloadLabel);
+
+    QLabel *portOffsetLabel = new QLabel(tr("&Latency offset of port"), this);
+
+    portOffsetPortBox = new QComboBox(this);
+    for (l1 = 0; l1 < p_prefs->portCount; l1++) portOffsetPortBox->addItem(QString::number(l1 + 1));
+    QObject::connect(portOffsetPortBox, SIGNAL(activated(int)), this,
+            SLOT(updatePortOffsetPort(int)));
+
+    portOffsetSpin = new QSpinBox(this);
+    portOffsetSpin->setRange(-500, 500);
+    portOffsetSpin->setSuffix(tr(" ms"));
+    portOffsetSpin->setToolTip(tr("Events to this port are sent earlier by "
+            "this time in addition to the latency reported by JACK"));
+    portOffsetLabel->setBuddy(portOffsetSpin);
+    QObject::connect(portOffsetSpin, SIGNAL(valueChanged(int)), this,
+            SLOT(updatePortOffset(int)));
+    if (engine->alsaMidi) {
+        portOffsetPortBox->setEnabled(false);
+        portOffsetSpin->setEnabled(false);
+    }
+
+    QHBoxLayout *portOffsetLayout = new QHBoxLayout;
+    portOffsetLayout->addWidget(portOffsetLabel);
+    portOffsetLayout->addWidget(portOffsetPortBox);
+    portOffsetLayout->addStretch(1);
+    portOffsetLayout->addWidget(portOffsetSpin);
+
+    int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    QLabel *rtPriorityLabel = new QLabel(tr("Realtime thread &priority"), this);
+    rtPrioritySpin = new QSpinBox(this);
+    rtPrioritySpin->setRange(0, 99);
+    rtPrioritySpin->setSpecialValueText(tr("Default"));
+    rtPrioritySpin->setValue(p_prefs->rtPolicy.priority);
+    rtPrioritySpin->setToolTip(tr("SCHED_FIFO priority of the ALSA "
+            "thread, the JACK server sets that of the JACK thread"));
+    rtPriorityLabel->setBuddy(rtPrioritySpin);
+    if (!engine->alsaMidi) rtPrioritySpin->setEnabled(false);
+
+    QLabel *rtCpuLabel = new QLabel(tr("Realtime thread &CPU"), this);
+    rtCpuSpin = new QSpinBox(this);
+    rtCpuSpin->setRange(-1, ncpu - 1);
+    rtCpuSpin->setSpecialValueText(tr("Any"));
+    rtCpuSpin->setValue(p_prefs->rtPolicy.cpu);
+    rtCpuLabel->setBuddy(rtCpuSpin);
+
+    QLabel *guiCpuLabel = new QLabel(tr("&GUI thread CPU"), this);
+    guiCpuSpin = new QSpinBox(this);
+    guiCpuSpin->setRange(-1, ncpu - 1);
+    guiCpuSpin->setSpecialValueText(tr("Any"));
+    guiCpuSpin->setValue(p_prefs->rtPolicy.guiCpu);
+    guiCpuLabel->setBuddy(guiCpuSpin);
+
+    lockMemoryCheck = new QCheckBox(this);
+    lockMemoryCheck->setText(tr("Lock &memory"));
+    lockMemoryCheck->setToolTip(tr("Keep all memory of QMidiArp in RAM, "
+            "so that the realtime thread does not wait for paging"));
+    lockMemoryCheck->setChecked(p_prefs->rtPolicy.lockMemory);
+
+    QObject::connect(rtPrioritySpin, SIGNAL(valueChanged(int)), this,
+            SLOT(updateRtPolicy()));
+    QObject::connect(rtCpuSpin, SIGNAL(valueChanged(int)), this,
+            SLOT(updateRtPolicy()));
+    QObject::connect(guiCpuSpin, SIGNAL(valueChanged(int)), this,
+            SLOT(updateRtPolicy()));
+    QObject::connect(lockMemoryCheck, SIGNAL(toggled(bool)), this,
+            SLOT(updateRtPolicy()));
+
+    QGridLayout *rtBoxLayout = new QGridLayout;
+    rtBoxLayout->addWidget(rtPriorityLabel, 0, 0);
+    rtBoxLayout->addWidget(rtPrioritySpin, 0, 1);
+    rtBoxLayout->addWidget(rtCpuLabel, 1, 0);
+    rtBoxLayout->addWidget(rtCpuSpin, 1, 1);
+    rtBoxLayout->addWidget(guiCpuLabel, 2, 0);
+    rtBoxLayout->addWidget(guiCpuSpin, 2, 1);
+    rtBoxLayout->addWidget(lockMemoryCheck, 3, 0, 1, 2);
+    QGroupBox *rtBox = new QGroupBox(tr("Realtime"), this);
+    rtBox->setLayout(rtBoxLayout);
+
     QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
 
     connect(buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
@@ -100,8 +215,11 @@ PrefsWidget::PrefsWidget(Engine *p_engine, Prefs *p_prefs, QWidget *parent)
     QVBoxLayout *prefsWidgetLayout = new QVBoxLayout;
 
     QVBoxLayout *midiBoxLayout = new QVBoxLayout(this);
+    midiBoxLayout->addLayout(portCountLayout);
     midiBoxLayout->addLayout(portBoxLayout);
     midiBoxLayout->addLayout(portMidiClockLayout);
+    midiBoxLayout->addLayout(portOffsetLayout);
+    midiBoxLayout->addLayout(bandwidthLayout);
     midiBoxLayout->addWidget(cbuttonCheck);
     QGroupBox *midiBox = new QGroupBox(tr("Midi"), this);
     midiBox->setLayout(midiBoxLayout);
@@ -120,6 +238,7 @@ PrefsWidget::PrefsWidget(Engine *p_engine, Prefs *p_prefs, QWidget *parent)
     prefsWidgetLayout->addWidget(midiBox);
     prefsWidgetLayout->addWidget(dispBox);
     prefsWidgetLayout->addWidget(modBox);
+    prefsWidgetLayout->addWidget(rtBox);
     prefsWidgetLayout->addWidget(buttonBox);
     prefsWidgetLayout->addStretch();
 
@@ -209,3 +328,131 @@ void PrefsWidget::setPortMidiClock(int id)
     updatePortMidiClock(id);
 }
 
+void PrefsWidget::updatePortOffsetPort(int port)
+{
+    portOffsetSpin->blockSignals(true);
+    portOffsetSpin->setValue(prefs->portOffset[port]);
+    portOffsetSpin->blockSignals(false);
+}
+
+void PrefsWidget::updatePortOffset(int ms)
+{
+    int port = portOffsetPortBox->currentIndex();
+    engine->driver->setPortOffset(port, ms);
+    prefs->portOffset[port] = ms;
+    modified = true;
+}
+
+void PrefsWidget::updateBandwidth(bool on)
+{
+    engine->driver->setPortBandwidth(on ? DIN_MIDI_RATE : 0);
+    prefs->limitBandwidth = on;
+    modified = true;
+}
+
+void PrefsWidget::updateOverloads()
+{
+    QString text;
+    uint32_t count;
+
+    for (int l1 = 0; l1 < prefs->portCount; l1++) {
+        count = engine->driver->getPortOverloads(l1);
+        if (!count) continue;
+        if (!text.isEmpty()) text += "  ";
+        text += tr("%1: %2").arg(l1 + 1).arg(count);
+    }
+    if (text.isEmpty()) text = tr("none");
+    overloadLabel->setText(tr("Overloads ") + text);
+}
+
+void PrefsWidget::showEvent(QShowEvent *event)
+{
+    updateOverloads();
+    overloadTimer->start(1000);
+    QDialog::showEvent(event);
+}
+
+void PrefsWidget::hideEvent(QHideEvent *event)
+{
+    overloadTimer->stop();
+    QDialog::hideEvent(event);
+}
+
+void PrefsWidget::updateRtPolicy()
+{
+    prefs->rtPolicy.priority = rtPrioritySpin->value();
+    prefs->rtPolicy.cpu = rtCpuSpin->value();
+    prefs->rtPolicy.guiCpu = guiCpuSpin->value();
+    prefs->rtPolicy.lockMemory = lockMemoryCheck->isChecked();
+    // settings chosen here are kept in the resource file
+    prefs->rcRtPolicy = prefs->rtPolicy;
+    engine->setRtPolicy(prefs->rtPolicy);
+}
+
+void PrefsWidget::setRtPolicy(const RtPolicy &policy)
+{
+    rtPrioritySpin->blockSignals(true);
+    rtCpuSpin->blockSignals(true);
+    guiCpuSpin->blockSignals(true);
+    lockMemoryCheck->blockSignals(true);
+
+    rtPrioritySpin->setValue(policy.priority);
+    rtCpuSpin->setValue(policy.cpu);
+    guiCpuSpin->setValue(policy.guiCpu);
+    lockMemoryCheck->setChecked(policy.lockMemory);
+
+    rtPrioritySpin->blockSignals(false);
+    rtCpuSpin->blockSignals(false);
+    guiCpuSpin->blockSignals(false);
+    lockMemoryCheck->blockSignals(false);
+
+    updateRtPolicy();
+}
+
+void PrefsWidget::updatePortCount(int count)
+{
+    prefs->portCount = engine->setPortCount(count);
+    prefs->portOffset.resize(prefs->portCount);
+    fillPortBoxes();
+    for (int l1 = 0; l1 < prefs->portCount; l1++)
+        engine->driver->setPortOffset(l1, prefs->portOffset.at(l1));
+    if (prefs->portCount != count) {
+        portCountSpin->blockSignals(true);
+        portCountSpin->setValue(prefs->portCount);
+        portCountSpin->blockSignals(false);
+    }
+    modified = true;
+}
+
+void PrefsWidget::setPortCount(int count)
+{
+    portCountSpin->setValue(count);
+}
+
+void PrefsWidget::fillPortBoxes()
+{
+    QComboBox *boxes[3] = {
+        portUnmatchedSpin, portMidiClockSpin, portOffsetPortBox };
+    int port;
+
+    for (int l1 = 0; l1 < 3; l1++) {
+        port = boxes[l1]->currentIndex();
+        boxes[l1]->clear();
+        for (int l2 = 0; l2 < prefs->portCount; l2++)
+            boxes[l1]->addItem(QString::number(l2 + 1));
+        if (port >= prefs->portCount) port = prefs->portCount - 1;
+        boxes[l1]->setCurrentIndex(port);
+    }
+    if (prefs->portUnmatched >= prefs->portCount)
+        updatePortUnmatched(portUnmatchedSpin->currentIndex());
+    updatePortOffsetPort(portOffsetPortBox->currentIndex());
+}
+
+void PrefsWidget::setPortOffset(int port, int ms)
+{
+    if ((port < 0) || (port >= prefs->portCount)) return;
+    prefs->portOffset[port] = ms;
+    engine->driver->setPortOffset(port, ms);
+    if (port == portOffsetPortBox->currentIndex())
+        updatePortOffsetPort(port);
+}
@@ -25,6 +25,8 @@
 #define PREFSWIDGET_H
 
 #include <QDialog>
+#include <QLabel>
+#include <QTimer>
 
 #include "engine.h"
 
@@ -44,6 +46,12 @@ class PrefsWidget : public QDialog
     Engine *engine;
     Prefs *prefs;
     bool modified;
+    QTimer *overloadTimer;
+    void fillPortBoxes();
+
+  protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
 
   public:
     PrefsWidget(Engine* engine, Prefs* prefs, QWidget* parent=0);
@@ -52,11 +60,24 @@ class PrefsWidget : public QDialog
     void setPortUnmatched(int id);
     void setOutputMidiClock(bool on);
     void setPortMidiClock(int id);
+    void setPortOffset(int port, int ms);
+    void setPortCount(int count);
     QCheckBox *cbuttonCheck, *compactStyleCheck, *mutedAddCheck;
     QCheckBox *forwardCheck, *storeMuteStateCheck, *outputMidiClockCheck;
-    QComboBox *portUnmatchedSpin, *portMidiClockSpin;
+    QCheckBox *bandwidthCheck, *lockMemoryCheck;
+    QLabel *overloadLabel;
+    QComboBox *portUnmatchedSpin, *portMidiClockSpin, *portOffsetPortBox;
+    QSpinBox *portOffsetSpin, *portCountSpin;
+    QSpinBox *rtPrioritySpin, *rtCpuSpin, *guiCpuSpin;
     bool isModified() { return modified;};
     void setModified(bool on) { modified = on; };
+/*!
+* @brief sets the realtime setting widgets without emitting their
+* signals and applies the resulting policy once
+*
+* @param policy Settings to show and apply, see RtPolicy
+*/
+    void setRtPolicy(const RtPolicy &policy);
 
   signals:
     void compactLayoutToggle(bool);
@@ -70,6 +91,17 @@ class PrefsWidget : public QDialog
     void updateStoreMuteState(bool);
     void updateOutputMidiClock(bool on);
     void updatePortMidiClock(int);
+    void updatePortOffsetPort(int);
+    void updatePortOffset(int);
+    void updatePortCount(int);
+    void updateBandwidth(bool on);
+/*!
+* @brief shows the number of events each output port dropped or
+* merged because of the bandwidth limit, polled every second while
+* the dialog is shown
+*/
+    void updateOverloads();
+    void updateRtPolicy();
 };
 
 #endif
@@ -0,0 +1,384 @@
+/*!
+ * @file rtcheck.cpp
+ * @brief Preload library reporting calls that are not realtime safe
+ * within the scopes marked by RT_SCOPE
+ *
+ * Built as qmidiarp_rtcheck.so with --enable-rtcheck. It is loaded
+ * with LD_PRELOAD into qmidiarp or into any LV2 host running the
+ * plugins of such a build, for example
+ *
+ *      LD_PRELOAD=/usr/lib/qmidiarp/qmidiarp_rtcheck.so qmidiarp -j
+ *
+ * The library interposes malloc(), calloc(), realloc(), free(),
+ * posix_memalign(), pthread_mutex_lock(), usleep(), nanosleep(),
+ * open(), fopen(), the printf() family including the fortified
+ * variants, puts(), fputs() and fwrite().
+ * Qt5 locks QMutex and QReadWriteLock with atomics and futex() and not
+ * through pthread_mutex_lock(), so QMutex::lock(), QMutex::tryLock()
+ * with a timeout, QReadWriteLock::lockForRead() and lockForWrite() are
+ * interposed as well, together with syscall() for SYS_futex. The
+ * latter catches the contended waits of locks whose fast path is
+ * inlined into the caller, as with QBasicMutex, but not their
+ * uncontended locking, which never leaves user space.
+ * When one of them is called by a thread within an RtScope, the call
+ * is written to stderr with the scope name and a backtrace. Each call
+ * site is reported once. Other calls are passed on unchanged.
+ *
+ * The QMIDIARP_RTCHECK environment variable takes a comma separated
+ * list of
+ *      all     report every call instead of once per call site
+ *      abort   abort the process at the first report, for scripted runs
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Frames of a reported backtrace */
+#define RTCHECK_FRAMES      32
+/* Call sites remembered as reported, later ones are always reported */
+#define RTCHECK_SITES       1024
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *ptr);
+}
+
+static __thread const char *rtScope = NULL;    /* Outermost scope of the thread */
+static __thread int rtDepth = 0;                /* Nesting depth of the scopes */
+static __thread bool rtReporting = false;       /* A report is being written */
+
+static bool reportAll = false;
+static bool abortOnReport = false;
+static std::atomic<uintptr_t> reportedSites[RTCHECK_SITES];
+static std::atomic<unsigned int> reportCount(0);
+
+static int (*realMutexLock)(pthread_mutex_t *) = NULL;
+static int (*realUsleep)(useconds_t) = NULL;
+static int (*realNanosleep)(const struct timespec *, struct timespec *) = NULL;
+static int (*realOpen)(const char *, int, ...) = NULL;
+static FILE *(*realFopen)(const char *, const char *) = NULL;
+static int (*realVfprintf)(FILE *, const char *, va_list) = NULL;
+static int (*realPuts)(const char *) = NULL;
+static int (*realFputs)(const char *, FILE *) = NULL;
+static size_t (*realFwrite)(const void *, size_t, size_t, FILE *) = NULL;
+static long (*realSyscall)(long, long, long, long, long, long, long) = NULL;
+static void (*realQMutexLock)(void *) = NULL;
+static bool (*realQMutexTryLock)(void *, int) = NULL;
+static void (*realQRwLockForRead)(void *) = NULL;
+static void (*realQRwLockForWrite)(void *) = NULL;
+
+/* Looks the interposed function up on first use, also before rtCheckInit() */
+template <class F> static F real(F *fn, const char *name)
+{
+    if (!*fn) *fn = (F)dlsym(RTLD_NEXT, name);
+    return *fn;
+}
+
+/* Returns True the first time a call site is seen */
+static bool firstAtSite(uintptr_t site)
+{
+    unsigned int ix = (site >> 4) % RTCHECK_SITES;
+
+    for (int l1 = 0; l1 < RTCHECK_SITES; l1++) {
+        uintptr_t seen = reportedSites[ix].load(std::memory_order_relaxed);
+        if (seen == site) return false;
+        if (!seen && reportedSites[ix].compare_exchange_strong(seen, site)) {
+            return true;
+        }
+        if (seen == site) return false;
+        ix = (ix + 1) % RTCHECK_SITES;
+    }
+    return true;
+}
+
+static void report(const char *call, const void *site)
+{
+    char line[256];
+    void *frames[RTCHECK_FRAMES];
+    int len, nframes;
+
+    if (!rtDepth || rtReporting) return;
+    if (!reportAll && !firstAtSite((uintptr_t)site)) return;
+
+    /* backtrace() and the formatting below may allocate themselves */
+    rtReporting = true;
+    len = snprintf(line, sizeof(line),
+            "qmidiarp rtcheck: %s() in realtime scope %s (report %u)\n",
+            call, rtScope, ++reportCount);
+    if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+    if (write(STDERR_FILENO, line, len) < 0) len = 0;
+    nframes = backtrace(frames, RTCHECK_FRAMES);
+    /* leave out report() itself */
+    if (nframes > 1) backtrace_symbols_fd(frames + 1, nframes - 1, STDERR_FILENO);
+    if (abortOnReport) abort();
+    rtReporting = false;
+}
+
+__attribute__((constructor)) static void rtCheckInit()
+{
+    void *frames[2];
+    const char *opts = getenv("QMIDIARP_RTCHECK");
+
+    if (opts) {
+        reportAll = (strstr(opts, "all") != NULL);
+        abortOnReport = (strstr(opts, "abort") != NULL);
+    }
+
+    real(&realMutexLock, "pthread_mutex_lock");
+    real(&realUsleep, "usleep");
+    real(&realNanosleep, "nanosleep");
+    real(&realOpen, "open");
+    real(&realFopen, "fopen");
+    real(&realVfprintf, "vfprintf");
+    real(&realPuts, "puts");
+    real(&realFputs, "fputs");
+    real(&realFwrite, "fwrite");
+    real(&realSyscall, "syscall");
+
+    /* the first backtrace() loads the unwinder, do it outside any scope */
+    backtrace(frames, 2);
+}
+
+extern "C" {
+
+void qmidiarp_rtcheck_enter(const char *scope)
+{
+    if (!rtDepth++) rtScope = scope;
+}
+
+void qmidiarp_rtcheck_leave()
+{
+    if (rtDepth > 0) rtDepth--;
+}
+
+void *malloc(size_t size)
+{
+    report("malloc", __builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    report("calloc", __builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    report("realloc", __builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr) report("free", __builtin_return_address(0));
+    __libc_free(ptr);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    void *mem;
+
+    report("posix_memalign", __builtin_return_address(0));
+    if (!alignment || (alignment & (alignment - 1))
+            || (alignment % sizeof(void *))) return EINVAL;
+    mem = __libc_memalign(alignment, size);
+    if (!mem) return ENOMEM;
+    *ptr = mem;
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    report("pthread_mutex_lock", __builtin_return_address(0));
+    return real(&realMutexLock, "pthread_mutex_lock")(mutex);
+}
+
+int usleep(useconds_t usec)
+{
+    report("usleep", __builtin_return_address(0));
+    return real(&realUsleep, "usleep")(usec);
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+    report("nanosleep", __builtin_return_address(0));
+    return real(&realNanosleep, "nanosleep")(req, rem);
+}
+
+int open(const char *path, int flags, ...)
+{
+    va_list ap;
+    mode_t mode = 0;
+
+    report("open", __builtin_return_address(0));
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    return real(&realOpen, "open")(path, flags, mode);
+}
+
+FILE *fopen(const char *path, const char *mode)
+{
+    report("fopen", __builtin_return_address(0));
+    return real(&realFopen, "fopen")(path, mode);
+}
+
+int vfprintf(FILE *stream, const char *format, va_list ap)
+{
+    report("vfprintf", __builtin_return_address(0));
+    return real(&realVfprintf, "vfprintf")(stream, format, ap);
+}
+
+int vprintf(const char *format, va_list ap)
+{
+    report("vprintf", __builtin_return_address(0));
+    return real(&realVfprintf, "vfprintf")(stdout, format, ap);
+}
+
+int fprintf(FILE *stream, const char *format, ...)
+{
+    va_list ap;
+    int ret;
+
+    report("fprintf", __builtin_return_address(0));
+    va_start(ap, format);
+    ret = real(&realVfprintf, "vfprintf")(stream, format, ap);
+    va_end(ap);
+    return ret;
+}
+
+int printf(const char *format, ...)
+{
+    va_list ap;
+    int ret;
+
+    report("printf", __builtin_return_address(0));
+    va_start(ap, format);
+    ret = real(&realVfprintf, "vfprintf")(stdout, format, ap);
+    va_end(ap);
+    return ret;
+}
+
+int __printf_chk(int flag, const char *format, ...)
+{
+    va_list ap;
+    int ret;
+
+    (void)flag;
+    report("printf", __builtin_return_address(0));
+    va_start(ap, format);
+    ret = real(&realVfprintf, "vfprintf")(stdout, format, ap);
+    va_end(ap);
+    return ret;
+}
+
+int __fprintf_chk(FILE *stream, int flag, const char *format, ...)
+{
+    va_list ap;
+    int ret;
+
+    (void)flag;
+    report("fprintf", __builtin_return_address(0));
+    va_start(ap, format);
+    ret = real(&realVfprintf, "vfprintf")(stream, format, ap);
+    va_end(ap);
+    return ret;
+}
+
+int puts(const char *s)
+{
+    report("puts", __builtin_return_address(0));
+    return real(&realPuts, "puts")(s);
+}
+
+int fputs(const char *s, FILE *stream)
+{
+    report("fputs", __builtin_return_address(0));
+    return real(&realFputs, "fputs")(s, stream);
+}
+
+size_t fwrite(const void *ptr, size_t size, size_t count, FILE *stream)
+{
+    report("fwrite", __builtin_return_address(0));
+    return real(&realFwrite, "fwrite")(ptr, size, count, stream);
+}
+
+long syscall(long number, ...) __THROW
+{
+    va_list ap;
+    long a[6];
+
+    if (number == SYS_futex) report("futex", __builtin_return_address(0));
+    /* the kernel takes at most six arguments, extra ones are ignored */
+    va_start(ap, number);
+    for (int l1 = 0; l1 < 6; l1++) a[l1] = va_arg(ap, long);
+    va_end(ap);
+    return real(&realSyscall, "syscall")(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+/* QMutex::lock() */
+void _ZN6QMutex4lockEv(void *mutex)
+{
+    report("QMutex::lock", __builtin_return_address(0));
+    real(&realQMutexLock, "_ZN6QMutex4lockEv")(mutex);
+}
+
+/* QMutex::tryLock(int), a zero timeout never blocks and is not reported */
+bool _ZN6QMutex7tryLockEi(void *mutex, int timeout)
+{
+    if (timeout) report("QMutex::tryLock", __builtin_return_address(0));
+    return real(&realQMutexTryLock, "_ZN6QMutex7tryLockEi")(mutex, timeout);
+}
+
+/* QReadWriteLock::lockForRead() */
+void _ZN14QReadWriteLock11lockForReadEv(void *lock)
+{
+    report("QReadWriteLock::lockForRead", __builtin_return_address(0));
+    real(&realQRwLockForRead, "_ZN14QReadWriteLock11lockForReadEv")(lock);
+}
+
+/* QReadWriteLock::lockForWrite() */
+void _ZN14QReadWriteLock12lockForWriteEv(void *lock)
+{
+    report("QReadWriteLock::lockForWrite", __builtin_return_address(0));
+    real(&realQRwLockForWrite, "_ZN14QReadWriteLock12lockForWriteEv")(lock);
+}
+
+}
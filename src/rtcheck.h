@@ -0,0 +1,68 @@
+/*!
+ * @file rtcheck.h
+ * @brief Defines the RT_SCOPE marker of code that has to be realtime safe
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#ifndef RTCHECK_H
+#define RTCHECK_H
+
+#ifdef RT_CHECK
+
+/* Provided by the qmidiarp_rtcheck.so preload library, null without it */
+extern "C" {
+    void qmidiarp_rtcheck_enter(const char *scope) __attribute__((weak));
+    void qmidiarp_rtcheck_leave() __attribute__((weak));
+}
+
+/*! @brief Marks the calling thread as running realtime code for the
+ * lifetime of the object
+ *
+ * Builds configured with --enable-rtcheck declare one RtScope at the
+ * start of each realtime path through the RT_SCOPE macro. When the
+ * process runs with LD_PRELOAD=qmidiarp_rtcheck.so, that library
+ * reports allocations, mutex locks, sleeps and stdio or file calls
+ * made within a scope, see rtcheck.cpp. QMutex and QReadWriteLock
+ * are caught through their out of line lock functions and futex(),
+ * locks inlined into the caller only when they wait on a futex. Without the library the
+ * scope costs a test of two null pointers, other builds do not
+ * contain it at all.
+ */
+class RtScope {
+  public:
+    explicit RtScope(const char *scope)
+    {
+        if (qmidiarp_rtcheck_enter) qmidiarp_rtcheck_enter(scope);
+    }
+    ~RtScope()
+    {
+        if (qmidiarp_rtcheck_leave) qmidiarp_rtcheck_leave();
+    }
+};
+
+#define RT_SCOPE(scope)     RtScope rtScope(scope)
+
+#else
+
+#define RT_SCOPE(scope)
+
+#endif
+#endif
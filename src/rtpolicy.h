@@ -0,0 +1,127 @@
+/*!
+ * @file rtpolicy.h
+ * @brief Defines the RtPolicy settings and the functions applying them
+ * to threads and to the process memory
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#ifndef RTPOLICY_H
+#define RTPOLICY_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Bytes of stack the realtime thread touches when it starts */
+#define RT_PREFAULT_STACK   (128 * 1024)
+
+/*! @brief Scheduling and memory settings of the application threads
+ *
+ * The realtime thread is the SeqDriver::run() thread with ALSA and the
+ * JACK process thread with JACK, the other threads are the GUI thread
+ * and the MTimer display thread. With JACK, the priority of the process
+ * thread is left to the JACK server, only its CPU is set.
+ *
+ * The settings are given on the command line or in the settings
+ * dialog. Those given on the command line are kept in global_rt_policy
+ * and are taken over by the drivers when they start.
+ */
+struct RtPolicy {
+    int priority;       /*!< SCHED_FIFO priority of the realtime thread, 0 for the default policy */
+    int cpu;            /*!< CPU the realtime thread runs on, -1 for all CPUs */
+    int guiCpu;         /*!< CPU the other threads run on, -1 for all CPUs */
+    bool lockMemory;    /*!< Lock the pages of the process into memory */
+};
+
+extern RtPolicy global_rt_policy;
+extern bool global_rt_cmdline;  /* RtPolicy was set on the command line */
+
+/*! @brief Pins a thread to one CPU or lets it run on all CPUs
+ *
+ * @param thread Thread to pin
+ * @param cpu Index of the CPU, -1 for all online CPUs
+ * @return True on success
+ */
+static inline bool rtSetAffinity(pthread_t thread, int cpu)
+{
+    cpu_set_t set;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    CPU_ZERO(&set);
+    if (cpu >= 0) {
+        if (cpu >= CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+    else {
+        for (long l1 = 0; (l1 < ncpu) && (l1 < CPU_SETSIZE); l1++) CPU_SET(l1, &set);
+    }
+    return !pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+/*! @brief Sets the scheduling class and priority of a thread
+ *
+ * @param thread Thread to change
+ * @param priority SCHED_FIFO priority, 0 for SCHED_OTHER
+ * @return True on success, False typically when missing the rights
+ * for realtime scheduling
+ */
+static inline bool rtSetPriority(pthread_t thread, int priority)
+{
+    struct sched_param param;
+    int max = sched_get_priority_max(SCHED_FIFO);
+
+    memset(&param, 0, sizeof(param));
+    if (priority <= 0) return !pthread_setschedparam(thread, SCHED_OTHER, &param);
+
+    param.sched_priority = (priority > max) ? max : priority;
+    return !pthread_setschedparam(thread, SCHED_FIFO, &param);
+}
+
+/*! @brief Locks all current and future pages of the process into
+ * memory, or unlocks them
+ *
+ * Locking the current pages also faults them in, including the
+ * preallocated event queues and the thread stacks.
+ * @return True on success
+ */
+static inline bool rtLockMemory(bool on)
+{
+    if (!on) return !munlockall();
+    return !mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+
+/*! @brief Touches the stack of the calling thread, so that its pages
+ * do not fault in during the first cycles. Called by the realtime
+ * thread when it starts.
+ */
+static inline void rtPrefaultStack()
+{
+    volatile unsigned char stack[RT_PREFAULT_STACK];
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (page <= 0) page = 4096;
+    for (long l1 = 0; l1 < RT_PREFAULT_STACK; l1 += page) stack[l1] = 0;
+    (void)stack[0];
+}
+
+#endif
@@ -25,17 +25,24 @@
 
 #ifdef HAVE_ALSA
 
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 #include <QString>
 #include <alsa/asoundlib.h>
 
 #include "seqdriver.h"
+#include "rtcheck.h"
 
 SeqDriver::SeqDriver(
     JackDriver *p_jackSync,
     int p_portCount,
     void * callback_context,
-    bool (* midi_event_received_callback)(void * context, MidiEvent ev),
+    bool (* midi_event_received_callback)(void * context, MidiEvent ev, uint64_t tick),
     void (* tick_callback)(void * context, bool echo_from_trig))
     : DriverBase(p_portCount, callback_context, midi_event_received_callback, tick_callback, 60e9)
     , jackSync(p_jackSync)
@@ -43,6 +50,7 @@ SeqDriver::SeqDriver(
     int err;
     char buf[16];
     int l1;
+    snd_seq_port_info_t *pinfo;
 
     /* Register ALSA client */
     err = snd_seq_open(&seq_handle, "hw", SND_SEQ_OPEN_DUPLEX, 0);
@@ -54,19 +62,29 @@ SeqDriver::SeqDriver(
     snd_seq_set_client_name(seq_handle, PACKAGE);
     clientid = snd_seq_client_id(seq_handle);
 
-    /* Register ALSA input port */
-    portid_in = snd_seq_create_simple_port(seq_handle, "in",
-                    SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE,
-                    SND_SEQ_PORT_TYPE_APPLICATION);
-    if (portid_in < 0) {
-        qWarning("Error creating sequencer port (%s).",
-                snd_strerror(portid_in));
+    /* Setup ALSA sequencer queue, run() buffers the events it outputs
+     * in one callback and drains them in one go */
+    poolSize = SEQPOOL;
+    snd_seq_set_client_pool_output(seq_handle, poolSize);
+    snd_seq_set_output_buffer_size(seq_handle, SEQPOOL * sizeof(snd_seq_event_t));
+    queue_id = snd_seq_alloc_queue(seq_handle);
+
+    /* Register ALSA input port, incoming events get stamped with
+     * their arrival time on our queue */
+    snd_seq_port_info_alloca(&pinfo);
+    snd_seq_port_info_set_name(pinfo, "in");
+    snd_seq_port_info_set_capability(pinfo,
+                    SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE);
+    snd_seq_port_info_set_type(pinfo, SND_SEQ_PORT_TYPE_APPLICATION);
+    snd_seq_port_info_set_timestamping(pinfo, 1);
+    snd_seq_port_info_set_timestamp_real(pinfo, 1);
+    snd_seq_port_info_set_timestamp_queue(pinfo, queue_id);
+    err = snd_seq_create_port(seq_handle, pinfo);
+    if (err < 0) {
+        qWarning("Error creating sequencer port (%s).", snd_strerror(err));
         exit(1);
     }
-
-    /* Setup ALSA sequencer queue */
-    snd_seq_set_client_pool_output(seq_handle, SEQPOOL);
-    queue_id = snd_seq_alloc_queue(seq_handle);
+    portid_in = snd_seq_port_info_get_port(pinfo);
 
     /* Register ALSA output ports */
     for (l1 = 0; l1 < portCount; l1++) {
@@ -92,14 +110,11 @@ SeqDriver::SeqDriver(
 
     startQueue = false;
     midiTick = 0;
-    lastRatioTick = 0;
-    tempoChangeTick = 0;
-    midiTempoRefreshTick = 0;
     trStartingTick = 0;
     trLoopingTick = 0;
-    tempoChangeFrame = 0;
     initTempo();
-    tempoChangeTime = 0;
+    tempoMap.setRate(1e9);
+    tempoMap.reset(0, 0, tempo);
     useMidiClock = false;
     
     outputMidiClock = false;
@@ -107,7 +122,30 @@ SeqDriver::SeqDriver(
     
     nextMidiClockTick = 0;
     clockStartOffsetTick = 0;    
+
+    echoPending = false;
+    trigPending = false;
+    memset(portBudget, 0, sizeof(portBudget));
+    echoTick = 0;
+    trigTick = 0;
+    useTimer = global_alsa_timer;
+    timer_fd = -1;
+    if (useTimer) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd < 0) {
+            qWarning("Could not create scheduler timer (%s), using ALSA echoes.",
+                    strerror(errno));
+            useTimer = false;
+        }
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        qWarning("Could not create transport wakeup (%s).", strerror(errno));
+    }
+    transportRequest = false;
+    queueRunning = false;
     threadAbort = false;
+    rtThreadValid = false;
     start(Priority(6));
 }
 
@@ -117,6 +155,8 @@ SeqDriver::~SeqDriver(){
 
     threadAbort = true;
     wait();
+    if (timer_fd >= 0) close(timer_fd);
+    if (wake_fd >= 0) close(wake_fd);
     snd_seq_remove_events_free(remove_ev);
 
 }
@@ -127,40 +167,116 @@ void SeqDriver::run()
     bool unmatched = true;
     double tmpTime = 0;
     int pollr = 0;
+    int pending;
+    int l1;
 
-    int nfds;
+    int nfds, npfds;
+    bool woken, expired;
     struct pollfd *pfds;
+    uint64_t expirations;
+
+    rtThread = pthread_self();
+    applyRtPolicy(true);
+    rtPrefaultStack();
+    rtThreadValid = true;
 
     nfds = snd_seq_poll_descriptors_count(seq_handle, POLLIN);
-    pfds = (struct pollfd *) alloca(nfds * sizeof(struct pollfd));
+    pfds = (struct pollfd *) alloca((nfds + 2) * sizeof(struct pollfd));
     snd_seq_poll_descriptors(seq_handle, pfds, nfds, POLLIN);
+    npfds = nfds;
+    if (wake_fd >= 0) {
+        pfds[npfds].fd = wake_fd;
+        pfds[npfds].events = POLLIN;
+        pfds[npfds].revents = 0;
+        npfds++;
+    }
+    // the timer is the last descriptor if there is one
+    if (timer_fd >= 0) {
+        pfds[npfds].fd = timer_fd;
+        pfds[npfds].events = POLLIN;
+        pfds[npfds].revents = 0;
+        npfds++;
+    }
 
     while (((long)poll >= 0) && (!threadAbort)) {
 
-        pollr = poll(pfds, nfds, 200);
+        // input left over from a batch cut short by a transport
+        // change is taken up again without waiting
+        pending = pollr;
+        pollr = poll(pfds, npfds, (pending > 0) ? 0 : 200);
+        // the wakeup and the timer are no ALSA input, only go on
+        // reading ALSA input if there is some
+        woken = false;
+        expired = false;
+        for (l1 = nfds; (pollr > 0) && (l1 < npfds); l1++) {
+            if (!(pfds[l1].revents & POLLIN)) continue;
+            if (pfds[l1].fd == wake_fd) woken = true;
+            else expired = true;
+        }
+        if (woken || expired) {
+            pollr = 0;
+            for (l1 = 0; l1 < nfds; l1++) {
+                if (pfds[l1].revents & POLLIN) pollr = 1;
+            }
+            if (!pollr) pollr = snd_seq_event_input_pending(seq_handle, 0);
+        }
+        if ((pending > 0) && (pollr <= 0))
+            pollr = snd_seq_event_input_pending(seq_handle, 0);
+        if (woken && (read(wake_fd, &expirations, sizeof(expirations)) < 0))
+            qWarning("Could not read transport wakeup (%s).", strerror(errno));
+        // transport changes are applied before any input is handled,
+        // they take ALSA system calls and are outside the RT scope
+        if (transportRequest.exchange(false)) applyTransportStatus();
+
+        // the wait above may block, the handling below may not
+        RT_SCOPE("SeqDriver::run");
+        if (expired) {
+            if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                timerCallback();
+        }
         while (pollr > 0) {
 
-            tmpTime = getCurrentTime();
-
+            // a transport change goes before the remaining input
+            if (transportRequest) break;
             snd_seq_event_input(seq_handle, &evIn);
+
+            // events stamped on our queue carry their arrival time
+            if ((evIn->queue == queue_id) && snd_seq_ev_is_real(evIn))
+                tmpTime = aTimeToDelta(&evIn->time.time);
+            else
+                tmpTime = getCurrentTime();
             
             MidiEvent inEv = mkMidiEvent(evIn->type, evIn->data.note.note);
 
             if ((inEv.type == EV_CLOCK)&& useMidiClock) {
+                if (!midiTick) clockDll.reset();
+                clockDll.update(tmpTime);
                 m_current_tick = midiTick * TPQN / MIDICLK_TPQN;
-                if (!(midiTick % 8) || !midiTick) {
-                    calcMidiClockTempo(tmpTime);
+                // continue the map from the filtered clock time each clock
+                if (clockDll.locked()) {
+                    tempo = clockDll.tempo(1e9);
                     internalTempo = tempo;
+                    tempoMap.reset((uint64_t)clockDll.time(), m_current_tick, tempo);
                 }
                 if ((midiTick % 48) == 4 ) {
-                    tempoChangeTick = m_current_tick;
-                    tempoChangeTime = tmpTime;
                     jackSync->tempoCb(internalTempo, jackSync->cbContext);
                 }
                 midiTick++;
             }
             if (((inEv.type == EV_ECHO) || startQueue) && queueStatus) {
                 calcCurrentTick(tmpTime);
+                // the tick the echo was requested for has been reached,
+                // even if the map moved a little since the request
+                if (inEv.type == EV_ECHO) {
+                    uint64_t echo_tick = evIn->data.raw32.d[1]
+                            | ((uint64_t)evIn->data.raw32.d[2] << 32);
+                    if (m_current_tick < echo_tick) m_current_tick = echo_tick;
+                }
+                if (startQueue) {
+                    // forget timer echoes left over from before the start
+                    echoPending = false;
+                    trigPending = false;
+                }
                 sendMidiClock();
                 startQueue = false;
                 tick_callback((inEv.data));
@@ -180,18 +296,19 @@ void SeqDriver::run()
                     calcCurrentTick(tmpTime);
                 }
 
-                unmatched = midi_event_received(inEv);
+                unmatched = midi_event_received(inEv, m_current_tick);
 
                 if (forwardUnmatched && unmatched) {
                     snd_seq_ev_set_subs(evIn);
                     snd_seq_ev_set_direct(evIn);
                     snd_seq_ev_set_source(evIn, portid_out[portUnmatched]);
-                    snd_seq_event_output_direct(seq_handle, evIn);
+                    outputEvent(evIn);
                 }
             }
             if (!queueStatus) m_current_tick = 0; //some events still come in after queue stop
             pollr = snd_seq_event_input_pending(seq_handle, 0);
         }
+        snd_seq_drain_output(seq_handle);
     }
 }
 
@@ -219,15 +336,15 @@ void SeqDriver::calcCurrentTick(double tmpTime) {
         jPos = jackSync->getCurrentPos();
         if (jPos.beats_per_minute > 0.01) requestedTempo = jPos.beats_per_minute;
 
-        m_current_tick = (uint64_t)(jPos.frame - tempoChangeFrame) * TPQN  * tempo
-                / jPos.frame_rate / 60.
-                + tempoChangeTick;
+        // the transport position is taken at the JACK cycle start
+        m_current_tick = jackTempoMap.frameToTick(jPos.frame
+                + jackSync->getFramesSinceCycleStart());
         tmpTime = tickToDelta(m_current_tick);
         snd_seq_event_t ev;
         snd_seq_ev_clear(&ev);
         snd_seq_ev_set_queue_pos_real(&ev, queue_id, deltaToATime(tmpTime));
         snd_seq_ev_set_direct(&ev);
-        snd_seq_event_output_direct(seq_handle, &ev);
+        outputEvent(&ev);
     }
     else {
         m_current_tick = deltaToTick(tmpTime);
@@ -242,8 +359,6 @@ void SeqDriver::initTempo()
             tempo = jPos.beats_per_minute;
         else
             tempo = internalTempo;
-
-        tempoChangeFrame = (uint64_t)jPos.frame;
     }
     else {
         tempo = internalTempo;
@@ -251,14 +366,15 @@ void SeqDriver::initTempo()
 
     if (useMidiClock) {
         midiTick = 0;
-        lastRatioTick = 0;
-        midiTempoRefreshTick = 0;
     }
 }
 
 void SeqDriver::sendMidiEvent(MidiEvent outEv, uint64_t n_tick, unsigned outport, unsigned length)
 {
     double duration = (double)length / tempo * 40 / 128;
+    // events already scheduled to the ALSA queue cannot be merged,
+    // refused ones are dropped
+    if (!admitEvent(portBudget[outport], outEv, n_tick)) return;
     //qWarning("sendMidiEvent([%d, %d, %d, %d], %u, %f) at tick %lu", outEv.type, outEv.channel, outEv.data, outEv.value, outport, duration, n_tick);
     snd_seq_event_t ev;
     snd_seq_ev_clear(&ev);
@@ -276,7 +392,33 @@ void SeqDriver::sendMidiEvent(MidiEvent outEv, uint64_t n_tick, unsigned outport
     snd_seq_ev_schedule_real(&ev, queue_id, 0, deltaToATime(tickToDelta(n_tick)));
     snd_seq_ev_set_subs(&ev);
     snd_seq_ev_set_source(&ev, portid_out[outport]);
-    snd_seq_event_output_direct(seq_handle, &ev);
+    outputEvent(&ev);
+}
+
+uint32_t SeqDriver::getPortOverloads(int port)
+{
+    if ((port < 0) || (port >= portCount)) return 0;
+    return portBudget[port].overloads;
+}
+
+void SeqDriver::setRtPolicy(const RtPolicy &policy)
+{
+    rtPolicy = policy;
+    if (rtThreadValid) applyRtPolicy(false);
+}
+
+void SeqDriver::applyRtPolicy(bool startup)
+{
+    // at startup, keep the defaults unless something was requested,
+    // the thread inherits the CPU of the GUI thread though
+    if (!startup || (rtPolicy.priority > 0)) {
+        if (!rtSetPriority(rtThread, rtPolicy.priority))
+            qWarning("Could not set realtime priority %d", rtPolicy.priority);
+    }
+    if (!startup || (rtPolicy.cpu >= 0) || (rtPolicy.guiCpu >= 0)) {
+        if (!rtSetAffinity(rtThread, rtPolicy.cpu))
+            qWarning("Could not move realtime thread to CPU %d", rtPolicy.cpu);
+    }
 }
 
 bool SeqDriver::requestEchoAt(uint64_t echo_tick, bool echo_from_trig)
@@ -284,88 +426,198 @@ bool SeqDriver::requestEchoAt(uint64_t echo_tick, bool echo_from_trig)
     if ((echo_tick == lastSchedTick) && (echo_tick)) return false;
 
     lastSchedTick = echo_tick;
+
+    // the timer state belongs to the run() thread, other threads use
+    // ALSA echo events
+    if (useTimer && (QThread::currentThread() == this)) {
+        if (echo_from_trig) {
+            if (!trigPending || (echo_tick < trigTick)) trigTick = echo_tick;
+            trigPending = true;
+        }
+        else {
+            if (!echoPending || (echo_tick < echoTick)) echoTick = echo_tick;
+            echoPending = true;
+        }
+        armTimer();
+        return true;
+    }
+
     snd_seq_event_t ev;
     snd_seq_ev_clear(&ev);
     ev.type = SND_SEQ_EVENT_ECHO;
     ev.data.note.note = echo_from_trig;
+    // the echoed tick goes after the note fields
+    ev.data.raw32.d[1] = (uint32_t)echo_tick;
+    ev.data.raw32.d[2] = (uint32_t)(echo_tick >> 32);
     snd_seq_ev_schedule_real(&ev, queue_id,  0, deltaToATime(tickToDelta(echo_tick)));
     snd_seq_ev_set_dest(&ev, clientid, portid_in);
-    snd_seq_event_output_direct(seq_handle, &ev);
+    outputEvent(&ev);
     return true;
 }
 
 void SeqDriver::requestTempo(double bpm)
 {
-    double tmpTime = getCurrentTime();
-    calcCurrentTick(tmpTime);
-    tempoChangeTick = m_current_tick;
-    tempoChangeTime = tmpTime;
-    internalTempo = bpm;
-    initTempo();
+    calcCurrentTick(getCurrentTime());
+    setTempo(bpm);
     requestedTempo = bpm;
     requestEchoAt(lastSchedTick + 1);
 }
 
 void SeqDriver::setTempo(double bpm)
 {
-    tempoChangeTick = m_current_tick;
-    tempoChangeTime = getCurrentTime();
     internalTempo = bpm;
     initTempo();
+    tempoMap.setTempo((uint64_t)getCurrentTime(), tempo);
+    if (useJackSync) jackTempoMap.setTempo(jPos.frame, tempo);
 }
 
 double SeqDriver::getCurrentTime()
 {
     snd_seq_queue_status_t *status;
 
-    snd_seq_queue_status_malloc(&status);
+    // on the stack, this is called for every incoming event
+    snd_seq_queue_status_alloca(&status);
     snd_seq_get_queue_status(seq_handle, queue_id, status);
 
     const snd_seq_real_time_t* current_time =
         snd_seq_queue_status_get_real_time(status);
     snd_seq_real_time_t tmpTime = *current_time;
-    snd_seq_queue_status_free(status);
 
     return aTimeToDelta(&tmpTime);
 }
 
-void SeqDriver::setTransportStatus(bool run)
+void SeqDriver::outputEvent(snd_seq_event_t *ev)
 {
-    if (run) {
-        queueStatus = true;
-        startQueue = true;
+    // the run() thread drains its buffered events after each batch of
+    // input events, calls from other threads go out immediately
+    if (QThread::currentThread() == this)
+        snd_seq_event_output(seq_handle, ev);
+    else
+        snd_seq_event_output_direct(seq_handle, ev);
+}
 
-        initTempo();
-        tempoChangeTick = 0;
-        tempoChangeTime = 0;
-        tempoChangeFrame = 0;
-        nextMidiClockTick = 0;
-        if (useJackSync)
-            trStartingTick = jackSync->trStartingTick;
-        else
-            trStartingTick = 0;
-        snd_seq_start_queue(seq_handle, queue_id, NULL);
-        snd_seq_drain_output(seq_handle);
-        calcCurrentTick(0);
-        printf("Alsa Queue started \n");
+void SeqDriver::armTimer()
+{
+    struct itimerspec its;
+    struct timespec now;
+    uint64_t tick, ns;
+    double delta;
+
+    memset(&its, 0, sizeof(its));
+    if (echoPending || trigPending) {
+        tick = echoPending ? echoTick : trigTick;
+        if (trigPending && (trigTick < tick)) tick = trigTick;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        delta = tickToDelta(tick) - getCurrentTime() - TIMER_LOOKAHEAD;
+        // a zero expiry would disarm the timer
+        if (delta < 1) delta = 1;
+        ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec + (uint64_t)delta;
+        its.it_value.tv_sec = ns / 1000000000;
+        its.it_value.tv_nsec = ns % 1000000000;
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+void SeqDriver::timerCallback()
+{
+    bool from_trig;
+    uint64_t tick;
+
+    if (!queueStatus || startQueue) {
+        echoPending = false;
+        trigPending = false;
+        return;
+    }
+    if (!echoPending && !trigPending) return;
+
+    from_trig = trigPending && (!echoPending || (trigTick <= echoTick));
+    if (from_trig) {
+        tick = trigTick;
+        trigPending = false;
     }
     else {
-        queueStatus = false;
-        if (outputMidiClock) {
-            sendMidiEvent(mkMidiEvent(EV_STOP), m_current_tick, portMidiClock, 0);
-        }
-        
+        tick = echoTick;
+        echoPending = false;
+    }
+
+    // we woke up TIMER_LOOKAHEAD early, render as if the echo was due
+    calcCurrentTick(getCurrentTime());
+    if (m_current_tick < tick) m_current_tick = tick;
+    sendMidiClock();
+    tick_callback(from_trig);
+    armTimer();
+}
+
+void SeqDriver::setOutputPool(int nevents)
+{
+    if (nevents < SEQPOOL) nevents = SEQPOOL;
+    if (nevents == poolSize) return;
+
+    int err = snd_seq_set_client_pool_output(seq_handle, nevents);
+    if (err < 0) {
+        qWarning("Could not resize ALSA output pool to %d events (%s).",
+                nevents, snd_strerror(err));
+        return;
+    }
+    poolSize = nevents;
+}
+
+void SeqDriver::setTransportStatus(bool run)
+{
+    // the queue and the output buffer belong to the run() thread,
+    // it applies the change before handling further input
+    queueStatus = run;
+    transportRequest = true;
+    if (wake_fd >= 0) {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0)
+            qWarning("Could not wake sequencer thread (%s).", strerror(errno));
+    }
+}
+
+void SeqDriver::applyTransportStatus()
+{
+    if (queueRunning) {
+        // events still in our output buffer never reached the queue,
+        // the ones already scheduled are removed from it
+        snd_seq_drop_output(seq_handle);
         snd_seq_remove_events_set_queue(remove_ev, queue_id);
         snd_seq_remove_events_set_condition(remove_ev,
                 SND_SEQ_REMOVE_OUTPUT | SND_SEQ_REMOVE_IGNORE_OFF);
         snd_seq_remove_events(seq_handle, remove_ev);
 
+        if (outputMidiClock) {
+            sendMidiEvent(mkMidiEvent(EV_STOP), m_current_tick, portMidiClock, 0);
+        }
         snd_seq_stop_queue(seq_handle, queue_id, NULL);
+        snd_seq_drain_output(seq_handle);
+        queueRunning = false;
 
         m_current_tick = 0;
 
         printf("Alsa Queue stopped \n");
     }
+    if (queueStatus) {
+        startQueue = true;
+
+        initTempo();
+        tempoMap.reset(0, 0, tempo);
+        if (useJackSync && jPos.frame_rate) {
+            jackTempoMap.setRate(jPos.frame_rate);
+            jackTempoMap.reset(0, 0, tempo);
+        }
+        nextMidiClockTick = 0;
+        if (useJackSync)
+            trStartingTick = jackSync->trStartingTick;
+        else
+            trStartingTick = 0;
+        snd_seq_start_queue(seq_handle, queue_id, NULL);
+        calcCurrentTick(0);
+        snd_seq_drain_output(seq_handle);
+        queueRunning = true;
+        printf("Alsa Queue started \n");
+    }
 }
 
 void SeqDriver::setUseMidiClock(bool on)
@@ -376,18 +628,13 @@ void SeqDriver::setUseMidiClock(bool on)
 
 double SeqDriver::tickToDelta(uint64_t tick)
 {
-    if (tick > tempoChangeTick)
-        return (double)(60e9/TPQN/tempo) * (tick-tempoChangeTick) + tempoChangeTime;
-    else
-        return 0;
+    return tempoMap.tickToFrame(tick);
 }
 
 uint64_t SeqDriver::deltaToTick(double curtime)
 {
-    if (tempoChangeTime < curtime)
-        return (int)((curtime-tempoChangeTime) / (60e9/TPQN/tempo))+tempoChangeTick;
-    else
-        return tempoChangeTick;
+    if (curtime < 0) curtime = 0;
+    return tempoMap.frameToTick((uint64_t)curtime);
 }
 
 double SeqDriver::aTimeToDelta(snd_seq_real_time_t* atime)
@@ -402,21 +649,6 @@ const snd_seq_real_time_t* SeqDriver::deltaToATime(double curtime)
     return &atime;
 }
 
-void SeqDriver::calcMidiClockTempo(double realtime)
-{
-    double old_tempo = tempo;
-
-    if (m_current_tick > 0) {
-        tempo =   60e9
-                * (double)(m_current_tick - tempoChangeTick)
-                / (realtime - tempoChangeTime)
-                / TPQN;
-    }
-    if ((tempo == 0) || (tempo > 1000.)) {
-        tempo = old_tempo;
-    }
-}
-
 int SeqDriver::getClientId()
 {
     return clientid;
@@ -29,9 +29,16 @@
 
 #ifdef HAVE_ALSA
 #include <alsa/asoundlib.h>
+#include <atomic>
 
 #include "jackdriver.h"
 #include "driverbase.h"
+#include "timebase.h"
+
+/* Nanoseconds the timer scheduler wakes up before an echo is due */
+#define TIMER_LOOKAHEAD  1000000
+
+extern bool global_alsa_timer;
 
 /*! @brief ALSA sequencer backend QThread class.
  *
@@ -42,7 +49,9 @@
  * The SeqDriver::run() thread is the ALSA sequencer "callback" process
  * handling all incoming and outgoing sequencer events.
  * When the SeqDriver::setTransportStatus() function is called with True
- * argument, a so called "echo event" is scheduled to ALSA with zero time.
+ * argument, run() starts the ALSA queue and a so called "echo event" is
+ * scheduled to ALSA with zero time. All queue control and the draining of
+ * the output buffer are done by run(), other threads only request them.
  * ALSA will send the echo events back
  * to the process and call Engine::echoCallback() regularly to query for
  * events to be scheduled. Incoming MIDI events from ALSA are transferred
@@ -56,6 +65,13 @@
  * communicates with the ALSA queue. Internally, the real time information
  * is rescaled to a simpler tick-based timing, which is currently 192 tpqn
  * using the deltaToTick() and tickToDelta() functions.
+ *
+ * With the --timer option, echoes requested by the SeqDriver::run() thread
+ * itself do not go through the ALSA queue. run() then also polls a
+ * timerfd, which is armed TIMER_LOOKAHEAD before the earliest requested
+ * echo. The events rendered on expiry are scheduled to the queue with
+ * their real time stamps as before, so they still leave on time. Echoes
+ * requested by other threads keep using ALSA echo events.
  */
 class SeqDriver : public DriverBase {
 
@@ -63,19 +79,36 @@ class SeqDriver : public DriverBase {
 
     private:
         snd_seq_t *seq_handle;
+        int poolSize;
         int clientid;
         int portid_out[MAX_PORTS];
         int portid_in;
         int queue_id;
         bool startQueue;
         bool threadAbort;
+        bool useTimer;          /**< Schedule own echoes with timer_fd */
+        int timer_fd;           /**< timerfd polled by run(), -1 if none */
+        int wake_fd;            /**< eventfd polled by run(), wakes it for a transport change */
+        std::atomic<bool> transportRequest; /**< run() has to apply queueStatus to the queue */
+        bool queueRunning;      /**< The queue was started by run() */
+        bool echoPending;       /**< A timer echo is requested at echoTick */
+        bool trigPending;       /**< A keyboard trigger echo is requested at trigTick */
+        uint64_t echoTick;
+        uint64_t trigTick;
+        PortBudget portBudget[MAX_PORTS];   /**< Bandwidth governor state of the output ports */
+        pthread_t rtThread;     /**< The run() thread, valid once rtThreadValid is set */
+        std::atomic<bool> rtThreadValid;
 
         double tickToDelta(uint64_t tick);
         uint64_t deltaToTick (double curtime);
         double aTimeToDelta(snd_seq_real_time_t* atime);
         const snd_seq_real_time_t* deltaToATime(double curtime);
+        void outputEvent(snd_seq_event_t *ev);
+        void armTimer();
+        void timerCallback();
+        void applyRtPolicy(bool startup);
+        void applyTransportStatus();
         snd_seq_remove_events_t *remove_ev;
-        void calcMidiClockTempo(double realtime);
         void sendMidiClock();
         void initTempo();
         bool callJack(int portcount, const QString & clientname=PACKAGE);
@@ -84,15 +117,13 @@ class SeqDriver : public DriverBase {
         jack_position_t jPos;
 
         uint64_t midiTick;
-        uint64_t lastRatioTick;
-        uint64_t midiTempoRefreshTick;
         uint64_t nextMidiClockTick;
         uint64_t clockStartOffsetTick;
         uint64_t lastSchedTick;
-        uint64_t tempoChangeTick;
-        uint64_t tempoChangeFrame;
 
-        double tempoChangeTime;
+        ClockDll clockDll;      /**< Follows the incoming MIDI clock in queue time */
+        TempoMap tempoMap;      /**< Maps ALSA queue nanoseconds to ticks */
+        TempoMap jackTempoMap;  /**< Maps JACK transport frames to ticks when synced */
         snd_seq_real_time_t atime;
 
 
@@ -105,7 +136,7 @@ class SeqDriver : public DriverBase {
             JackDriver *p_jackSync,
             int p_portCount,
             void * callback_context,
-            bool (* midi_event_received_callback)(void * context, MidiEvent ev),
+            bool (* midi_event_received_callback)(void * context, MidiEvent ev, uint64_t tick),
             void (* tick_callback)(void * context, bool echo_from_trig));
         ~SeqDriver();
         double getCurrentTime();
@@ -113,6 +144,9 @@ class SeqDriver : public DriverBase {
         void requestTempo(double bpm);
         void setTempo(double bpm);
         int getClientId();
+        void setOutputPool(int nevents);
+        uint32_t getPortOverloads(int port);
+        void setRtPolicy(const RtPolicy &policy);
         void run();
 
    public slots:
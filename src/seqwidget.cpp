@@ -34,12 +34,34 @@ SeqWidget::SeqWidget(MidiSeq *p_midiSeq, GlobStore *p_globStore,
     ModuleWidget(p_midiSeq, p_globStore, p_prefs, inOutVisible, p_name),
     midiSeq(p_midiSeq)
 {
-    bool compactStyle = p_prefs->compactStyle;
+    screen = NULL;
+    cursor = NULL;
+    resBoxIndex = 3;
+    sizeBoxIndex = 3;
+    dispVertIndex = 0;
+    recordMode = false;
+    lastMute = false;
+    applyData();
+    modified = false;
+}
 #else
 SeqWidget::SeqWidget():
     ModuleWidget("Seq:"),
     midiSeq(NULL)
 {
+    buildUi();
+}
+#endif
+
+void SeqWidget::buildUi()
+{
+#ifdef APPBUILD
+    bool compactStyle = prefs->compactStyle;
+    MidiSeq *worker = midiSeq;
+
+    // see ModuleWidget::ensureUi()
+    midiSeq = NULL;
+#else
     bool compactStyle = true;
 #endif
 
@@ -216,6 +238,29 @@ SeqWidget::SeqWidget():
     updateVelocity(64);
     updateWaveForm(0);
     lastMute = false;
+
+#ifdef APPBUILD
+    loopBox->setCurrentIndex(moduleData.loopMode);
+    resBox->setCurrentIndex(moduleData.res);
+    sizeBox->setCurrentIndex(moduleData.size);
+    velocity->setValue(moduleData.vel);
+    notelength->setValue(moduleData.notelen);
+    transpose->setValue(moduleData.transp);
+    setDispVert(moduleData.dispVertIndex);
+    dispVertIndex = moduleData.dispVertIndex;
+    resBoxIndex = moduleData.res;
+    sizeBoxIndex = moduleData.size;
+
+    midiSeq = worker;
+    std::vector<Sample> sdata;
+    midiSeq->getData(&sdata);
+    data = QVector<Sample>::fromStdVector(sdata);
+    screen->updateData(data);
+    screen->updateDispVert(dispVertIndex);
+    screen->setLoopMarker(midiSeq->loopMarker);
+    cursor->updateNumbers(midiSeq->res, midiSeq->size);
+    midiSeq->dataChanged = false;
+#endif
     modified = false;
 }
 
@@ -230,6 +275,7 @@ void SeqWidget::writeData(QXmlStreamWriter& xml)
     QByteArray tempArray;
     int l1;
 
+        if (uiBuilt) controlsToData();
         writeCommonData(xml);
 
         xml.writeStartElement("display");
@@ -239,11 +285,11 @@ void SeqWidget::writeData(QXmlStreamWriter& xml)
 
         xml.writeStartElement("seqParams");
             xml.writeTextElement("loopmode", QString::number(
-                loopBox->currentIndex()));
+                moduleData.loopMode));
             xml.writeTextElement("resolution", QString::number(
-                resBox->currentIndex()));
+                moduleData.res));
             xml.writeTextElement("size", QString::number(
-                sizeBox->currentIndex()));
+                moduleData.size));
             xml.writeTextElement("velocity", QString::number(
                 midiSeq->vel));
             xml.writeTextElement("noteLength", QString::number(
@@ -255,7 +301,7 @@ void SeqWidget::writeData(QXmlStreamWriter& xml)
         tempArray.clear();
         l1 = 0;
         while (l1 < midiSeq->maxNPoints) {
-            tempArray.append(midiSeq->muteMask.at(l1));
+            tempArray.append(midiSeq->customWave.isMuted(l1));
             l1++;
         }
         xml.writeStartElement("muteMask");
@@ -265,7 +311,7 @@ void SeqWidget::writeData(QXmlStreamWriter& xml)
         tempArray.clear();
         l1 = 0;
         while (l1 < midiSeq->maxNPoints) {
-            tempArray.append(midiSeq->customWave.at(l1).data);
+            tempArray.append(midiSeq->customWave.value(l1));
             l1++;
         }
         xml.writeStartElement("sequence");
@@ -280,7 +326,6 @@ void SeqWidget::writeData(QXmlStreamWriter& xml)
 void SeqWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
 {
     int tmp;
-    Sample sample = {0, 0, 0, false};
 
     while (!xml.atEnd()) {
         xml.readNext();
@@ -305,7 +350,7 @@ void SeqWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 if (xml.isEndElement())
                     break;
                 if (xml.name() == "vertical")
-                    setDispVert(xml.readElementText().toInt());
+                    moduleData.dispVertIndex = xml.readElementText().toInt();
                 else skipXmlElement(xml);
             }
         }
@@ -315,40 +360,28 @@ void SeqWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 xml.readNext();
                 if (xml.isEndElement())
                     break;
-                if (xml.name() == "loopmode") {
-                    tmp = xml.readElementText().toInt();
-                    loopBox->setCurrentIndex(tmp);
-                    updateLoop(tmp);
-                }
+                if (xml.name() == "loopmode")
+                    moduleData.loopMode = xml.readElementText().toInt();
                 else if (xml.name() == "resolution") {
                     tmp = xml.readElementText().toInt();
                     if (qmaxVersion == "" && tmp < 5) {
                         tmp = mapOldSeqRes[tmp];
                     }
-                    resBox->setCurrentIndex(tmp);
-                    updateRes(tmp);
+                    moduleData.res = tmp;
                 }
                 else if (xml.name() == "size") {
                     tmp = xml.readElementText().toInt();
                     if (qmaxVersion == "" && tmp < 10) {
                         tmp = mapOldSeqSize[tmp];
                     }
-                    sizeBox->setCurrentIndex(tmp);
-                    updateSize(tmp);
-                }
-                else if (xml.name() == "velocity") {
-                    tmp = xml.readElementText().toInt();
-                    velocity->setValue(tmp);
-                    updateVelocity(tmp);
-                }
-                else if (xml.name() == "noteLength") {
-                    notelength->setValue(xml.readElementText().toInt());
-                }
-                else if (xml.name() == "transp") {
-                    tmp = xml.readElementText().toInt();
-                    transpose->setValue(tmp);
-                    updateTranspose(tmp);
+                    moduleData.size = tmp;
                 }
+                else if (xml.name() == "velocity")
+                    moduleData.vel = xml.readElementText().toInt();
+                else if (xml.name() == "noteLength")
+                    moduleData.notelen = xml.readElementText().toInt();
+                else if (xml.name() == "transp")
+                    moduleData.transp = xml.readElementText().toInt();
                 else skipXmlElement(xml);
             }
         }
@@ -361,7 +394,7 @@ void SeqWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                     QByteArray tmpArray =
                             QByteArray::fromHex(xml.readElementText().toLatin1());
                     for (int l1 = 0; l1 < tmpArray.count(); l1++) {
-                        midiSeq->muteMask[l1] = tmpArray.at(l1);
+                        midiSeq->customWave.setMuted(l1, tmpArray.at(l1));
                     }
                     midiSeq->maxNPoints = tmpArray.count();
                 }
@@ -376,34 +409,54 @@ void SeqWidget::readData(QXmlStreamReader& xml, const QString& qmaxVersion)
                 if (xml.isStartElement() && (xml.name() == "data")) {
                     QByteArray tmpArray =
                             QByteArray::fromHex(xml.readElementText().toLatin1());
-                    int step = TPQN / midiSeq->res;
-                    int lt = 0;
                     for (int l1 = 0; l1 < tmpArray.count(); l1++) {
-                        sample.data = tmpArray.at(l1);
-                        sample.tick = lt;
-                        sample.muted = midiSeq->muteMask[l1];
-                        midiSeq->customWave[l1] = sample;
-                        lt+=step;
+                        midiSeq->customWave.setValue(l1, tmpArray.at(l1));
                     }
-                    updateWaveForm(0);
-                }
-                else if (xml.name() == "loopmarker") {
-                    tmp = xml.readElementText().toInt();
-                    midiSeq->setLoopMarker(tmp);
-                    screen->setLoopMarker(tmp);
                 }
+                else if (xml.name() == "loopmarker")
+                    moduleData.loopMarker = xml.readElementText().toInt();
                 else skipXmlElement(xml);
             }
         }
         else skipXmlElement(xml);
     }
     
-    updateChIn(chIn->currentIndex());
-    updateChannelOut(channelOut->currentIndex());
-    updatePortOut(portOut->currentIndex());
+    applyData();
     midiSeq->needsGUIUpdate = false;
     modified = false;
 }
+
+void SeqWidget::applyData()
+{
+    ModuleWidget::applyData();
+    midiSeq->updateLoop(moduleData.loopMode);
+    midiSeq->res = seqResValues[moduleData.res];
+    midiSeq->size = seqSizeValues[moduleData.size];
+    midiSeq->resizeAll();
+    midiSeq->updateVelocity(moduleData.vel);
+    midiSeq->updateNoteLength(sliderToTickLen(moduleData.notelen));
+    midiSeq->updateTranspose(moduleData.transp);
+    midiSeq->updateDispVert(moduleData.dispVertIndex);
+    // clamped against the size, so only after resizeAll()
+    midiSeq->setLoopMarker(moduleData.loopMarker);
+
+    resBoxIndex = moduleData.res;
+    sizeBoxIndex = moduleData.size;
+    dispVertIndex = moduleData.dispVertIndex;
+}
+
+void SeqWidget::controlsToData()
+{
+    ModuleWidget::controlsToData();
+    moduleData.loopMode = loopBox->currentIndex();
+    moduleData.res = resBox->currentIndex();
+    moduleData.size = sizeBox->currentIndex();
+    moduleData.vel = velocity->value();
+    moduleData.notelen = notelength->value();
+    moduleData.transp = transpose->value();
+    moduleData.dispVertIndex = dispVertIndex;
+    moduleData.loopMarker = getLoopMarker();
+}
 #endif
 
 void SeqWidget::updateNoteLength(int val)
@@ -521,16 +574,14 @@ void SeqWidget::updateDispVert(int mode)
 
 void SeqWidget::doStoreParams(int ix)
 {
-    parStore->temp.res = resBox->currentIndex();
-    parStore->temp.size = sizeBox->currentIndex();
-    parStore->temp.loopMode = loopBox->currentIndex();
-    parStore->temp.notelen = notelength->value();
-    parStore->temp.transp = transpose->value();
-    parStore->temp.vel = velocity->value();
+    parStore->temp.res = moduleData.res;
+    parStore->temp.size = moduleData.size;
+    parStore->temp.loopMode = moduleData.loopMode;
+    parStore->temp.notelen = moduleData.notelen;
+    parStore->temp.transp = moduleData.transp;
+    parStore->temp.vel = moduleData.vel;
     parStore->temp.dispVertIndex = dispVertIndex;
-    parStore->temp.loopMode = loopBox->currentIndex();
-    parStore->temp.wave = getCustomWave().mid(0, midiSeq->maxNPoints);
-    parStore->temp.muteMask = getMuteMask().mid(0, midiSeq->maxNPoints);
+    parStore->waveToTemp(midiSeq->customWave, midiSeq->maxNPoints);
     parStore->temp.loopMarker = getLoopMarker();
 
     parStore->tempToList(ix);
@@ -540,9 +591,32 @@ void SeqWidget::doRestoreParams(int ix)
 {
     midiSeq->applyPendingParChanges();
     if (parStore->list.at(ix).empty) return;
-    for (int l1 = 0; l1 < parStore->list.at(ix).wave.count(); l1++) {
-        midiSeq->customWave[l1] = parStore->list.at(ix).wave.at(l1);
-        midiSeq->muteMask[l1] = parStore->list.at(ix).muteMask.at(l1);
+    parStore->listToWave(ix, midiSeq->customWave);
+    if (!uiBuilt) {
+        moduleData.size = parStore->list.at(ix).size;
+        moduleData.res = parStore->list.at(ix).res;
+        moduleData.loopMode = parStore->list.at(ix).loopMode;
+        moduleData.loopMarker = parStore->list.at(ix).loopMarker;
+        sizeBoxIndex = moduleData.size;
+        resBoxIndex = moduleData.res;
+        midiSeq->size = seqSizeValues[moduleData.size];
+        midiSeq->res = seqResValues[moduleData.res];
+        midiSeq->resizeAll();
+        midiSeq->setLoopMarker(moduleData.loopMarker);
+        if (!parStore->onlyPatternList.at(ix)) {
+            moduleData.notelen = parStore->list.at(ix).notelen;
+            moduleData.transp = parStore->list.at(ix).transp;
+            moduleData.vel = parStore->list.at(ix).vel;
+            moduleData.dispVertIndex = parStore->list.at(ix).dispVertIndex;
+            dispVertIndex = moduleData.dispVertIndex;
+            midiSeq->notelength = sliderToTickLen(moduleData.notelen);
+            midiSeq->transp = moduleData.transp;
+            midiSeq->vel = moduleData.vel;
+            midiSeq->updateDispVert(dispVertIndex);
+        }
+        midiSeq->updateLoop(moduleData.loopMode);
+        midiSeq->setFramePtr(0);
+        return;
     }
     sizeBoxIndex = parStore->list.at(ix).size;
     sizeBox->setCurrentIndex(sizeBoxIndex);
@@ -573,6 +647,9 @@ void SeqWidget::copyParamsFrom(ModuleWidget *p_fromWidget)
     SeqWidget *fromWidget = (SeqWidget *)p_fromWidget;
     
     int tmp;
+
+    ensureUi();
+    fromWidget->ensureUi();
     setDispVert(fromWidget->dispVertIndex);
     enableNoteIn->setChecked(fromWidget->enableNoteIn->isChecked());
     enableNoteOff->setChecked(fromWidget->enableNoteOff->isChecked());
@@ -617,10 +694,8 @@ void SeqWidget::copyParamsFrom(ModuleWidget *p_fromWidget)
     transpose->setValue(tmp);
 
     notelength->setValue(fromWidget->notelength->value());
-    for (int l1 = 0; l1 < fromWidget->getMidiWorker()->maxNPoints; l1++) {
-        midiSeq->customWave[l1] = fromWidget->getCustomWave().at(l1);
-        midiSeq->muteMask[l1] = midiSeq->customWave.at(l1).muted;
-    }
+    midiSeq->customWave.copyFrom(fromWidget->getMidiWorker()->customWave,
+                fromWidget->getMidiWorker()->maxNPoints);
     tmp = fromWidget->getLoopMarker();
     midiSeq->setLoopMarker(tmp);
     screen->setLoopMarker(tmp);
@@ -629,16 +704,6 @@ void SeqWidget::copyParamsFrom(ModuleWidget *p_fromWidget)
     updateWaveForm(0);
 }
 
-QVector<Sample> SeqWidget::getCustomWave()
-{
-    return QVector<Sample>::fromStdVector(midiSeq->customWave);
-}
-
-QVector<bool> SeqWidget::getMuteMask()
-{
-    return QVector<bool>::fromStdVector(midiSeq->muteMask);
-}
-
 void SeqWidget::handleController(int ccnumber, int channel, int value)
 {
     QVector<MidiCC> cclist= midiControl->ccList;
@@ -750,6 +815,17 @@ void SeqWidget::updateDisplay()
             updateNRep(parStore->nRepList.at(parStore->activeStore));
         }
     }
+    if (!uiBuilt) {
+        dataChanged = false;
+        midiSeq->dataChanged = false;
+        if (midiSeq->needsGUIUpdate) {
+            moduleData.transp = midiSeq->transp;
+            moduleData.notelen = tickLenToSlider(midiSeq->notelength);
+            moduleData.vel = midiSeq->vel;
+        }
+        updateUnbuiltDisplay();
+        return;
+    }
 
     if (dataChanged || midiSeq->dataChanged) {
         dataChanged=false;
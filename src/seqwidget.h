@@ -88,9 +88,6 @@ class SeqWidget : public ModuleWidget
     int resBoxIndex;
     int sizeBoxIndex;
 
-    QVector<Sample> getCustomWave();
-    QVector<bool> getMuteMask();
-
 /*!
  * @brief ENUM for Internal MIDI Control IDs supported 
  * by the Sequencer widget
@@ -141,9 +138,13 @@ class SeqWidget : public ModuleWidget
     void doRestoreParams(int ix);
     void updateDisplay();
     void handleController(int ccnumber, int channel, int value);
-    void updateCursorPos() {cursor->updatePosition(getFramePtr()); }
+    void updateCursorPos() { if (uiBuilt) cursor->updatePosition(getFramePtr()); }
+    void applyData() override;
+    void controlsToData() override;
 #endif
 
+    void buildUi() override;
+
 /* SIGNALS */
   signals:
 /*! @brief Currently not in use. */
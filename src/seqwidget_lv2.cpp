@@ -270,8 +270,19 @@ void SeqWidgetLV2::receiveWave(LV2_Atom* atom)
     /* cast the buffer to Atom Object */
     LV2_Atom_Object* obj = (LV2_Atom_Object*)atom;
     LV2_Atom *a0 = NULL;
-    lv2_atom_object_get(obj, uris->hex_customwave, &a0, NULL);
-    if (obj->body.otype != uris->hex_customwave) return;
+    LV2_Atom *a1 = NULL;
+    lv2_atom_object_get(obj, uris->hex_customwave, &a0,
+                uris->wave_offset, &a1, NULL);
+    if (!a0) return;
+
+    /* a delta holds the changed points starting at index wave_offset */
+    const bool delta = (obj->body.otype == uris->wave_delta);
+    if (!delta && (obj->body.otype != uris->hex_customwave)) return;
+    int start = 0;
+    if (delta) {
+        if (!a1 || (a1->type != uris->atom_Int)) return;
+        start = ((LV2_Atom_Int*)a1)->body;
+    }
 
     /* handle wave' data vector */
     LV2_Atom_Vector* voi = (LV2_Atom_Vector*)LV2_ATOM_BODY(a0);
@@ -285,10 +296,18 @@ void SeqWidgetLV2::receiveWave(LV2_Atom* atom)
     const int *recdata = (int*) LV2_ATOM_BODY(&voi->atom);
     res = resBox->currentText().toInt();
     size = sizeBox->currentText().toInt();
-    for (uint32_t l1 = 0; l1 < n_elem; l1++) {
-        receiveWavePoint(l1, recdata[l1]);
+    if (delta) {
+        /* the last element in data is the end tag */
+        for (uint32_t l1 = 0; (l1 < n_elem) && (start + (int)l1 < data.count() - 1); l1++) {
+            receiveWavePoint(start + l1, recdata[l1]);
+        }
+    }
+    else {
+        for (uint32_t l1 = 0; l1 < n_elem; l1++) {
+            receiveWavePoint(l1, recdata[l1]);
+        }
+        if (n_elem < (uint32_t)data.count()) data.resize(res * size + 1);
     }
-    if (n_elem < (uint32_t)data.count()) data.resize(res * size + 1);
     screen->updateData(data);
     screen->update();
 }
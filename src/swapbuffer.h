@@ -0,0 +1,106 @@
+/*!
+ * @file swapbuffer.h
+ * @brief Implementation of the SwapBuffer template
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#ifndef SWAPBUFFER_H
+#define SWAPBUFFER_H
+
+#include <atomic>
+
+/*!
+ * @brief Template class handing data from one writer thread to one
+ * realtime reader thread without locks
+ *
+ * The buffer holds three instances of T. The writer fills the back
+ * instance returned by writeBuffer() and makes it available by
+ * publish(), which atomically swaps it with the middle instance. The
+ * reader calls update() at a point where a change of data is allowed,
+ * which swaps the middle instance with the front instance returned by
+ * readBuffer() if a new one was published. Instances are recycled in
+ * turn, so neither side allocates, waits, or ever sees an instance
+ * the other side is working on.
+ *
+ * The instance returned by writeBuffer() holds outdated data and has
+ * to be filled completely before each publish(). Unlike LockFreeStore,
+ * this template does not depend on Qt and can be used by the LV2
+ * plugins.
+ */
+template <typename T>
+class SwapBuffer
+{
+public:
+    SwapBuffer() : middle(1), back(0), front(2) {}
+
+    /**
+     * @brief Sets all three instances to value, not realtime safe
+     */
+    void init(const T &value)
+    {
+        for (int l1 = 0; l1 < 3; l1++) slots[l1] = value;
+    }
+
+    /**
+     * @brief Obtain the instance to be filled by the writer thread
+     */
+    T & writeBuffer() { return slots[back]; }
+
+    /**
+     * @brief Make the filled writeBuffer() available to the reader
+     */
+    void publish() { back = middle.exchange(back | FRESH) & INDEX; }
+
+    /**
+     * @brief Called by the reader thread to take over the latest
+     * published instance
+     *
+     * @retval true readBuffer() now returns a newly published instance
+     * @retval false nothing was published since the last call
+     */
+    bool update()
+    {
+        if (!(middle.load() & FRESH)) return false;
+        front = middle.exchange(front) & INDEX;
+        return true;
+    }
+
+    /**
+     * @brief Returns true while a published instance has not been
+     * taken over by update() yet
+     */
+    bool pending() const { return middle.load() & FRESH; }
+
+    /**
+     * @brief Obtain the instance currently used by the reader thread
+     */
+    const T & readBuffer() const { return slots[front]; }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+
+    T slots[3];
+    std::atomic<int> middle;    /**< Shared instance index, FRESH set if unread */
+    int back;                   /**< Instance index owned by the writer */
+    int front;                  /**< Instance index owned by the reader */
+};
+
+#endif
@@ -0,0 +1,207 @@
+/*!
+ * @file tickcheck.cpp
+ * @brief Soak check of the 64 bit tick handling, run by "make check"
+ *
+ * Drives a MidiSeq, a MidiLfo and a MidiArp through a TempoMap in JACK
+ * sized cycles, as JackDriver and the LV2 plugins do. The same run is
+ * done once from a small start tick and once from 2^32 - 4.8e6 ticks,
+ * which passes 2^32 after 50 seconds at 120 BPM. The check fails when
+ * a tick goes backwards, when a module does not advance its nextTick
+ * beyond the tick it was rendered at, or when the number of frames or
+ * events rendered differs between the two runs.
+ *
+ * It also feeds MidiDecoder a SysEx split across three input buffers
+ * and checks that each buffer comes back as one EV_SYSEX fragment.
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#include <cstdio>
+#include <cstdint>
+
+#include "midiarp.h"
+#include "midilfo.h"
+#include "midievent.h"
+#include "midiseq.h"
+#include "timebase.h"
+
+/* Simulated sample rate, cycle length and run time */
+#define CHECK_RATE      48000
+#define CHECK_NFRAMES   256
+#define CHECK_SECONDS   120
+#define CHECK_BPM       120.
+
+/* Start ticks of the two runs, the second one crosses 2^32 */
+#define CHECK_LOW_TICK  1000000ULL
+#define CHECK_WRAP_TICK ((1ULL << 32) - 4800000ULL)
+
+struct RunCount {
+    uint64_t frames;    /**< getNextFrame() calls */
+    uint64_t events;    /**< Events in the rendered frames */
+    uint64_t lastTick;  /**< Tick of the last cycle */
+};
+
+/*! @brief Runs one module for CHECK_SECONDS starting at start_tick
+ *
+ * @return False if a tick went backwards or the module stalled
+ */
+template <class W>
+static bool soak(W *worker, const char *name, uint64_t start_tick,
+                RunCount *count)
+{
+    TempoMap tempoMap;
+    uint64_t tick, last_tick = start_tick;
+
+    tempoMap.setRate(CHECK_RATE);
+    tempoMap.reset(0, start_tick, CHECK_BPM);
+    worker->setNextTick(start_tick);
+    count->frames = 0;
+    count->events = 0;
+
+    for (uint64_t frame = 0; frame < (uint64_t)CHECK_SECONDS * CHECK_RATE;
+                frame += CHECK_NFRAMES) {
+        tick = tempoMap.frameToTick(frame);
+        if (tick < last_tick) {
+            printf("%s: tick went back from %llu to %llu\n", name,
+                    (unsigned long long)last_tick, (unsigned long long)tick);
+            return false;
+        }
+        last_tick = tick;
+        if (!worker->frameDue(false, tick)) continue;
+
+        worker->getNextFrame(tick);
+        count->frames++;
+        count->events += worker->outFrameCount;
+        if (worker->nextTick <= (int64_t)tick) {
+            printf("%s: stalled at tick %llu, nextTick %lld\n", name,
+                    (unsigned long long)tick, (long long)worker->nextTick);
+            return false;
+        }
+    }
+    count->lastTick = last_tick;
+    return true;
+}
+
+/*! @brief Runs a fresh instance of W from both start ticks and compares
+ *
+ * The runs start at different positions within the patterns, so the
+ * counts may differ by the one step cut off at either end.
+ */
+template <class W>
+static bool check(const char *name)
+{
+    RunCount low, wrap;
+    bool ok;
+
+    W *worker = new W;
+    ok = soak(worker, name, CHECK_LOW_TICK, &low);
+    delete worker;
+    if (!ok) return false;
+
+    worker = new W;
+    ok = soak(worker, name, CHECK_WRAP_TICK, &wrap);
+    delete worker;
+    if (!ok) return false;
+
+    printf("%s: %llu frames, %llu events from tick %llu, "
+            "%llu frames, %llu events from tick %llu to %llu\n", name,
+            (unsigned long long)low.frames, (unsigned long long)low.events,
+            CHECK_LOW_TICK,
+            (unsigned long long)wrap.frames, (unsigned long long)wrap.events,
+            CHECK_WRAP_TICK, (unsigned long long)wrap.lastTick);
+
+    if (wrap.lastTick < (1ULL << 32)) {
+        printf("%s: run did not pass 2^32\n", name);
+        return false;
+    }
+    if ((low.frames > wrap.frames + 1) || (wrap.frames > low.frames + 1)
+            || (low.frames < CHECK_SECONDS)) {
+        printf("%s: frame counts differ\n", name);
+        return false;
+    }
+    return true;
+}
+
+/*! @brief MidiArp holding a chord from the start of the run */
+class ArpWithChord : public MidiArp {
+  public:
+    ArpWithChord()
+    {
+        MidiEvent ev;
+
+        ev.type = EV_NOTEON;
+        ev.channel = 0;
+        ev.value = 100;
+        for (int l1 = 0; l1 < 3; l1++) {
+            ev.data = 60 + 4 * l1;
+            handleEvent(ev, 0);
+        }
+    }
+};
+
+/*! @brief Decodes a SysEx split across input buffers and a note after it
+ *
+ * @return False if a buffer is not returned as a single fragment or the
+ * note following the SysEx is not decoded
+ */
+static bool checkSysexSplit()
+{
+    static const uint8_t buf0[] = { 0xf0, 0x7e, 0x01 };
+    static const uint8_t buf1[] = { 0x05 };
+    static const uint8_t buf2[] = { 0x03, 0x04, 0xf7 };
+    static const uint8_t note[] = { 0x90, 0x3c, 0x64 };
+    const uint8_t *bufs[3] = { buf0, buf1, buf2 };
+    const uint32_t sizes[3] = { sizeof(buf0), sizeof(buf1), sizeof(buf2) };
+    MidiDecoder decoder;
+    MidiEvent ev;
+    const uint8_t *msg;
+    uint32_t len;
+
+    for (int l1 = 0; l1 < 3; l1++) {
+        ev.channel = ev.value = -1;
+        if ((decoder.decode(bufs[l1], sizes[l1], &ev, &msg, &len) != sizes[l1])
+                || (len != sizes[l1]) || (msg != bufs[l1])
+                || (ev.type != EV_SYSEX) || ev.channel || ev.value) {
+            printf("MidiDecoder: SysEx fragment %d not returned as one "
+                    "EV_SYSEX\n", l1);
+            return false;
+        }
+    }
+    if ((decoder.decode(note, sizeof(note), &ev, &msg, &len) != sizeof(note))
+            || (ev.type != EV_NOTEON) || ev.channel
+            || (ev.data != 0x3c) || (ev.value != 0x64)) {
+        printf("MidiDecoder: note after split SysEx not decoded\n");
+        return false;
+    }
+    printf("MidiDecoder: split SysEx returned as 3 fragments\n");
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    ok &= check<MidiSeq>("MidiSeq");
+    ok &= check<MidiLfo>("MidiLfo");
+    ok &= check<ArpWithChord>("MidiArp");
+    ok &= checkSysexSplit();
+
+    return ok ? 0 : 1;
+}
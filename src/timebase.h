@@ -0,0 +1,364 @@
+/*!
+ * @file timebase.h
+ * @brief Defines the TempoMap class converting between ticks and frames
+ * and the ClockDll class following an external MIDI clock
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <cmath>
+#include <cstdint>
+
+#include "main.h"
+
+/*! @brief Tempo map converting between ticks and frames of a backend
+ *
+ * The map is a list of segments, each starting at a frame and tick with
+ * a tempo, optionally ramping linearly in time to an end tempo over a
+ * number of frames and holding the end tempo afterwards. What a frame
+ * is depends on the rate given: audio frames for JACK and the LV2
+ * plugins, nanoseconds for the ALSA queue.
+ *
+ * For each segment, the ticks per frame and frames per tick at the held
+ * tempo are precomputed as 64 bit fixed-point factors with individual
+ * shift, so that conversions in the held part of a segment need one
+ * multiplication and no division. Only ramps use floating-point. The
+ * segment holding the current position is the last one in most cases
+ * and is checked first, otherwise it is found by binary search.
+ *
+ * Tempo changes append segments continuing at the current position, so
+ * the tick position never jumps. When the map is full, the oldest
+ * segment is dropped, and positions before the first segment are
+ * extrapolated at its tempo.
+ *
+ * The map does not allocate and can be used by the realtime threads, it
+ * has to be used by one thread at a time.
+ */
+class TempoMap {
+
+  public:
+    enum { MAX_SEGMENTS = 64 };
+
+  private:
+    struct Segment {
+        uint64_t frame;     /*!< First frame of the segment */
+        uint64_t tick;      /*!< Tick at frame */
+        double bpm;         /*!< Tempo at frame */
+        double endBpm;      /*!< Tempo held after the ramp, bpm if no ramp */
+        uint64_t rampFrames;/*!< Length of the ramp, 0 if no ramp */
+        uint64_t rampTicks; /*!< Ticks elapsing during the ramp */
+        uint64_t tickMul;   /*!< Fixed-point ticks per frame at endBpm */
+        uint64_t frameMul;  /*!< Fixed-point frames per tick at endBpm */
+        int tickShift;      /*!< Fractional bits of tickMul */
+        int frameShift;     /*!< Fractional bits of frameMul */
+    };
+
+    Segment segments[MAX_SEGMENTS];
+    int first;          /*!< Ring buffer index of the first segment */
+    int count;          /*!< Number of segments in use, at least one */
+    double rate;        /*!< Frames per second */
+
+    const Segment & seg(int ix) const
+    {
+        return segments[(first + ix) & (MAX_SEGMENTS - 1)];
+    }
+
+/*! @brief Returns (a * mul) >> shift computed with 128 bit precision */
+    static uint64_t mulShift(uint64_t a, uint64_t mul, int shift)
+    {
+#if defined(__SIZEOF_INT128__)
+        return (uint64_t)(((unsigned __int128)a * mul) >> shift);
+#else
+        const uint64_t al = a & 0xffffffff, ah = a >> 32;
+        const uint64_t ml = mul & 0xffffffff, mh = mul >> 32;
+        const uint64_t m1 = ah * ml, m2 = al * mh;
+        uint64_t lo = al * ml;
+        uint64_t hi = ah * mh;
+        const uint64_t t = (lo >> 32) + (m1 & 0xffffffff) + (m2 & 0xffffffff);
+        lo = (t << 32) | (lo & 0xffffffff);
+        hi += (m1 >> 32) + (m2 >> 32) + (t >> 32);
+        if (shift >= 64) return hi >> (shift - 64);
+        if (!shift) return lo;
+        return (lo >> shift) | (hi << (64 - shift));
+#endif
+    }
+
+/*! @brief Sets mul and shift so that x * ratio == (x * mul) >> shift
+ * with the highest precision fitting 63 bits.
+ */
+    static void toFixed(double ratio, uint64_t &mul, int &shift)
+    {
+        int exp;
+        frexp(ratio, &exp);
+        shift = 63 - exp;
+        if (shift > 64) shift = 64;
+        if (shift < 0) shift = 0;
+        mul = (uint64_t)(ldexp(ratio, shift) + 0.5);
+    }
+
+/*! @brief Ticks per frame and beat per minute at this rate */
+    double ticksPerBeatFrame() const { return (double)TPQN / 60. / rate; }
+
+    static double clipTempo(double bpm) { return (bpm < 0.01) ? 0.01 : bpm; }
+
+/*! @brief Appends a segment at frame, dropping all segments starting
+ * at or after frame and the oldest one if the map is full.
+ */
+    void append(uint64_t frame, uint64_t tick, double bpm, double endBpm,
+                uint64_t rampFrames)
+    {
+        while ((count > 1) && (seg(count - 1).frame >= frame)) count--;
+        if ((count == 1) && (seg(0).frame >= frame)) count = 0;
+        if (count == MAX_SEGMENTS) {
+            first = (first + 1) & (MAX_SEGMENTS - 1);
+            count--;
+        }
+        Segment &s = segments[(first + count) & (MAX_SEGMENTS - 1)];
+        const double k = ticksPerBeatFrame();
+        s.frame = frame;
+        s.tick = tick;
+        s.bpm = bpm;
+        s.endBpm = endBpm;
+        s.rampFrames = rampFrames;
+        s.rampTicks = (uint64_t)(k * (bpm + endBpm) * 0.5 * rampFrames);
+        toFixed(k * endBpm, s.tickMul, s.tickShift);
+        toFixed(1. / (k * endBpm), s.frameMul, s.frameShift);
+        count++;
+    }
+
+/*! @brief Returns the index of the last segment starting at or before
+ * frame, 0 if frame is before the first segment.
+ */
+    int findFrame(uint64_t frame) const
+    {
+        if (frame >= seg(count - 1).frame) return count - 1;
+        int lo = 0, hi = count - 1;
+        while (hi - lo > 1) {
+            const int mid = (lo + hi) / 2;
+            if (seg(mid).frame <= frame) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+/*! @brief Returns the index of the last segment starting at or before
+ * tick, 0 if tick is before the first segment.
+ */
+    int findTick(uint64_t tick) const
+    {
+        if (tick >= seg(count - 1).tick) return count - 1;
+        int lo = 0, hi = count - 1;
+        while (hi - lo > 1) {
+            const int mid = (lo + hi) / 2;
+            if (seg(mid).tick <= tick) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+  public:
+    TempoMap(double p_rate = 48000.) : first(0), count(0), rate(p_rate)
+    {
+        reset(0, 0, 120.);
+    }
+
+/*! @brief Sets the number of frames per second, has to be followed
+ * by reset().
+ */
+    void setRate(double p_rate) { if (p_rate > 0) rate = p_rate; }
+    double getRate() const { return rate; }
+
+/*! @brief Clears the map and starts it with one segment of constant
+ * tempo, relocating the position to tick at frame.
+ */
+    void reset(uint64_t frame, uint64_t tick, double bpm)
+    {
+        count = 0;
+        bpm = clipTempo(bpm);
+        append(frame, tick, bpm, bpm, 0);
+    }
+
+/*! @brief Continues the map at frame with constant tempo bpm */
+    void setTempo(uint64_t frame, double bpm)
+    {
+        bpm = clipTempo(bpm);
+        append(frame, frameToTick(frame), bpm, bpm, 0);
+    }
+
+/*! @brief Continues the map at frame with a tempo ramping linearly from
+ * the tempo at frame to endBpm at endFrame, holding endBpm afterwards.
+ */
+    void setTempoRamp(uint64_t frame, uint64_t endFrame, double endBpm)
+    {
+        endBpm = clipTempo(endBpm);
+        if (endFrame <= frame) {
+            setTempo(frame, endBpm);
+            return;
+        }
+        append(frame, frameToTick(frame), tempoAt(frame), endBpm,
+                endFrame - frame);
+    }
+
+/*! @brief Returns the tempo at frame */
+    double tempoAt(uint64_t frame) const
+    {
+        const Segment &s = seg(findFrame(frame));
+        if ((frame <= s.frame) || !s.rampFrames) return s.bpm;
+        if (frame - s.frame >= s.rampFrames) return s.endBpm;
+        return s.bpm + (s.endBpm - s.bpm) * (frame - s.frame) / s.rampFrames;
+    }
+
+/*! @brief Returns the tempo held after the last segment */
+    double tempo() const { return seg(count - 1).endBpm; }
+
+/*! @brief Returns the tick at frame, rounded down */
+    uint64_t frameToTick(uint64_t frame) const
+    {
+        const Segment &s = seg(findFrame(frame));
+        if (frame < s.frame) {
+            const uint64_t dt = (s.frame - frame) * ticksPerBeatFrame() * s.bpm;
+            return (dt < s.tick) ? s.tick - dt : 0;
+        }
+        const uint64_t df = frame - s.frame;
+        if (df >= s.rampFrames) {
+            return s.tick + s.rampTicks
+                    + mulShift(df - s.rampFrames, s.tickMul, s.tickShift);
+        }
+        const double slope = (s.endBpm - s.bpm) / s.rampFrames;
+        return s.tick + (uint64_t)(ticksPerBeatFrame()
+                    * (s.bpm + 0.5 * slope * df) * df);
+    }
+
+/*! @brief Returns the frame at tick, rounded down */
+    uint64_t tickToFrame(uint64_t tick) const
+    {
+        const Segment &s = seg(findTick(tick));
+        if (tick < s.tick) {
+            const uint64_t df = (s.tick - tick) / (ticksPerBeatFrame() * s.bpm);
+            return (df < s.frame) ? s.frame - df : 0;
+        }
+        const uint64_t dt = tick - s.tick;
+        if (dt >= s.rampTicks) {
+            return s.frame + s.rampFrames
+                    + mulShift(dt - s.rampTicks, s.frameMul, s.frameShift);
+        }
+        /* Solve the ramp's quadratic in its cancellation-free form */
+        const double slope = (s.endBpm - s.bpm) / s.rampFrames;
+        const double beats = dt / ticksPerBeatFrame();
+        return s.frame + (uint64_t)(2. * beats
+                    / (s.bpm + sqrt(s.bpm * s.bpm + 2. * slope * beats)));
+    }
+};
+
+/*! @brief Delay-locked loop following the timestamps of a MIDI clock
+ *
+ * Second order loop as described by F. Adriaensen in "Using a DLL to
+ * filter time". Each incoming clock is compared with the time predicted
+ * from the previous ones, the error corrects both the phase and the
+ * clock period by fractions depending on the loop bandwidth. The loop
+ * bandwidth is a fixed fraction of the clock rate, so the same filter
+ * works for any time unit and tempo, with about 0.75 Hz at 120 bpm.
+ *
+ * A clock deviating by more than half a period from its prediction is
+ * treated as outlier and replaced by the prediction. Several outliers
+ * in a row mean the master changed, and the loop locks anew.
+ *
+ * The loop does not allocate and can be used by the realtime threads.
+ */
+class ClockDll {
+
+  public:
+    enum { MAX_OUTLIERS = 3 };
+
+  private:
+    double t0;          /*!< Filtered time of the last clock */
+    double t1;          /*!< Predicted time of the next clock */
+    double period;      /*!< Filtered clock period */
+    double b, c;        /*!< Loop coefficients */
+    int count;          /*!< Clocks received since the last reset */
+    int outliers;       /*!< Consecutive outliers received */
+
+  public:
+    ClockDll() : t0(0), t1(0), period(0)
+    {
+        const double omega = 2. * M_PI / 64.;
+        b = sqrt(2.) * omega;
+        c = omega * omega;
+        reset();
+    }
+
+/*! @brief Forgets all clocks received, to be called at transport start */
+    void reset()
+    {
+        count = 0;
+        outliers = 0;
+    }
+
+/*! @brief Feeds the time of an incoming clock, returns false if the
+ * clock was rejected as outlier.
+ */
+    bool update(double time)
+    {
+        if (count < 2) {
+            if (count && (time > t1)) {
+                period = time - t1;
+                t0 = time;
+                t1 = time + period;
+                count++;
+            }
+            else {
+                t1 = time;
+                count = 1;
+            }
+            return true;
+        }
+        const double e = time - t1;
+        t0 = t1;
+        if (fabs(e) > 0.5 * period) {
+            if (++outliers > MAX_OUTLIERS) {
+                reset();
+                update(time);
+                return false;
+            }
+            t1 += period;
+            return false;
+        }
+        outliers = 0;
+        t1 += b * e + period;
+        period += c * e;
+        count++;
+        return true;
+    }
+
+/*! @brief True once the loop has measured a clock period */
+    bool locked() const { return (count >= 2) && (period > 0); }
+
+/*! @brief Filtered time of the last clock received */
+    double time() const { return t0; }
+
+/*! @brief Tempo in beats per minute, given the time units per second */
+    double tempo(double rate) const
+    {
+        return 60. * rate / (period * MIDICLK_TPQN);
+    }
+};
+
+#endif
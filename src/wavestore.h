@@ -0,0 +1,162 @@
+/*!
+ * @file wavestore.h
+ * @brief Defines the WaveStore class holding module waves in compact form
+ *
+ *
+ *      Copyright 2009 - 2021 <qmidiarp-devel@lists.sourceforge.net>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ */
+
+#ifndef WAVESTORE_H
+#define WAVESTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*! @brief Word of the WaveStore mute bitset
+ *
+ * The realtime thread reads the mute states while the GUI thread
+ * changes single bits, so the word is atomic. Copies are made by
+ * value so that it can be held in a std::vector.
+ */
+struct MuteWord {
+    std::atomic<uint32_t> bits;
+
+    MuteWord() : bits(0) {}
+    MuteWord(const MuteWord &other)
+        : bits(other.bits.load(std::memory_order_relaxed)) {}
+    MuteWord &operator=(const MuteWord &other)
+    {
+        bits.store(other.bits.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        return *this;
+    }
+};
+
+/*! @brief Compact storage of the points of a module wave
+ *
+ * The point values (LFO controller values or Seq notes, 0 ... 127) are
+ * held in one contiguous byte array, the mute states in a bitset.
+ * Unlike a vector of Sample structures, no tick is stored, since the
+ * tick of a point always is index * TPQN / res. Modules expand single
+ * points to Sample structures only when handing them out.
+ *
+ * No member function allocates memory as long as the store is not
+ * resized beyond its reserved capacity, so that the realtime
+ * functions can work on it. setMuted() changes its bit with an atomic
+ * operation, so that a realtime thread reading other points of the
+ * same word meanwhile does not lose its change.
+ */
+class WaveStore {
+
+  private:
+    std::vector<uint8_t> values;    /*!< Point values, one byte per point */
+    std::vector<MuteWord> muteBits; /*!< Mute state bitset, one bit per point */
+
+  public:
+/*! @brief Sets the number of points held, new points are set to
+ * value 0 and not muted.
+ */
+    void resize(int npoints)
+    {
+        values.resize(npoints);
+        muteBits.resize((npoints + 31) / 32);
+    }
+/*! @brief Reserves space for npoints so that later resizes within
+ * this size do not allocate.
+ */
+    void reserve(int npoints)
+    {
+        values.reserve(npoints);
+        muteBits.reserve((npoints + 31) / 32);
+    }
+    int size() const { return values.size(); }
+
+    int value(int ix) const { return values[ix]; }
+/*! @brief Sets the value of point ix, clipped to the MIDI data range */
+    void setValue(int ix, int value)
+    {
+        values[ix] = (value < 0) ? 0 : ((value > 127) ? 127 : value);
+    }
+
+    bool isMuted(int ix) const
+    {
+        return (muteBits[ix >> 5].bits.load(std::memory_order_relaxed)
+                    >> (ix & 31)) & 1;
+    }
+    void setMuted(int ix, bool on)
+    {
+        if (on)
+            muteBits[ix >> 5].bits.fetch_or(1u << (ix & 31),
+                    std::memory_order_relaxed);
+        else
+            muteBits[ix >> 5].bits.fetch_and(~(1u << (ix & 31)),
+                    std::memory_order_relaxed);
+    }
+
+/*! @brief Sets values and mute states of all points */
+    void fill(int value, bool muted)
+    {
+        memset(values.data(), (value < 0) ? 0 : ((value > 127) ? 127 : value),
+                    values.size());
+        for (size_t l1 = 0; l1 < muteBits.size(); l1++)
+            muteBits[l1].bits.store(muted ? 0xffffffffu : 0,
+                    std::memory_order_relaxed);
+    }
+/*! @brief Copies the first npoints values and mute states from another
+ * WaveStore, both stores have to hold at least npoints.
+ */
+    void copyFrom(const WaveStore &other, int npoints)
+    {
+        memcpy(values.data(), other.values.data(), npoints);
+        for (int l1 = 0; l1 < npoints / 32; l1++)
+            muteBits[l1] = other.muteBits[l1];
+        for (int l1 = npoints & ~31; l1 < npoints; l1++)
+            setMuted(l1, other.isMuted(l1));
+    }
+/*! @brief Repeats the first npoints points periodically up to the
+ * point count newnpoints.
+ */
+    void repeat(int npoints, int newnpoints)
+    {
+        for (int l1 = npoints; l1 < newnpoints; l1++) {
+            values[l1] = values[l1 % npoints];
+            setMuted(l1, isMuted(l1 % npoints));
+        }
+    }
+
+    const uint8_t *constData() const { return values.data(); }
+};
+
+/*! @brief Wave layout handed from the GUI thread to the realtime thread
+ *
+ * Modules publish it through a SwapBuffer whenever the resolution, size,
+ * loop marker or the computed wave change, so that the realtime thread
+ * always plays a consistent set of these.
+ */
+struct WaveSnapshot {
+    WaveStore wave;     /*!< Wave points, left empty by modules playing
+                            their customWave in place */
+    int res;            /*!< Resolution the wave was built for */
+    int npoints;        /*!< Number of points in the wave */
+    int loopMarker;     /*!< Loop marker position, 0 if none */
+};
+
+#endif